@@ -29,11 +29,14 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cmath> 
+#include <cfloat>
 
 #include <string>
 #include <sstream>
 #include <vector>
 #include <map>
+#include <deque>
+#include <unordered_map>
 #include <algorithm>
 #include <chrono>
 #include <iostream>
@@ -41,11 +44,17 @@
 #include <filesystem>
 #include <thread>
 #include <future>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <emmintrin.h> // SSE2 intrinsics
 
 #define WIN32_LEAN_AND_MEAN // Exclude rarely-used content from the Windows headers
 #define NOMINMAX // Stop windows macros defining their own min and max macros
 
 // Windows Header Files
+#include <winsock2.h> // Has to come before windows.h
 #include <windows.h>
 #include <windowsx.h>
 #include <mmsystem.h>
@@ -97,6 +106,10 @@ constexpr float PLAY_PI	= 3.14159265358979323846f;   // pi
 #ifdef _DEBUG
 	// Prints out all the currently allocated memory to the debug output
 	void PrintAllocations( const char* tagText );
+	// Gets the number of allocations currently being tracked
+	unsigned int GetAllocationCount();
+	// Gets the total size of the allocations currently being tracked in bytes
+	size_t GetAllocatedBytes();
 
 	// Allocate some memory with a known origin
 	void* operator new(size_t size, const char* file, int line);
@@ -115,6 +128,8 @@ constexpr float PLAY_PI	= 3.14159265358979323846f;   // pi
 	#define new new( __FILE__ , __LINE__ )
 #else
 	#define PrintAllocations( x )
+	#define GetAllocationCount() 0u
+	#define GetAllocatedBytes() size_t( 0 )
 #endif
 
 #endif
@@ -979,8 +994,10 @@ struct MouseData
 // Notes:		Uses a 32-bit ARGB display buffer
 //********************************************************************************************************************************
 
-// The target frame rate
+// The default target frame rate (change it at run time with PlayWindow::SetTargetFrameRate)
 constexpr int FRAMES_PER_SECOND = 60;
+// The longest an idle window waits for input before running another frame anyway (in milliseconds)
+constexpr int IDLE_WAKE_INTERVAL = 100;
 
 // Some defines to hide the complexity of arguments 
 #define PLAY_IGNORE_COMMAND_LINE	int, char*[]
@@ -988,6 +1005,8 @@ constexpr int FRAMES_PER_SECOND = 60;
 constexpr int PLAY_OK = 0;
 constexpr int PLAY_ERROR = -1;
 
+class PlayThreadPool;
+
 // Encapsulates the platform specific functionality of creating and managing a window 
 // > Singleton class accessed using PlayWindow::Instance()
 class PlayWindow
@@ -1009,21 +1028,141 @@ public:
 
 	// Call within WInMain to hand control of Windows functionality over to the PlayWindow class
 	int HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR pCmdLine, int nCmdShow, LPCWSTR windowName );
+	// Runs the game for a number of frames as fast as possible without a window, drawing or keyboard input
+	// > Used instead of HandleWindows when the program is run with -headless <frames>, and reports the frames simulated per second
+	int RunHeadless( int frames );
+	// Sets the function which sets the key states for each frame of a headless run (using Play::SetKeyState)
+	void SetHeadlessInput( std::function<void( int frame )> input ) { m_headlessInput = input; }
+	// Sets the function which scripts the key states before every frame's input is read, with or without a window (so recordings include them)
+	void SetInputScript( std::function<void( int frame )> script ) { m_inputScript = script; }
+	// Checks whether the game is running headless, in which case all the Play drawing functions do nothing
+	static bool IsHeadless() { return s_bHeadless; }
+	// Turns headless mode on (before the manager is created)
+	static void SetHeadless( bool bHeadless ) { s_bHeadless = bHeadless; }
 	// Handles Windows messages for the PlayWindow  
 	static LRESULT CALLBACK WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam );
 	// Copies the display buffer pixels to the window
 	// > Returns the time taken for the present in seconds
 	double Present();
+	// Copies a frame the same size as the drawing buffer to the window (upscaling it first if it is smaller than the window)
+	double PresentPixels( const Pixel* pPixels );
+
+	// Upscaling functions
+	//********************************************************************************************************************************
+
+	// Copies pixels into a buffer scale times bigger in each direction by repeating each pixel (nearest neighbour)
+	// > 2x, 3x and 4x widen four pixels at a time with SSE2, and each widened row is copied to the rows below it
+	// > The rows are shared out across the pool's threads if one is given
+	static void UpscalePixels( const Pixel* pSource, int width, int height, int scale, Pixel* pDest, PlayThreadPool* pPool = nullptr );
+	// Upscales each frame on this many worker threads as well as the presenting thread (0 upscales on the presenting thread only)
+	void SetUpscaleThreads( int workerCount );
+	// Gets how long the last frame took to upscale in milliseconds (0 when the scale is 1)
+	double GetLastUpscaleMs() const { return m_lastUpscaleMs; }
+	// Gets how long the last frame took to show in milliseconds, including the upscaling
+	double GetLastPresentMs() const { return m_lastPresentMs; }
 	// Sets the pointer to write mouse input data to
 	void RegisterMouse( MouseData* pMouseData ) { m_pMouseData = pMouseData; }
 
+	// Frame pacing functions
+	//********************************************************************************************************************************
+
+	// How late the frame pacer has been waking up (in milliseconds)
+	struct FramePacingStats
+	{
+		int frames{ 0 };
+		double lastErrorMs{ 0.0 };
+		double meanErrorMs{ 0.0 };
+		double maxErrorMs{ 0.0 };
+	};
+
+	// A function which waits until the performance counter reaches dueTime
+	using FramePacer = std::function<void( long long dueTime, long long frequency )>;
+
+	// Sets the frame rate HandleWindows tries to run at
+	// > 0 runs as fast as possible
+	void SetTargetFrameRate( int framesPerSecond );
+	// Gets the frame rate HandleWindows tries to run at
+	int GetTargetFrameRate() const { return m_targetFrameRate; }
+	// Replaces the function used to wait for the next frame (the default is SleepThenSpin)
+	void SetFramePacer( FramePacer pacer ) { m_framePacer = pacer; }
+	// Sleeps until just before the frame is due, then spins for the last couple of milliseconds
+	// > Sleep alone can wake up late, while spinning the whole time keeps a core busy
+	static void SleepThenSpin( long long dueTime, long long frequency );
+	// Gets how accurately the frames have been paced
+	const FramePacingStats& GetFramePacingStats() const { return m_pacingStats; }
+	// Gets how long the last MainGameUpdate took in milliseconds (not counting the time spent waiting for the frame to be due)
+	double GetLastUpdateMs() const { return m_lastUpdateMs; }
+	// Starts collecting the pacing statistics again
+	void ResetFramePacingStats() { m_pacingStats = FramePacingStats(); }
+	// Tells the window that nothing on screen is changing, so it can wait for input instead of running every frame
+	// > The last frame presented is shown again if the window needs repainting
+	void SetIdle( bool bIdle ) { m_bIdle = bIdle; }
+	// Checks whether the window is waiting for input between frames
+	bool IsIdle() const { return m_bIdle; }
+
+	// Frame export functions
+	//********************************************************************************************************************************
+
+	// The start of the shared memory made by StartFrameExport, which is followed by slotCount slots
+	// > Each slot is a FrameExportSlot followed by width * height pixels in the same format as the display buffer
+	struct FrameExportHeader
+	{
+		char id[4]; // "PLFX"
+		uint32_t version;
+		int32_t width;
+		int32_t height;
+		int32_t slotCount;
+		uint32_t slotSize; // The size of each slot in bytes, including its FrameExportSlot
+		std::atomic< uint64_t > latestFrame; // The newest finished frame (0 until the first one), which is in slot ( latestFrame - 1 ) % slotCount
+	};
+
+	// The start of each slot in the shared memory made by StartFrameExport
+	// > A reader should check the sequence is the same before and after reading the pixels, as the slot may have been reused in between
+	struct FrameExportSlot
+	{
+		std::atomic< uint64_t > sequence; // The frame in the slot, or 0 while it is being written
+	};
+
+	// The header and each slot's FrameExportSlot are padded to this size, so the pixels are aligned
+	static constexpr size_t FRAME_EXPORT_ALIGNMENT = 64;
+
+	// Publishes every presented frame into a ring of slots in named shared memory, so other programs can read the frames in place
+	// > Other programs open the memory with OpenFileMapping( name ), and the game never waits for them
+	// > Returns false if the shared memory couldn't be made
+	bool StartFrameExport( const char* name, int slotCount );
+	// Stops publishing frames and releases the shared memory
+	void StopFrameExport();
+	// Copies a frame into the next slot (does nothing unless StartFrameExport has been called)
+	void ExportFrame( const Pixel* pPixels );
+	// Checks whether frames are being published to shared memory
+	bool IsExportingFrames() const { return m_pFrameExport != nullptr; }
+
+	// Present thread functions
+	//********************************************************************************************************************************
+
+	// Shows frames on a separate thread, with the display buffer and two back buffers taking turns (triple buffering)
+	// > QueuePresent swaps the finished display buffer for a free back buffer, so the game must draw the whole screen every frame
+	// > onShown is called on the present thread after each new frame is shown and exported, and may swap the frame's pixels for another buffer
+	void StartPresentThread( std::function<void( Pixel*& )> onShown );
+	// Shows any frame still waiting, then stops the present thread and frees the back buffers
+	void StopPresentThread();
+	// Checks whether frames are being shown on the present thread
+	bool IsPresentThreadRunning() const { return m_presentThread.joinable(); }
+	// Hands the display buffer's frame to the present thread and carries on with a free back buffer, without waiting
+	// > If the last frame handed over hasn't been shown yet, it is replaced by this one (and counted)
+	void QueuePresent();
+	// Waits until the present thread has shown every frame handed to it
+	void WaitForPresent();
+	// Gets how many frames were replaced by a newer one before the present thread could show them
+	int GetReplacedFrameCount();
+
 	// Getter functions
 	//********************************************************************************************************************************
 
-	// Gets the width of the display buffer in pixels
-	int GetWidth() const { return m_pPlayBuffer->width; }
-	// Gets the height of the display buffer in pixels 
-	int GetHeight() const { return m_pPlayBuffer->height; }
+	// Gets the width of the display in pixels (the drawing buffer may be smaller, see PlayGraphics::SetResolutionDivisor)
+	int GetWidth() const { return m_width; }
+	// Gets the height of the display in pixels 
+	int GetHeight() const { return m_height; }
 	// Gets the scale of the display buffer in pixels
 	int GetScale() const { return m_scale; }
 
@@ -1053,16 +1192,56 @@ private:
 	//********************************************************************************************************************************
 
 	// Display buffer dimensions
+	int m_width{ 0 };
+	int m_height{ 0 };
 	int m_scale{ 0 };
 
 	// Buffer pointers
 	PixelData* m_pPlayBuffer{ nullptr };
 	//Pointer to external mouse data
 	MouseData* m_pMouseData{ nullptr };
-	// Pointer to the instance.
-	static PlayWindow* s_pInstance;
 	// The handle to the Window 
 	HWND m_hWindow{ nullptr };
+	// Frame pacing
+	int m_targetFrameRate{ FRAMES_PER_SECOND };
+	FramePacer m_framePacer{ SleepThenSpin };
+	FramePacingStats m_pacingStats;
+	double m_lastUpdateMs{ 0.0 };
+	bool m_bIdle{ false };
+	// The loop run by the present thread
+	void PresentThreadLoop();
+	// Waits until the present thread has shown every frame handed to it, and keeps it from starting another until the lock is released
+	// > Used to change anything the present thread reads, such as the frame export or the upscaling pool
+	std::unique_lock< std::mutex > LockIdlePresent();
+	// Widens one row of pixels for UpscalePixels
+	static void UpscaleRow( const Pixel* pSource, int width, int scale, Pixel* pDest );
+
+	// Upscaling (the scaled frame is only used by whichever thread is presenting)
+	std::vector< Pixel > m_scaledPixels;
+	PlayThreadPool* m_pUpscalePool{ nullptr };
+	std::atomic< double > m_lastUpscaleMs{ 0.0 };
+	std::atomic< double > m_lastPresentMs{ 0.0 };
+
+	// Present thread (the frames and flags are protected by m_presentMutex)
+	std::thread m_presentThread;
+	std::mutex m_presentMutex;
+	std::condition_variable m_presentCondition;
+	std::function<void( Pixel*& )> m_onFrameShown;
+	std::vector< Pixel* > m_vFreeFrames;
+	Pixel* m_pPendingFrame{ nullptr }; // Waiting to be shown
+	Pixel* m_pShownFrame{ nullptr }; // Being shown, or the last frame shown
+	bool m_bPresenting{ false };
+	bool m_bRepaint{ false };
+	bool m_bStopPresenting{ false };
+	int m_replacedFrames{ 0 };
+	// Frame export
+	HANDLE m_hFrameExport{ nullptr };
+	uint8_t* m_pFrameExport{ nullptr };
+	uint64_t m_exportedFrames{ 0 };
+	// Headless mode
+	static bool s_bHeadless;
+	std::function<void( int frame )> m_headlessInput;
+	std::function<void( int frame )> m_inputScript;
 	// A GDI+ token
 	static unsigned long long s_pGDIToken;
 };
@@ -1254,6 +1433,10 @@ public:
 		int originX{ 0 }, originY{ 0 }; // The origin and centre of rotation for the sprite (whole pixels only)
 		PixelData canvasBuffer; // The sprite image data
 		PixelData preMultAlpha; // The sprite data pre-multiplied with its own alpha
+		Pixel colour{ 0x00FFFFFF }; // The colour multiplied into preMultAlpha by ColourSprite
+		std::map< int, PixelData > scaledCopies; // Shrunk copies of preMultAlpha for each divisor which has been prepared or is in use
+		PixelData scaledPreMultAlpha; // The copy in scaledCopies for the resolution divisor (empty when the divisor is 1)
+		int scaledWidth{ -1 }, scaledHeight{ -1 }; // The width and height of a single image in scaledPreMultAlpha
 		Sprite() = default;
 	};
 
@@ -1276,6 +1459,22 @@ public:
 	// Sets the render target for drawing operations
 	PixelData* SetRenderTarget( PixelData* renderTarget ) { return m_blitter.SetRenderTarget( renderTarget ); }
 
+	// Resolution scaling functions
+	//********************************************************************************************************************************
+
+	// Draws into a drawing buffer divisor times smaller in each direction, which the window scales back up when it is shown
+	// > Everything is still drawn using display co-ordinates, and shrunk copies of the sprites and backgrounds are made to match
+	// > The divisor must divide the display width and height exactly, so the window can scale up by a whole number
+	// > Changing to a divisor which has been prepared only swaps the copies in use, otherwise every sprite is shrunk there and then
+	void SetResolutionDivisor( int divisor );
+	// Makes the shrunk copies for every valid divisor up to maxDivisor ahead of time (and keeps them up to date as sprites change)
+	// > Copies for larger divisors are freed unless they are in use, so 1 frees all the copies which aren't needed
+	void PrepareResolutionDivisors( int maxDivisor );
+	// Gets the resolution divisor (1 draws at the full display resolution)
+	int GetResolutionDivisor() const { return m_divisor; }
+	// Checks whether the display width and height can both be divided by the divisor
+	bool IsValidResolutionDivisor( int divisor ) const { return divisor > 0 && m_displayWidth % divisor == 0 && m_displayHeight % divisor == 0; }
+
 
 
 private:
@@ -1313,6 +1512,27 @@ private:
 	// Ends the current timing segment and calculates the duration
 	LARGE_INTEGER EndTimingSegment();
 
+	// Internal functions relating to resolution scaling
+	//********************************************************************************************************************************
+
+	// Converts a display co-ordinate to a drawing buffer co-ordinate
+	int ToBuffer( float displayPos ) const { return static_cast<int>( displayPos / m_divisor + 0.5f ); }
+	// Checks whether shrunk copies are kept for a divisor (the one in use, and any made by PrepareResolutionDivisors)
+	bool IsKeptResolutionDivisor( int divisor ) const { return divisor > 1 && IsValidResolutionDivisor( divisor ) && ( divisor == m_divisor || divisor <= m_maxPreparedDivisor ); }
+	// Makes the shrunk copies of a sprite for every divisor which is kept, and points scaledPreMultAlpha at the one in use
+	void ScaleSprite( Sprite& s );
+	// Makes the missing shrunk copies of a sprite, frees the ones which aren't kept, and points scaledPreMultAlpha at the one in use
+	void UpdateScaledSprite( Sprite& s );
+	// The same as UpdateScaledSprite for a background
+	void UpdateScaledBackground( size_t backgroundId );
+	// Makes a shrunk copy of a sprite for a divisor
+	PixelData ScaleSpritePixels( const Sprite& s, int divisor );
+	// Makes a shrunk copy of a background for a divisor
+	PixelData ScaleBackground( const PixelData& background, int divisor ) const;
+	// Averages each divisor x divisor block of pixels (weighted by alpha) to shrink a canvas of hCount x vCount frames
+	// > Each frame is shrunk separately, so the blocks at the edge of one frame never take pixels from the next
+	static void DownscalePixels( const Pixel* pSource, int sourceWidth, int frameWidth, int frameHeight, int hCount, int vCount, int divisor, Pixel* pDest );
+
 	struct TimingSegment
 	{
 		Pixel pix;
@@ -1332,13 +1552,21 @@ private:
 	PixelData m_playBuffer;
 	uint8_t* m_pDebugFontBuffer{ nullptr };
 
+	// The full size of the display, and how many times smaller m_playBuffer is in each direction
+	int m_displayWidth{ 0 };
+	int m_displayHeight{ 0 };
+	int m_divisor{ 1 };
+	// Shrunk copies are kept for every valid divisor up to this one (see PrepareResolutionDivisors)
+	int m_maxPreparedDivisor{ 1 };
+
 	// A vector of all the loaded sprites
 	std::vector< Sprite > vSpriteData;
 	// A vector of all the loaded backgrounds
 	std::vector< PixelData > vBackgroundData;
-
-	// A pointer to the static instance
-	static PlayGraphics* s_pInstance;
+	// Shrunk copies of each background for every divisor which has been prepared or is in use
+	std::vector< std::map< int, PixelData > > vScaledBackgroundCopies;
+	// The copies in vScaledBackgroundCopies for the resolution divisor (empty when the divisor is 1)
+	std::vector< PixelData > vScaledBackgroundData;
 
 };
 
@@ -1352,17 +1580,18 @@ private:
 
 // Encapsulates the functionality of a simple audio manager 
 // > A singleton class accessed using PlayAudio::Instance()
+// > MCI aliases belong to the whole process, so every context shares the same instance
 class PlayAudio
 {
 public:
 	// Instance access functions 
 	//********************************************************************************************************************************
 
-	// Instantiates class and loads all the .MP3 sounds from the directory provided
+	// Instantiates class and loads all the .MP3 sounds from the directory provided (or shares the instance another context already created)
 	static PlayAudio& Instance( const char* path );
 	// Returns the PlaySpeaker instance
 	static PlayAudio& Instance();
-	// Destroys the PlaySpeaker instance
+	// Releases the current context's use of the PlaySpeaker instance, which is destroyed once no context is using it
 	static void Destroy();
 
 	// Playing and stopping audio
@@ -1388,8 +1617,12 @@ private:
 
 	// Vector of mp3 strings
 	std::vector< std::string > vSoundStrings;
-	// Pointer to the singleton
+
+	// The shared instance and the number of contexts using it
 	static PlayAudio* s_pInstance;
+	static int s_instanceCount;
+	// Held while creating or destroying the instance, and while sending MCI commands from any context
+	static std::mutex s_mutex;
 };
 
 #endif
@@ -1403,6 +1636,9 @@ private:
 // Notes:		Obtains mouse data from PlayWindow via MouseData structure
 //********************************************************************************************************************************
 
+// The size of one frame's input in a recording: one bit per key, the mouse position and the mouse buttons
+constexpr size_t RECORDING_INPUT_SIZE = 32 + sizeof( float ) * 2 + 1;
+
 // Manages keyboard and mouse input 
 // > Singleton class accessed using PlayInput::Instance()
 class PlayInput
@@ -1429,7 +1665,7 @@ public:
 	// Returns the status of the supplied mouse button (0=left, 1=right)
 	bool GetMouseDown( MouseButton button ) const;
 	// Get the screen position of the mouse cursor
-	Point2f GetMousePos() const { return m_mouseData.pos; }
+	Point2f GetMousePos() const { return UsingScriptedState() ? m_scriptedMouse.pos : m_mouseData.pos; }
 	// Returns true if the key has been pressed since it was last released
 	// If you omit the frame number then only the first call in the same frame will ever return true
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
@@ -1437,9 +1673,35 @@ public:
 	// Returns true if the key is currently being held down
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 	bool KeyDown( int vKey );
+	// Makes KeyDown and KeyPressed use the key states set with SetKeyState instead of the keyboard
+	void SetScriptedInput( bool bScripted ) { m_bScriptedInput = bScripted; }
+	// Checks whether KeyDown and KeyPressed are using the key states set with SetKeyState
+	bool IsScriptedInput() const { return m_bScriptedInput; }
+	// Sets whether a key is down while using scripted input
+	void SetKeyState( int vKey, bool bDown );
 
 	MouseData* GetMouseData( void ) { return &m_mouseData; }
 
+	// Recording and replay functions
+	//********************************************************************************************************************************
+
+	// Records the keyboard and mouse every frame until StopRecording is called or the PlayInput is destroyed
+	// > Each frame is written to the file as it is recorded, so the recording survives a crash or an assert
+	// > Call before the manager is created so the random seed is recorded too
+	void StartRecording( const char* fileName );
+	// Closes the file the input is being recorded to
+	void StopRecording();
+	// Loads a recording and plays it back instead of using the keyboard and mouse
+	// > Call before the manager is created so the same random seed is used
+	bool StartReplay( const char* fileName );
+	// Checks whether a recording is being played back
+	bool IsReplaying() const { return m_replayPos < m_replay.size(); }
+	// Captures or plays back this frame's input, called by PlayWindow before each MainGameUpdate
+	// > Returns the elapsed time the game should use, which is the recorded one when replaying
+	float UpdateInput( float elapsedTime );
+	// Gets the seed for the random number generator (which is the recorded one when replaying)
+	unsigned int GetRandomSeed() const { return m_randomSeed; }
+
 private:
 
 	// Constructor / destructor
@@ -1454,10 +1716,25 @@ private:
 	// The copy constructor is removed to prevent copying of a singleton class
 	PlayInput( const PlayInput& ) = delete;
 
+	// Checks whether the scripted key states are being used (either set by the game or captured for the recording)
+	bool UsingScriptedState() const { return m_bScriptedInput || m_bRecordedInput; }
 
 	MouseData m_mouseData;
-	// Pointer to the singleton
-	static PlayInput* s_pInstance;
+	// Key states used instead of the keyboard for scripted input
+	bool m_bScriptedInput{ false };
+	bool m_scriptedKeys[256]{};
+	MouseData m_scriptedMouse;
+	// The keyboard and mouse have been captured into the scripted key states for this frame's recording
+	bool m_bRecordedInput{ false };
+	// Recording and replay
+	unsigned int m_randomSeed{ 0 };
+	std::ofstream m_recording;
+	size_t m_recordedFrames{ 0 };
+	uint8_t m_lastRecordedInput[RECORDING_INPUT_SIZE]{};
+	// The frame each key was last reported as pressed on by KeyPressed (0 once it has been released)
+	std::map< int, int > m_keyPressedFrames;
+	std::vector<uint8_t> m_replay;
+	size_t m_replayPos{ 0 };
 
 };
 
@@ -1465,6 +1742,214 @@ private:
 #endif
 
 
+#ifndef PLAY_PLAYTHREADPOOL_H
+#define PLAY_PLAYTHREADPOOL_H
+//********************************************************************************************************************************
+// File:		PlayThreadPool.h
+// Description:	A simple pool of worker threads for splitting loops across multiple cores
+// Platform:	Independent
+//********************************************************************************************************************************
+
+// A pool of worker threads which share out the iterations of a loop with the calling thread
+// > Unlike the managers this isn't a singleton: create one wherever you need one
+class PlayThreadPool
+{
+public:
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Starts the worker threads (the calling thread also does work, so 0 workers is a valid serial pool)
+	PlayThreadPool( int workerCount );
+	// Stops and joins all of the worker threads
+	~PlayThreadPool();
+
+	// Parallel functions
+	//********************************************************************************************************************************
+
+	// Calls job( begin, end ) on chunks of the range [0, count) using the workers and the calling thread
+	// > Returns once every chunk has been completed, so it also acts as a barrier
+	void ParallelFor( size_t count, size_t minChunkSize, const std::function< void( size_t, size_t ) >& job );
+	// Gets the number of worker threads (not including the calling thread)
+	int GetWorkerCount() const { return static_cast<int>( m_vWorkers.size() ); }
+
+private:
+	// The assignment operator is removed to prevent copying of the threads
+	PlayThreadPool& operator=( const PlayThreadPool& ) = delete;
+	// The copy constructor is removed to prevent copying of the threads
+	PlayThreadPool( const PlayThreadPool& ) = delete;
+
+	// The loop run by each of the worker threads
+	void WorkerLoop();
+	// Takes chunks of the current job until there are none left
+	void RunChunks();
+
+	std::vector< std::thread > m_vWorkers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	// The current job
+	const std::function< void( size_t, size_t ) >* m_pJob{ nullptr };
+	size_t m_count{ 0 };
+	size_t m_chunkSize{ 0 };
+	std::atomic< size_t > m_nextChunk{ 0 };
+
+	// Synchronisation state (protected by m_mutex)
+	int m_busyWorkers{ 0 };
+	unsigned int m_generation{ 0 };
+	bool m_bQuit{ false };
+};
+
+//********************************************************************************************************************************
+// File:		PlaySocket.h
+// Description:	A non-blocking UDP socket for passing small messages between programs on the same machine
+// Platform:	Windows
+//********************************************************************************************************************************
+
+// A UDP socket on the loopback address which sends to one port and receives on another
+// > Like PlayThreadPool this isn't a singleton: create one for each connection
+// > Messages may be lost or arrive out of order, so anything important should be sent more than once
+class PlaySocket
+{
+public:
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Starts up Winsock (the socket isn't opened until Open is called)
+	PlaySocket();
+	// Closes the socket and shuts down Winsock
+	~PlaySocket();
+
+	// Connection functions
+	//********************************************************************************************************************************
+
+	// Opens the socket to receive on localPort and send to remotePort
+	// > Returns false if the local port is already in use
+	bool Open( int localPort, int remotePort );
+	// Closes the socket
+	void Close();
+	// Checks whether the socket is open
+	bool IsOpen() const { return m_socket != INVALID_SOCKET; }
+
+	// Message functions
+	//********************************************************************************************************************************
+
+	// Sends a message to the remote port without waiting for it to be received
+	void Send( const void* pData, int size );
+	// Copies the next message which has arrived into pData and returns its size
+	// > Returns 0 straight away if there are no messages waiting
+	int Receive( void* pData, int maxSize );
+
+private:
+	// The assignment operator is removed to prevent copying of the socket
+	PlaySocket& operator=( const PlaySocket& ) = delete;
+	// The copy constructor is removed to prevent copying of the socket
+	PlaySocket( const PlaySocket& ) = delete;
+
+	SOCKET m_socket{ INVALID_SOCKET };
+	sockaddr_in m_remoteAddress{};
+};
+
+//********************************************************************************************************************************
+// File:		PlayFrameCapture.h
+// Description:	Records frames to disk on worker threads without holding up the game
+// Platform:	Windows
+//********************************************************************************************************************************
+
+// Records frames as numbered PNG files or as one delta compressed video file, compressing them on worker threads
+// > Capture swaps the finished frame's pixels for a free buffer, so the game thread never copies or compresses anything
+// > When every buffer is still waiting to be compressed the frame is dropped (and counted) instead of waiting for the workers
+// > The video file is "PLVD", a version, the width and the height (as 32 bit values), then for each frame its number, its size in bytes,
+//   and runs of ( unchanged pixels, changed pixels, the changed pixels ) compared with the frame before it
+class PlayFrameCapture
+{
+public:
+	enum Format
+	{
+		CAPTURE_PNG = 0, // path_000000.png, path_000001.png etc.
+		CAPTURE_VIDEO, // One file at path
+	};
+
+	// How many frames have been handed to Capture, written to disk, dropped and failed to write
+	struct Stats
+	{
+		int captured{ 0 };
+		int written{ 0 };
+		int dropped{ 0 };
+		int failed{ 0 }; // Such as when the output directory doesn't exist or the disk is full
+	};
+
+	// Constructor / destructor
+	//********************************************************************************************************************************
+
+	// Starts the worker threads, with bufferCount frames' worth of buffers for frames waiting to be compressed
+	PlayFrameCapture( const char* path, Format format, int width, int height, int workerCount, int bufferCount );
+	// Calls Finish and frees the buffers
+	~PlayFrameCapture();
+
+	// Capture functions
+	//********************************************************************************************************************************
+
+	// Hands a finished frame to the workers, and replaces pPixels with a free buffer (which holds an old frame)
+	// > Returns false if the frame was dropped, in which case pPixels is left alone
+	bool Capture( Pixel*& pPixels );
+	// Gets how many frames have been captured, written, dropped and failed to write so far
+	Stats GetStats();
+	// Finishes writing every frame which has been captured, then stops the worker threads (nothing more can be captured afterwards)
+	void Finish();
+
+private:
+	// The assignment operator is removed to prevent copying of the threads
+	PlayFrameCapture& operator=( const PlayFrameCapture& ) = delete;
+	// The copy constructor is removed to prevent copying of the threads
+	PlayFrameCapture( const PlayFrameCapture& ) = delete;
+
+	// A frame waiting to be compressed
+	struct Job
+	{
+		int frame{ 0 }; // Counts dropped frames too, so gaps in the numbers show where frames were dropped
+		int order{ 0 }; // The order the video frames are written in
+		Pixel* pPixels{ nullptr };
+		Pixel* pPrevious{ nullptr }; // The frame the video frame is compared with (nullptr for the first one)
+	};
+
+	// The loop run by each of the worker threads
+	void WorkerLoop();
+	// Saves a frame as a PNG file, and returns false if it couldn't be saved
+	bool WritePNG( const Job& job );
+	// Compresses a frame against the one before it and writes it to the video file in order
+	// > Returns false if the video file can't be written to
+	bool WriteVideoFrame( const Job& job );
+	// Gives back a reference to a buffer, which is free again once nothing refers to it (call with m_mutex locked)
+	void ReleaseBuffer( Pixel* pPixels );
+
+	std::string m_path;
+	Format m_format;
+	int m_width;
+	int m_height;
+	CLSID m_pngEncoder{};
+	std::vector< std::thread > m_vWorkers;
+
+	// Protected by m_mutex
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::deque< Job > m_queue;
+	std::vector< Pixel* > m_freeBuffers;
+	std::unordered_map< Pixel*, int > m_bufferReferences;
+	Pixel* m_pLastFrame{ nullptr };
+	int m_nextOrder{ 0 };
+	Stats m_stats;
+	bool m_bQuit{ false };
+
+	// Protected by m_writeMutex (video frames can finish out of order, so they wait here until the frames before them are written)
+	std::mutex m_writeMutex;
+	std::ofstream m_videoFile;
+	std::map< int, std::vector< uint8_t > > m_finishedFrames;
+	int m_nextWrite{ 0 };
+};
+
+#endif
+
 #ifndef PLAY_PLAYMANAGER_H
 #define PLAY_PLAYMANAGER_H
 //********************************************************************************************************************************
@@ -1480,38 +1965,80 @@ private:
 #define PLAY_ADD_GAMEOBJECT_MEMBERS 
 #endif
 
-// PlayManager manges a map of GameObject structures
-struct GameObject
+// A value kept in 16.16 fixed point for Play::SetFixedPointPhysics, alongside the float the game reads and writes
+// > 64 bits holds positions up to 2^47 pixels away, so there's no overflow however far the camera scrolls
+struct FixedPointValue
 {
-	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+	int64_t fixed{ 0 };
+	float asFloat{ 0.0f }; // What the fixed point value was last rounded to, so a change the game makes to the float can be spotted
+};
+
+namespace Play
+{
+	struct GameObjectStore;
+	struct GameObjectBlock;
+}
 
+// The data members of a GameObject which live in the object itself, kept apart so that snapshots can copy them byte for byte
+// > GameObject itself can't be copied (its copy operations are deleted), so this is what has to stay trivially copyable
+struct GameObjectData
+{
 	// Default member variables: don't change these!
 	int type{ -1 };
 	int oldType{ -1 };
 	int spriteId{ -1 };
-	Point2D pos{ 0.0f, 0.0f };
-	Point2D oldPos{ 0.0f, 0.0f };
-	Vector2D velocity{ 0.0f, 0.0f };
-	Vector2D acceleration{ 0.0f, 0.0f };
-	float rotation{ 0.0f };
-	float rotSpeed{ 0.0f };
-	float oldRot{ 0.0f };
-	int frame{ 0 };
-	float framePos{ 0.0f };
-	float animSpeed{ 0.0f };
 	int radius{ 0 };
+	Vector2D aabb{ 0.0f, 0.0f }; // Half-size of the collision box used by MoveAndCollide (the radius is used when this is zero)
 	float scale{ 1 };
-	int lastFrameUpdated{ -1 };
+	// The exact position, velocity, rotation and frame position when using Play::SetFixedPointPhysics (the floats above are rounded copies)
+	FixedPointValue fixedPos[2];
+	FixedPointValue fixedVelocity[2];
+	FixedPointValue fixedRotation;
+	FixedPointValue fixedFramePos;
 
 	// Add your own data members here if you want to
+	// > Snapshots copy GameObjects byte for byte, so these have to be plain data too (no std::string, containers or owning pointers)
 	PLAY_ADD_GAMEOBJECT_MEMBERS
 
+protected:
+	// The GameObject's id should never be changed manually so we make it protected!
+	int m_id{ -1 };
+};
+
+// PlayManager manges a map of GameObject structures
+// > The members which UpdateAllGameObjects integrates live in structure-of-arrays blocks owned by the context, and GameObject refers to its own slot in them
+struct GameObject : GameObjectData
+{
+	GameObject( int type, Point2D pos, int collisionRadius, int spriteId );
+	// Used by the PlayManager for objects which are kept apart from the ones UpdateAllGameObjects updates
+	GameObject( int type, Point2D pos, int collisionRadius, int spriteId, Play::GameObjectStore& store );
+	~GameObject();
+
 	int GetId() { return m_id; }
 
 private:
-	// The GameObject's id should never be changed manually so we make it private!
-	int m_id{ -1 };
+	// The slot holding the members below (declared before them so it is set first)
+	Play::GameObjectStore* m_pStore;
+	int m_slot;
+
+	Play::GameObjectBlock& Block() const;
+	int Index() const;
+
+public:
+	// Default member variables which live in the context's store: don't change these!
+	Point2D& pos;
+	Point2D& oldPos;
+	Vector2D& velocity;
+	Vector2D& acceleration;
+	float& rotation;
+	float& rotSpeed;
+	float& oldRot;
+	int& frame;
+	float& framePos;
+	float& animSpeed;
+	int& lastFrameUpdated;
 
+private:
 	// Preventing assignment and copying reduces the potential for bugs
 	GameObject& operator=( const GameObject& ) = delete;
 	GameObject( const GameObject& ) = delete;
@@ -1552,9 +2079,101 @@ namespace Play
 
 	extern Colour cBlack, cRed, cGreen, cBlue, cMagenta, cCyan, cYellow, cOrange, cWhite, cGrey;
 
+	// A list of everything to draw for one frame, filled in by the game and drawn later by RunPipelined's render thread
+	// > Everything a drawing function needs is copied in when it is recorded, so the game is free to change while the frame is drawn
+	class RenderSnapshot
+	{
+	public:
+		// Recording functions (these work the same as the Play drawing functions with the same names)
+		//**************************************************************************************************
+
+		void ClearDrawingBuffer( Colour col );
+		void DrawBackground( int background = 0 );
+		void DrawSprite( int spriteID, Point2D pos, int frame );
+		void DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale = 1.0f, float opacity = 1.0f );
+		void DrawRect( Point2D topLeft, Point2D bottomRight, Colour col, bool fill = false );
+		void DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify = LEFT );
+		void DrawDebugText( Point2D pos, const char* text, Colour col = cWhite, bool centred = true );
+		// Moves the camera for the commands recorded after this one (the camera is put back once the frame has been drawn)
+		void SetCameraPosition( Point2f pos );
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		// Records the object's sprite at the position Play::DrawObject would draw it
+		void DrawObject( GameObject& obj );
+		// Records the object's sprite at the position and rotation Play::DrawObjectRotated would draw it
+		void DrawObjectRotated( GameObject& obj, float opacity = 1.0f );
+#endif
+
+		// Removes everything recorded (but keeps the memory for the next frame)
+		void Reset() { m_commands.clear(); }
+		// Checks whether two snapshots would draw exactly the same frame
+		bool IsSameAs( const RenderSnapshot& other ) const;
+		// Draws everything recorded into the drawing buffer
+		void Render() const;
+
+	private:
+		enum CommandType
+		{
+			COMMAND_CLEAR = 0,
+			COMMAND_BACKGROUND,
+			COMMAND_SPRITE,
+			COMMAND_SPRITE_ROTATED,
+			COMMAND_RECT,
+			COMMAND_FONT_TEXT,
+			COMMAND_DEBUG_TEXT,
+			COMMAND_CAMERA,
+		};
+
+		struct Command
+		{
+			CommandType type{ COMMAND_CLEAR };
+			int id{ 0 }; // Sprite id, background index, alignment or flag depending on the type
+			int frame{ 0 };
+			Point2f pos{ 0.0f, 0.0f };
+			Point2f pos2{ 0.0f, 0.0f };
+			float angle{ 0.0f };
+			float scale{ 1.0f };
+			float opacity{ 1.0f };
+			Colour colour{ 0.0f, 0.0f, 0.0f };
+			std::string font;
+			std::string text;
+		};
+
+		std::vector<Command> m_commands;
+	};
+
 	// Manager creation and deletion
 	//**************************************************************************************************
 
+	// Everything which belongs to one game: the PlayWindow, PlayGraphics, PlayAudio and PlayInput instances, the GameObjects, the camera and the timing
+	// > Every Play function (and each class's Instance function) works on the calling thread's current context
+	// > Threads use a default context until SetCurrentContext is called, so a single game never needs to know about contexts
+	// > To run several games at once (usually headless), give each thread its own context and call CreateManager on it
+	class Context
+	{
+	public:
+		Context();
+		// Frees the GameObjects (call DestroyManager first to shut down the instances)
+		~Context();
+
+		// The instances created by CreateManager (used by Instance)
+		PlayWindow* pWindow{ nullptr };
+		PlayGraphics* pGraphics{ nullptr };
+		PlayAudio* pAudio{ nullptr };
+		PlayInput* pInput{ nullptr };
+		// Everything else, which is only defined in the implementation
+		struct ContextState* pState{ nullptr };
+
+	private:
+		// Preventing assignment and copying as a context owns its instances
+		Context& operator=( const Context& ) = delete;
+		Context( const Context& ) = delete;
+	};
+
+	// Makes the context current on the calling thread (nullptr goes back to the default context)
+	void SetCurrentContext( Context* pContext );
+	// Gets the calling thread's current context
+	Context& GetCurrentContext();
+
 	// Initialises the managers and creates a window of the required dimensions
 	void CreateManager( int width, int height, int scale );
 	// Shuts down the managers and closes the window
@@ -1565,6 +2184,36 @@ namespace Play
 
 	// Copies the contents of the drawing buffer to the window
 	void PresentDrawingBuffer();
+	// Publishes every frame PresentDrawingBuffer shows into a ring of slots in named shared memory, for other programs to read
+	// > See PlayWindow::FrameExportHeader for the layout, and PlayWindow::StartFrameExport for how it is read
+	bool StartFrameExport( const char* name, int slotCount = 3 );
+	// Stops publishing frames to shared memory
+	void StopFrameExport();
+	// Shows each frame on a separate thread while the game draws the next one into another buffer (triple buffering)
+	// > The drawing buffer is swapped for a free buffer each frame, so the game must draw the whole screen every frame while this is on
+	void SetPresentThread( bool threaded );
+	// Shares the upscaling of each frame (when the display scale is more than 1) with this many worker threads
+	void SetUpscaleThreads( int workerCount );
+	// Gets how long the last frame took to upscale in milliseconds
+	double GetUpscaleMs();
+	// Draws at 1/divisor of the display resolution in each direction and scales the frames back up when they are shown
+	// > Everything is still drawn using display co-ordinates (see PlayGraphics::SetResolutionDivisor)
+	void SetResolutionDivisor( int divisor );
+	// Gets the current resolution divisor (1 is the full display resolution)
+	int GetResolutionDivisor();
+	// Lowers the resolution one step at a time while drawing and showing a frame takes longer than budgetMs, and raises it again once there is room
+	// > With RunPipelined this is the time the render thread spends drawing plus the time taken to show the frame (see PlayWindow::GetLastPresentMs)
+	// > The shrunk sprites and backgrounds for every divisor are made here, so changing the resolution later doesn't stall a frame
+	// > The resolution never goes lower than 1/maxDivisor of the display, and 0 turns this off and goes back to the full resolution
+	// > The full resolution is kept while frames are being captured or exported, as they are all expected to be the same size
+	void SetDynamicResolution( float budgetMs, int maxDivisor = 4 );
+	// Records every frame PresentDrawingBuffer shows, compressing them on worker threads (see PlayFrameCapture)
+	// > The drawing buffer is swapped for a free buffer each frame, so the game must draw the whole screen every frame while capturing
+	void StartFrameCapture( const char* path, PlayFrameCapture::Format format, int workerCount = 2, int bufferCount = 4 );
+	// Finishes writing the captured frames and stops recording, returning the final statistics
+	PlayFrameCapture::Stats StopFrameCapture();
+	// Gets how many frames have been captured, written and dropped
+	PlayFrameCapture::Stats GetFrameCaptureStats();
 	// Gets the co-ordinates of the mouse cursor within the display buffer
 	Point2D GetMousePos();
 	// Gets the status of the left or right mouse buttons
@@ -1574,6 +2223,31 @@ namespace Play
 	// Gets the height of the display buffer
 	int GetBufferHeight();
 
+	// Timing functions
+	//**************************************************************************************************
+
+	// Sets the frame rate the window tries to run at (0 runs as fast as possible)
+	void SetTargetFrameRate( int framesPerSecond );
+	// Gets how many milliseconds late the frame pacer has been waking up
+	const PlayWindow::FramePacingStats& GetFramePacingStats();
+
+	// Sets how often RunFixedTimestep updates the game, and the most updates it will run in one frame to catch up
+	void SetFixedTimestep( int updatesPerSecond, int maxUpdatesPerFrame = 5 );
+	// Call from MainGameUpdate to run the game logic at a fixed rate, whatever the frame rate is
+	// > Calls update as many times as needed to catch up with elapsedTime, then calls render once
+	// > render is passed how far it is from the last update to the next one (0-1), and the DrawObject functions use this to draw objects between their oldPos and pos
+	// > Returns true as soon as update does (to quit)
+	bool RunFixedTimestep( float elapsedTime, const std::function<bool()>& update, const std::function<void( float )>& render );
+	// Works like RunFixedTimestep, but draws each frame on a separate thread while the next frame's updates run
+	// > describe records the frame into a RenderSnapshot instead of drawing it, and shouldn't call PresentDrawingBuffer
+	// > The game must only draw through the snapshot (not the Play drawing or camera functions) while this is in use
+	// > Each frame is shown one call later than it would be with RunFixedTimestep
+	// > A frame which is the same as the last one isn't drawn or presented again, and the window waits for input until something changes
+	bool RunPipelined( float elapsedTime, const std::function<bool()>& update, const std::function<void( RenderSnapshot&, float )>& describe );
+	// Starts a new frame without presenting anything, so every GameObject can be updated again
+	// > Used to re-simulate frames after going back to an earlier snapshot
+	void NextFrame();
+
 	// PlayAudio functions
 	//**************************************************************************************************
 
@@ -1677,7 +2351,7 @@ namespace Play
 	// > Note that colouring affects subsequent DrawSprite calls using the same sprite!!
 	void DrawSpriteCircle( Point2D pos, int radius, const char* penSprite, Colour c = cWhite );
 	// Draws text using a sprite-based font exported from PlayFontTool
-	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify = LEFT );
+	void DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify = LEFT );
 	// Adds a sprite dynamically from memory (custom asset pipelines)
 
 	// Resets the timing bar data and sets the current timing bar segment to a specific colour
@@ -1709,6 +2383,26 @@ namespace Play
 	// Performs a typical update of the object's position and animation
 	// > Cam only be called once per object per frame unless allowMultipleUpdatesPerFrame is set to true
 	void UpdateGameObject( GameObject& object, bool bWrap = false, int wrapBorderSize = 0, bool allowMultipleUpdatesPerFrame = false );
+	// Performs a typical update of the position and animation of every GameObject in a single batched pass
+	// > Gives exactly the same results as calling UpdateGameObject on each object, but updates four objects at a time
+	// > The members it integrates are kept in structure-of-arrays blocks owned by the context, so it streams through them without copying anything
+	void UpdateAllGameObjects( bool bWrap = false, int wrapBorderSize = 0 );
+	// Sets the number of threads UpdateAllGameObjects splits its work across (including the game thread)
+	// > 1 updates on the game thread only (the default) and 0 uses one thread per core
+	// > Objects must not be created or destroyed while an update is running
+	void SetUpdateThreadCount( int threadCount );
+	// Gets the number of threads used by UpdateAllGameObjects
+	int GetUpdateThreadCount();
+	// Sets whether UpdateGameObject and UpdateAllGameObjects integrate in 16.16 fixed point instead of floating point
+	// > Integer maths gives bit-for-bit identical results with any compiler, optimisation level or thread count, which replays and lockstep rely on
+	// > Each GameObject keeps its exact fixed point state, and pos, velocity, rotation and framePos are rounded copies of it for the game to use
+	// > Changing one of those floats in the game replaces the fixed point value with it at the next update
+	void SetFixedPointPhysics( bool enabled );
+	// Returns true if GameObjects are being integrated in fixed point
+	bool GetFixedPointPhysics();
+	// Moves every GameObject (and its oldPos) by the same offset, such as when a scrolling game moves its origin to keep the co-ordinates small
+	// > The fixed point positions are moved by the exact offset too, so nothing is rounded away
+	void MoveAllGameObjects( Vector2D offset );
 	// Deletes the GameObject with the corresponding id
 	//> Use GameObject.GetId() to find out its unique id
 	void DestroyGameObject( int id );
@@ -1717,6 +2411,70 @@ namespace Play
 	
 	// Checks whether the two objects are within each other's collision radii
 	bool IsColliding( GameObject& obj1, GameObject& obj2 );
+	// Collects the IDs of the GameObjects whose collision radius overlaps the given circle
+	// > Set type to -1 to find objects of any type
+	std::vector<int> QueryCircle( Point2D pos, float radius, int type = -1 );
+	// Collects the IDs of the GameObjects whose collision radius overlaps the given rectangle
+	// > Set type to -1 to find objects of any type
+	std::vector<int> QueryAABB( Point2D topLeft, Point2D bottomRight, int type = -1 );
+	// Collects the IDs of every pair of objects of the given types which are colliding (as IsColliding)
+	// > The first ID in each pair has typeA and the second has typeB
+	std::vector<std::pair<int, int>> CollectCollidingPairs( int typeA, int typeB );
+	// Updates the object's position in the spatial index used by the query functions
+	// > This happens automatically in UpdateGameObject, so is only needed if you move an object without updating it
+	void UpdateSpatialIndex( GameObject& obj );
+	// Sets the size of the cells in the spatial index (ideally a bit bigger than a typical object)
+	void SetSpatialIndexCellSize( float cellSize );
+
+	// Details of a contact found by one of the sweep functions
+	struct SweepHit
+	{
+		int id{ -1 }; // The GameObject which was hit (only set by MoveAndCollide)
+		float time{ 1.0f }; // How far through the movement the contact happened (0-1)
+		Vector2D normal{ 0.0f, 0.0f }; // The direction of the surface which was hit, pointing back towards the moving shape
+		Point2D pos{ 0.0f, 0.0f }; // The position of the moving shape at the moment of contact
+	};
+	// Finds when a box moving by the given amount first touches a stationary box (boxes are a centre and half-size)
+	// > Returns false if they don't touch, or if the boxes already overlap and the movement is separating them
+	bool SweepAABB( Point2D pos, Vector2D halfSize, Vector2D move, Point2D otherPos, Vector2D otherHalfSize, SweepHit& hit );
+	// Finds when a circle moving by the given amount first touches a stationary box
+	bool SweepCircleAABB( Point2D pos, float radius, Vector2D move, Point2D boxPos, Vector2D boxHalfSize, SweepHit& hit );
+	// Finds when a circle moving by the given amount first touches a stationary circle
+	bool SweepCircle( Point2D pos, float radius, Vector2D move, Point2D otherPos, float otherRadius, SweepHit& hit );
+	// Performs the same update as UpdateGameObject, but stops at any object of the given types in the way and bounces off it
+	// > Objects collide as boxes if their aabb is set and as circles otherwise
+	// > Several hits are resolved in the same frame (up to maxHits) so fast objects can't pass through anything
+	// > Returns the hits in the order they happened
+	std::vector<SweepHit> MoveAndCollide( GameObject& obj, const std::vector<int>& types, int maxHits = 4, bool allowMultipleUpdatesPerFrame = false );
+
+	// Whether a contact has just started, is continuing from the last update, or has just finished
+	enum ContactState
+	{
+		CONTACT_BEGIN = 0,
+		CONTACT_STAY,
+		CONTACT_END,
+	};
+
+	// A collision between two objects found by UpdateContacts
+	struct Contact
+	{
+		int idA{ -1 }; // The object with the first type in the registered pair
+		int idB{ -1 }; // The object with the second type in the registered pair
+		int typeA{ -1 };
+		int typeB{ -1 };
+		ContactState state{ CONTACT_BEGIN };
+		Vector2D normal{ 0.0f, 0.0f }; // The direction object A would need to move to separate from object B
+		float penetration{ 0.0f }; // How far the objects overlap along the normal (0 for MoveAndCollide hits)
+		bool bSwept{ false }; // MoveAndCollide hit this pair since the last update (a new hit can happen while a contact stays)
+	};
+	// Asks UpdateContacts to report collisions between objects of these two types
+	void RegisterCollisionPair( int typeA, int typeB );
+	// Finds every collision between the registered types, including hits from MoveAndCollide since the last call
+	// > Call this once per frame after everything has moved, then read the results with GetContacts
+	void UpdateContacts();
+	// Gets the contacts found by the last call to UpdateContacts, sorted by idA and then idB
+	// > Contacts which ended this frame are included (as CONTACT_END) even if one of the objects has since been destroyed
+	const std::vector<Contact>& GetContacts();
 	// Checks whether any part of the object is visible within the DisplayBuffer
 	bool IsVisible( GameObject& obj );
 	// Checks whether the object is overlapping the edge of the screen and moving outwards 
@@ -1738,6 +2496,78 @@ namespace Play
 	// Draws the object's sprite with rotation and transparency (slower than DrawObject)
 	void DrawObjectRotated( GameObject& obj, float opacity = 1.0f );
 
+	// Snapshot functions
+	//**************************************************************************************************
+
+	// Adds a block of plain data (no pointers) to every snapshot, such as the game's state struct
+	// > The block is copied byte for byte, so it has to stay at the same address for as long as snapshots are taken
+	void RegisterSnapshotState( void* pData, size_t size );
+	// Adds a vector of plain data to every snapshot (restoring a snapshot resizes the vector to match)
+	template< typename T > void RegisterSnapshotState( std::vector<T>& data );
+	// Adds anything else to every snapshot: save appends the data to the snapshot and load reads it back
+	// > load is given a pointer to where save started writing and returns the number of bytes it read
+	void RegisterSnapshotCallbacks( std::function<void( std::vector<uint8_t>& snapshot )> save, std::function<size_t( const uint8_t* pData )> load );
+	// Forgets all of the registered state
+	void ClearSnapshotState();
+	// Copies every GameObject and all of the registered state into the snapshot (reusing its memory)
+	// > Also saves the random number stream, the camera position, the next GameObject id and the contacts UpdateContacts compares against
+	// > GameObjects are copied byte for byte, so every member (including PLAY_ADD_GAMEOBJECT_MEMBERS) must be plain data
+	void TakeSnapshot( std::vector<uint8_t>& snapshot );
+	// Puts every GameObject and all of the registered state back how it was when the snapshot was taken
+	// > Objects created since are destroyed, and objects destroyed since are recreated with their old ids
+	void RestoreSnapshot( const std::vector<uint8_t>& snapshot );
+
+	// Keeps the most recent snapshots so a game can be rewound a frame at a time
+	// > Only the newest snapshot is kept whole: each older one is stored as the bytes which differ from the one after it, which is usually a small fraction of a frame
+	class RewindHistory
+	{
+	public:
+		// Creates a history of up to this many snapshots (the oldest is dropped to make room for a new one)
+		RewindHistory( size_t capacity );
+		// Adds a snapshot to the history
+		void Push( const std::vector<uint8_t>& snapshot );
+		// Drops the newest snapshots and copies the one which is then the newest into snapshot
+		// > Stops at the oldest snapshot, and returns false if the history is empty
+		bool Rewind( int frames, std::vector<uint8_t>& snapshot );
+		// Empties the history
+		void Clear();
+		// Gets the number of snapshots in the history
+		size_t GetCount() const;
+		// Gets the number of bytes used to store the snapshots
+		size_t GetMemoryUsed() const;
+
+	private:
+		// The newest snapshot
+		std::vector<uint8_t> m_latest;
+		bool m_bHasLatest{ false };
+		// A ring of the differences between each older snapshot and the one after it (the vectors keep their capacity when reused)
+		std::vector< std::vector<uint8_t> > m_deltas;
+		size_t m_first{ 0 };
+		size_t m_count{ 0 };
+	};
+
+	// Not exposed externally
+	// > Used by the RegisterSnapshotState template
+	void AppendSnapshotBytes( std::vector<uint8_t>& snapshot, const void* pData, size_t size );
+
+	template< typename T > void RegisterSnapshotState( std::vector<T>& data )
+	{
+		RegisterSnapshotCallbacks( [&data]( std::vector<uint8_t>& snapshot )
+		{
+			uint32_t count = static_cast<uint32_t>( data.size() );
+			AppendSnapshotBytes( snapshot, &count, sizeof( count ) );
+			AppendSnapshotBytes( snapshot, data.data(), count * sizeof( T ) );
+		},
+		[&data]( const uint8_t* pData ) -> size_t
+		{
+			uint32_t count = 0;
+			memcpy( &count, pData, sizeof( count ) );
+			data.resize( count );
+			memcpy( static_cast<void*>( data.data() ), pData + sizeof( count ), count * sizeof( T ) );
+			return sizeof( count ) + count * sizeof( T );
+		} );
+	}
+
 #endif
 
 	// Miscellaneous functions
@@ -1749,7 +2579,52 @@ namespace Play
 	// Returns true if the key is currently being held down
 	// > https://docs.microsoft.com/en-us/windows/win32/inputdev/virtual-key-codes
 	bool KeyDown( int vKey );
+	// Sets whether a key is down when the keyboard isn't being used (in headless mode)
+	void SetKeyState( int vKey, bool down );
+	// Switches between the keyboard and the key states set with SetKeyState (headless mode always uses SetKeyState)
+	void SetScriptedInput( bool scripted );
+	// Checks whether the key states set with SetKeyState are being used instead of the keyboard
+	bool IsScriptedInput();
+	// Sets the function called at the start of every headless frame to set up the key states with SetKeyState
+	void SetHeadlessInput( std::function<void( int frame )> input );
+	// Sets the function called at the start of every frame (with or without a window) to script the key states with SetKeyState
+	// > It's called before the frame's input is recorded, so recordings replay the keys it pressed (it isn't called while replaying)
+	void SetInputScript( std::function<void( int frame )> script );
+
+	// The stream used by a RandomStream unless another one is chosen (which gives the standard PCG32 increment)
+	constexpr uint64_t RANDOM_DEFAULT_STREAM = 721347520444481703ULL;
+
+	// A fast random number generator (PCG32) with its own state
+	// > Gives the same sequence for the same seed on every platform
+	// > The stream number picks one of 2^63 different sequences, so separate simulations or threads seeded alike can still each have their own
+	class RandomStream
+	{
+	public:
+		RandomStream( uint64_t seed = 0, uint64_t stream = RANDOM_DEFAULT_STREAM ) { Seed( seed, stream ); }
+		// Restarts the sequence from the given seed, on the given stream
+		void Seed( uint64_t seed, uint64_t stream = RANDOM_DEFAULT_STREAM );
+		// Returns the next 32 random bits
+		uint32_t Next();
+		// Returns a random number as if you rolled a die with this many sides
+		int Roll( int sides );
+		// Returns a random number from min to max inclusive
+		int RollRange( int min, int max );
+		// Gets the position in the sequence, so it can be saved and restored along with the rest of a simulation
+		// > The stream doesn't change until the next Seed, and copying the whole RandomStream saves both
+		uint64_t GetState() const { return m_state; }
+		// Restores a position returned by GetState
+		void SetState( uint64_t state ) { m_state = state; }
+
+	private:
+		uint64_t m_state{ 0 };
+		uint64_t m_increment{ 1 }; // Always odd, and different for every stream
+	};
 
+	// Gets the stream used by RandomRoll and RandomRollRange
+	// > Seeded by CreateManager from the time (or the seed of the input recording being replayed)
+	RandomStream& GetRandomStream();
+	// Restarts the sequence used by RandomRoll and RandomRollRange from the given seed (and optionally on another stream)
+	void SeedRandom( uint64_t seed, uint64_t stream = RANDOM_DEFAULT_STREAM );
 	// Returns a random number as if you rolled a die with this many sides
 	int RandomRoll( int sides );
 	// Returns a random number from min to max inclusive
@@ -1828,6 +2703,16 @@ struct ALLOC
 ALLOC g_allocations[MAX_ALLOCATIONS];
 unsigned int g_allocCount = 0;
 
+// The render and worker threads allocate too, so every access to the allocation list holds this lock
+// > It's recursive because printing the allocations can allocate
+// > It's created on first use because new can be called before any globals are constructed, and never destroyed because delete can be called after
+std::recursive_mutex& GetAllocationMutex( void )
+{
+	alignas( std::recursive_mutex ) static char storage[sizeof( std::recursive_mutex )];
+	static std::recursive_mutex* pAllocationMutex = ::new( storage ) std::recursive_mutex;
+	return *pAllocationMutex;
+}
+
 
 void CreateStaticObject( void );
 void PrintAllocation( const char* tagText, ALLOC& a );
@@ -1841,6 +2726,7 @@ void PrintAllocation( const char* tagText, ALLOC& a );
 // the safest approach. The two definitions of new without the file and line pick up any other memory allocations for completeness.
 void* operator new( size_t size, const char* file, int line )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
 	CreateStaticObject();
 	void* p = malloc( size );
@@ -1850,6 +2736,7 @@ void* operator new( size_t size, const char* file, int line )
 
 void* operator new[]( size_t size, const char* file, int line )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
 	CreateStaticObject();
 	void* p = malloc( size );
@@ -1859,6 +2746,7 @@ void* operator new[]( size_t size, const char* file, int line )
 
 void* operator new( size_t size )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
 	CreateStaticObject();
 	void* p = malloc( size );
@@ -1868,6 +2756,7 @@ void* operator new( size_t size )
 
 void* operator new[]( size_t size )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	PLAY_ASSERT( g_allocCount < MAX_ALLOCATIONS );
 	CreateStaticObject();
 	void* p = malloc( size );
@@ -1892,6 +2781,7 @@ int g_id = -1;
 
 void operator delete( void* p )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	for( unsigned int a = 0; a < g_allocCount; a++ )
 	{
 		if( g_allocations[a].address == p )
@@ -1916,6 +2806,7 @@ void operator delete[]( void* p, const char* file, int line )
 
 void operator delete[]( void* p )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	for( unsigned int a = 0; a < g_allocCount; a++ )
 	{
 		if( g_allocations[a].address == p )
@@ -1986,6 +2877,7 @@ void PrintAllocation( const char* tagText, ALLOC& a )
 
 void PrintAllocations( const char* tagText )
 {
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
 	int bytes = 0;
 	char buffer[MAX_FILENAME * 2] = { 0 };
 	DebugOutput( "****************************************************\n" );
@@ -2003,6 +2895,21 @@ void PrintAllocations( const char* tagText )
 
 }
 
+unsigned int GetAllocationCount()
+{
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
+	return g_allocCount;
+}
+
+size_t GetAllocatedBytes()
+{
+	std::lock_guard<std::recursive_mutex> lock( GetAllocationMutex() );
+	size_t bytes = 0;
+	for( unsigned int n = 0; n < g_allocCount; n++ )
+		bytes += g_allocations[n].size;
+	return bytes;
+}
+
 #pragma pop_macro("new")
 
 #endif
@@ -2018,7 +2925,7 @@ void PrintAllocations( const char* tagText )
 #pragma comment(lib, "gdiplus.lib")
 #pragma comment(lib, "dwmapi.lib")
 
-PlayWindow* PlayWindow::s_pInstance = nullptr;
+bool PlayWindow::s_bHeadless = false;
 
 // External functions which must be implemented by the user 
 extern void MainGameEntry( int argc, char* argv[] ); 
@@ -2036,8 +2943,25 @@ int WINAPI WinMain( _In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 	PLAY_ASSERT( Gdiplus::Ok == gdiStatus );
 	g_pGDIToken = token;
 
+	// Run with -headless <frames> to measure the speed of the game logic on its own
+	// > -record <file> saves the input from the session and -replay <file> plays it back exactly
+	int headlessFrames = 0;
+	for( int i = 1; i < __argc - 1; i++ )
+	{
+		if( strcmp( __argv[i], "-headless" ) == 0 )
+			headlessFrames = atoi( __argv[i + 1] );
+		if( strcmp( __argv[i], "-record" ) == 0 )
+			PlayInput::Instance().StartRecording( __argv[i + 1] );
+		if( strcmp( __argv[i], "-replay" ) == 0 )
+			PlayInput::Instance().StartReplay( __argv[i + 1] );
+	}
+	PlayWindow::SetHeadless( headlessFrames > 0 );
+
 	MainGameEntry( __argc, __argv );
 
+	if( PlayWindow::IsHeadless() )
+		return PlayWindow::Instance().RunHeadless( headlessFrames );
+
 	return PlayWindow::Instance().HandleWindows( hInstance, hPrevInstance, lpCmdLine, nShowCmd, L"PlayBuffer" );
 }
 
@@ -2050,12 +2974,16 @@ PlayWindow::PlayWindow( PixelData* pDisplayBuffer, int nScale )
 	PLAY_ASSERT( pDisplayBuffer );
 	PLAY_ASSERT( nScale > 0 );
 	m_pPlayBuffer = pDisplayBuffer;
+	m_width = pDisplayBuffer->width;
+	m_height = pDisplayBuffer->height;
 	m_scale = nScale;
 }
 
 PlayWindow::~PlayWindow( void )
 {
-	s_pInstance = nullptr;
+	StopPresentThread();
+	StopFrameExport();
+	delete m_pUpscalePool;
 }
 
 //********************************************************************************************************************************
@@ -2064,24 +2992,24 @@ PlayWindow::~PlayWindow( void )
 
 PlayWindow& PlayWindow::Instance()
 {
-	if( !s_pInstance )
+	if( !Play::GetCurrentContext().pWindow )
 		PLAY_ASSERT_MSG( false, "Trying to use PlayBuffer without initialising it!" );
 
-	return *s_pInstance;
+	return *Play::GetCurrentContext().pWindow;
 }
 
 PlayWindow& PlayWindow::Instance( PixelData* pDisplayBuffer, int nScale )
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayWindow( pDisplayBuffer, nScale );
-	return *s_pInstance;
+	PLAY_ASSERT_MSG( !Play::GetCurrentContext().pWindow, "Trying to create multiple instances of singleton class!" );
+	Play::GetCurrentContext().pWindow = new PlayWindow( pDisplayBuffer, nScale );
+	return *Play::GetCurrentContext().pWindow;
 }
 
 void PlayWindow::Destroy()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	PLAY_ASSERT_MSG( Play::GetCurrentContext().pWindow, "Trying to use destroy PlayBuffer which hasn't been instanced!" );
+	delete Play::GetCurrentContext().pWindow;
+	Play::GetCurrentContext().pWindow = nullptr;
 }
 
 //********************************************************************************************************************************
@@ -2111,8 +3039,8 @@ int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPS
 
 	RegisterClassExW( &wcex );
 
-	int	w = m_pPlayBuffer->width * m_scale;
-	int h = m_pPlayBuffer->height * m_scale;
+	int	w = m_width * m_scale;
+	int h = m_height * m_scale;
 
 	UINT dwStyle = WS_OVERLAPPED | WS_CAPTION | WS_SYSMENU;
 	RECT rect = { 0, 0, w, h }; 
@@ -2136,19 +3064,40 @@ int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPS
 
 	MSG msg{};
 	bool quit = false;
+	int frame = 0;
 
 	// Set up counters for timing the frame
 	QueryPerformanceCounter( &lastDrawTime );
 	QueryPerformanceFrequency( &frequency );
+	long long nextFrameTime = lastDrawTime.QuadPart;
+
+	// Lets Sleep wake up within a millisecond rather than the default 15ms or so
+	timeBeginPeriod( 1 );
 
 	// Standard windows message loop
 	while( !quit )
 	{
-		// Hangle windows messages
-		if( PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ) )
+		// When nothing is changing, sleep until there is some input (or for IDLE_WAKE_INTERVAL at most) rather than running every frame
+		// > Replays don't come from window messages, so they never wait
+		// > MWMO_INPUTAVAILABLE wakes up for input which is already queued, not just input which arrives during the wait
+		if( m_bIdle && !PlayInput::Instance().IsReplaying() )
+		{
+			MsgWaitForMultipleObjectsEx( 0, nullptr, IDLE_WAKE_INTERVAL, QS_ALLINPUT, MWMO_INPUTAVAILABLE );
+
+			// Carry on as if the last frame had only just finished, so the game doesn't try to catch up on the time spent waiting
+			QueryPerformanceCounter( &now );
+			lastDrawTime.QuadPart = now.QuadPart - ( m_targetFrameRate > 0 ? frequency.QuadPart / m_targetFrameRate : 0 );
+			nextFrameTime = lastDrawTime.QuadPart;
+		}
+
+		// Handle all the windows messages waiting, so none are left in the queue for the next idle wait to miss
+		while( PeekMessage( &msg, nullptr, 0, 0, PM_REMOVE ) )
 		{
 			if( msg.message == WM_QUIT )
+			{
+				quit = true;
 				break;
+			}
 
 			if( !TranslateAccelerator( msg.hwnd, hAccelTable, &msg ) )
 			{
@@ -2157,24 +3106,53 @@ int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPS
 			}
 		}
 
-		do
+		if( quit )
+			break;
+
+		if( m_targetFrameRate > 0 )
+		{
+			// Frames are due at regular intervals rather than a set time after the last one finished, so lateness doesn't build up
+			nextFrameTime += frequency.QuadPart / m_targetFrameRate;
+			QueryPerformanceCounter( &now );
+			if( now.QuadPart > nextFrameTime + ( frequency.QuadPart / m_targetFrameRate ) )
+				nextFrameTime = now.QuadPart; // More than a frame behind, so start again from now
+
+			m_framePacer( nextFrameTime, frequency.QuadPart );
+
+			QueryPerformanceCounter( &now );
+			double errorMs = ( now.QuadPart - nextFrameTime ) * 1000.0 / frequency.QuadPart;
+			m_pacingStats.frames++;
+			m_pacingStats.lastErrorMs = errorMs;
+			m_pacingStats.meanErrorMs += ( errorMs - m_pacingStats.meanErrorMs ) / m_pacingStats.frames;
+			m_pacingStats.maxErrorMs = std::max( m_pacingStats.maxErrorMs, errorMs );
+		}
+		else
 		{
 			QueryPerformanceCounter( &now );
-			elapsedTime = ( now.QuadPart - lastDrawTime.QuadPart ) * 1000.0 / frequency.QuadPart;
+		}
 
-		} while( elapsedTime < 1000.0f / FRAMES_PER_SECOND );
+		elapsedTime = ( now.QuadPart - lastDrawTime.QuadPart ) * 1000.0 / frequency.QuadPart;
 
 		// Call the main game update function (only while we have the input focus in release mode)
 #ifndef _DEBUG
 		if( GetFocus() == m_hWindow )
 #endif
-			quit = MainGameUpdate( static_cast<float>( elapsedTime ) / 1000.0f );
+		{
+			if( m_inputScript && !PlayInput::Instance().IsReplaying() )
+				m_inputScript( frame++ );
+
+			quit = MainGameUpdate( PlayInput::Instance().UpdateInput( static_cast<float>( elapsedTime ) / 1000.0f ) );
+
+			LARGE_INTEGER updated;
+			QueryPerformanceCounter( &updated );
+			m_lastUpdateMs = ( updated.QuadPart - now.QuadPart ) * 1000.0 / frequency.QuadPart;
+		}
 		
 		lastDrawTime = now;
-
-		DwmFlush(); // Waits for DWM compositor to finish
 	}
 
+	timeEndPeriod( 1 );
+
 	// Call the main game cleanup function
 	MainGameExit();
 
@@ -2184,6 +3162,90 @@ int PlayWindow::HandleWindows( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPS
 	return static_cast<int>( msg.wParam );
 }
 
+int PlayWindow::RunHeadless( int frames )
+{
+	LARGE_INTEGER frequency, start, end;
+	QueryPerformanceFrequency( &frequency );
+
+	// The keyboard is ignored so every run of the same build behaves the same way
+	PlayInput& input = PlayInput::Instance();
+	bool bReplay = input.IsReplaying();
+	input.SetScriptedInput( true );
+
+	// Every frame is given the same elapsed time, as if the game was running at its normal speed (unless a recording is being replayed)
+	int frame = 0;
+	QueryPerformanceCounter( &start );
+	while( frame < frames )
+	{
+		if( bReplay && !input.IsReplaying() )
+			break;
+
+		if( m_headlessInput && !bReplay )
+			m_headlessInput( frame );
+
+		if( m_inputScript && !bReplay )
+			m_inputScript( frame );
+
+		frame++;
+		if( MainGameUpdate( input.UpdateInput( 1.0f / FRAMES_PER_SECOND ) ) )
+			break;
+
+		input.SetScriptedInput( true );
+	}
+	QueryPerformanceCounter( &end );
+
+	double seconds = static_cast<double>( end.QuadPart - start.QuadPart ) / frequency.QuadPart;
+	char report[256];
+	sprintf_s( report, "Headless: simulated %d frames in %.3f seconds (%.0f frames per second)\n", frame, seconds, seconds > 0.0 ? frame / seconds : 0.0 );
+
+	// Report to the console we were started from (if there is one) as well as the debugger
+	OutputDebugStringA( report );
+	if( AttachConsole( ATTACH_PARENT_PROCESS ) )
+	{
+		FILE* pConsole = nullptr;
+		freopen_s( &pConsole, "CONOUT$", "w", stdout );
+		printf( "%s", report );
+		fflush( stdout );
+	}
+
+	MainGameExit();
+
+	PLAY_ASSERT( g_pGDIToken );
+	Gdiplus::GdiplusShutdown( g_pGDIToken );
+
+	return PLAY_OK;
+}
+
+//********************************************************************************************************************************
+// Frame pacing functions
+//********************************************************************************************************************************
+
+void PlayWindow::SetTargetFrameRate( int framesPerSecond )
+{
+	PLAY_ASSERT_MSG( framesPerSecond >= 0, "Invalid frame rate" );
+	m_targetFrameRate = framesPerSecond;
+	ResetFramePacingStats();
+}
+
+void PlayWindow::SleepThenSpin( long long dueTime, long long frequency )
+{
+	// Sleep can overshoot by up to a millisecond (even with timeBeginPeriod), so stop sleeping this far ahead
+	constexpr double SPIN_TIME_MS = 2.0;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+
+	double remainingMs = ( dueTime - now.QuadPart ) * 1000.0 / frequency;
+	if( remainingMs > SPIN_TIME_MS )
+		Sleep( static_cast<DWORD>( remainingMs - SPIN_TIME_MS ) );
+
+	do
+	{
+		YieldProcessor();
+		QueryPerformanceCounter( &now );
+	} while( now.QuadPart < dueTime );
+}
+
 LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam )
 {
 	switch( message )
@@ -2191,6 +3253,22 @@ LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LP
 		case WM_PAINT:
 			PAINTSTRUCT ps;
 			BeginPaint( hWnd, &ps );
+			// An idle game won't present again until something changes, so show the last frame again
+			if( Play::GetCurrentContext().pWindow->m_bIdle )
+			{
+				PlayWindow* pWindow = Play::GetCurrentContext().pWindow;
+				if( pWindow->IsPresentThreadRunning() )
+				{
+					// The display buffer may not hold the last frame, so the present thread shows it again instead
+					std::lock_guard< std::mutex > lock( pWindow->m_presentMutex );
+					pWindow->m_bRepaint = true;
+					pWindow->m_presentCondition.notify_one();
+				}
+				else
+				{
+					pWindow->Present();
+				}
+			}
 			EndPaint( hWnd, &ps );
 			break;
 
@@ -2198,31 +3276,31 @@ LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LP
 			PostQuitMessage( 0 );
 			break;
 		case WM_LBUTTONDOWN:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->left = true;
+			if( Play::GetCurrentContext().pWindow->m_pMouseData )
+				Play::GetCurrentContext().pWindow->m_pMouseData->left = true;
 			break;
 		case WM_LBUTTONUP:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->left = false;
+			if( Play::GetCurrentContext().pWindow->m_pMouseData )
+				Play::GetCurrentContext().pWindow->m_pMouseData->left = false;
 			break;
 		case WM_RBUTTONDOWN:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->right = true;
+			if( Play::GetCurrentContext().pWindow->m_pMouseData )
+				Play::GetCurrentContext().pWindow->m_pMouseData->right = true;
 			break;
 		case WM_RBUTTONUP:
-			if( s_pInstance->m_pMouseData )
-				s_pInstance->m_pMouseData->right = false;
+			if( Play::GetCurrentContext().pWindow->m_pMouseData )
+				Play::GetCurrentContext().pWindow->m_pMouseData->right = false;
 			break;
 		case WM_MOUSEMOVE:
-			if( s_pInstance->m_pMouseData )
+			if( Play::GetCurrentContext().pWindow->m_pMouseData )
 			{
-				s_pInstance->m_pMouseData->pos.x = static_cast<float>( GET_X_LPARAM( lParam ) / s_pInstance->m_scale );
-				s_pInstance->m_pMouseData->pos.y = static_cast<float>( GET_Y_LPARAM( lParam ) / s_pInstance->m_scale );
+				Play::GetCurrentContext().pWindow->m_pMouseData->pos.x = static_cast<float>( GET_X_LPARAM( lParam ) / Play::GetCurrentContext().pWindow->m_scale );
+				Play::GetCurrentContext().pWindow->m_pMouseData->pos.y = static_cast<float>( GET_Y_LPARAM( lParam ) / Play::GetCurrentContext().pWindow->m_scale );
 			}
 			break;
 		case WM_MOUSELEAVE:
-			s_pInstance->m_pMouseData->pos.x = -1;
-			s_pInstance->m_pMouseData->pos.y = -1;
+			Play::GetCurrentContext().pWindow->m_pMouseData->pos.x = -1;
+			Play::GetCurrentContext().pWindow->m_pMouseData->pos.y = -1;
 			break;
 		default:
 			return DefWindowProc( hWnd, message, wParam, lParam );
@@ -2231,6 +3309,11 @@ LRESULT CALLBACK PlayWindow::WndProc( HWND hWnd, UINT message, WPARAM wParam, LP
 }
 
 double PlayWindow::Present( void )
+{
+	return PresentPixels( m_pPlayBuffer->pPixels );
+}
+
+double PlayWindow::PresentPixels( const Pixel* pPixels )
 {
 	LARGE_INTEGER frequency;
 	LARGE_INTEGER before;
@@ -2238,11 +3321,27 @@ double PlayWindow::Present( void )
 	QueryPerformanceCounter( &before );
 	QueryPerformanceFrequency( &frequency );
 
+	// The frame is scaled up here rather than by GDI, so the cost is the same (and can be measured) whatever the window is drawn with
+	// > The drawing buffer is a whole number of times smaller than the display when the resolution divisor is more than 1
+	int upscale = m_scale * ( m_width / m_pPlayBuffer->width );
+	int width = m_width * m_scale;
+	int height = m_height * m_scale;
+	if( upscale > 1 )
+	{
+		m_scaledPixels.resize( static_cast<size_t>( width ) * height );
+		UpscalePixels( pPixels, m_pPlayBuffer->width, m_pPlayBuffer->height, upscale, m_scaledPixels.data(), m_pUpscalePool );
+		pPixels = m_scaledPixels.data();
+
+		LARGE_INTEGER upscaled;
+		QueryPerformanceCounter( &upscaled );
+		m_lastUpscaleMs = ( upscaled.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+	}
+
 	// Set up a BitmapInfo structure to represent the pixel format of the display buffer
 	BITMAPINFOHEADER bitmap_info_header
 	{
 			sizeof( BITMAPINFOHEADER ),								// size of its own data,
-			m_pPlayBuffer->width, m_pPlayBuffer->height,		// width and height
+			width, height,		// width and height
 			1, 32, BI_RGB,				// planes must always be set to 1 (docs), 32-bit pixel data, uncompressed 
 			0, 0, 0, 0, 0				// rest can be set to 0 as this is uncompressed and has no palette
 	};
@@ -2251,41 +3350,323 @@ double PlayWindow::Present( void )
 
 	HDC hDC = GetDC( m_hWindow );
 
-	// Copy the display buffer to the window: GDI only implements up scaling using simple pixel duplication, but that's what we want
+	// Copy the (already scaled) frame to the window at the same size
 	// Note that GDI+ DrawImage would do the same thing, but it's much slower! 
-	StretchDIBits( hDC, 0, 0, m_pPlayBuffer->width * m_scale, m_pPlayBuffer->height * m_scale, 0, m_pPlayBuffer->height + 1, m_pPlayBuffer->width, -m_pPlayBuffer->height, m_pPlayBuffer->pPixels, &bitmap_info, DIB_RGB_COLORS, SRCCOPY ); // We flip h because Bitmaps store pixel data upside down.
+	StretchDIBits( hDC, 0, 0, width, height, 0, height + 1, width, -height, pPixels, &bitmap_info, DIB_RGB_COLORS, SRCCOPY ); // We flip h because Bitmaps store pixel data upside down.
 	
 	ReleaseDC( m_hWindow, hDC );
 
 	QueryPerformanceCounter( &after );
 
 	double elapsedTime = ( after.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+	m_lastPresentMs = elapsedTime;
 
 	return elapsedTime;
 }
 
 //********************************************************************************************************************************
-// Loading functions
+// Frame export functions
 //********************************************************************************************************************************
 
-int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+bool PlayWindow::StartFrameExport( const char* name, int slotCount )
 {
-	// Convert filename from single to wide string for GDI+ compatibility
-	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
-	wchar_t* wcstring = new wchar_t[newsize];
-	size_t convertedChars = 0;
-	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+	PLAY_ASSERT_MSG( slotCount >= 2, "The frame export needs at least two slots" );
+	StopFrameExport();
 
-	HBITMAP hBitmap = NULL;
+	// The present thread exports each frame it shows
+	std::unique_lock< std::mutex > lock = LockIdlePresent();
 
-	// Use GDI+ to load file into Bitmap structure
-	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
-	int status = bitmap->GetLastStatus();
+	size_t slotSize = FRAME_EXPORT_ALIGNMENT + sizeof( Pixel ) * m_width * m_height;
+	uint64_t totalSize = FRAME_EXPORT_ALIGNMENT + static_cast<uint64_t>( slotSize ) * slotCount;
 
-	if( status != Gdiplus::Ok )
-		return -status;
+	m_hFrameExport = CreateFileMappingA( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>( totalSize >> 32 ), static_cast<DWORD>( totalSize ), name );
+	if( !m_hFrameExport )
+		return false;
 
-	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
+	m_pFrameExport = static_cast<uint8_t*>( MapViewOfFile( m_hFrameExport, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<size_t>( totalSize ) ) );
+	if( !m_pFrameExport )
+	{
+		CloseHandle( m_hFrameExport );
+		m_hFrameExport = nullptr;
+		return false;
+	}
+
+	// The memory may already exist if another program has it open, so every slot is emptied before the header says what's in it
+	for( int slot = 0; slot < slotCount; slot++ )
+		reinterpret_cast<FrameExportSlot*>( m_pFrameExport + FRAME_EXPORT_ALIGNMENT + slotSize * slot )->sequence.store( 0 );
+
+	FrameExportHeader* pHeader = reinterpret_cast<FrameExportHeader*>( m_pFrameExport );
+	memcpy( pHeader->id, "PLFX", 4 );
+	pHeader->version = 1;
+	pHeader->width = m_width;
+	pHeader->height = m_height;
+	pHeader->slotCount = slotCount;
+	pHeader->slotSize = static_cast<uint32_t>( slotSize );
+	pHeader->latestFrame.store( 0 );
+	m_exportedFrames = 0;
+	return true;
+}
+
+void PlayWindow::StopFrameExport()
+{
+	// The present thread may be copying a frame into the memory
+	std::unique_lock< std::mutex > lock = LockIdlePresent();
+
+	if( m_pFrameExport )
+		UnmapViewOfFile( m_pFrameExport );
+	if( m_hFrameExport )
+		CloseHandle( m_hFrameExport );
+
+	m_pFrameExport = nullptr;
+	m_hFrameExport = nullptr;
+}
+
+void PlayWindow::ExportFrame( const Pixel* pPixels )
+{
+	if( !m_pFrameExport )
+		return;
+
+	FrameExportHeader* pHeader = reinterpret_cast<FrameExportHeader*>( m_pFrameExport );
+	uint64_t frame = ++m_exportedFrames;
+	uint8_t* pSlot = m_pFrameExport + FRAME_EXPORT_ALIGNMENT + static_cast<size_t>( pHeader->slotSize ) * ( ( frame - 1 ) % pHeader->slotCount );
+	FrameExportSlot* pSlotHeader = reinterpret_cast<FrameExportSlot*>( pSlot );
+
+	// A single copy with no locks: readers use the sequence numbers to tell whether they read a whole frame
+	pSlotHeader->sequence.store( 0, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	memcpy( pSlot + FRAME_EXPORT_ALIGNMENT, pPixels, sizeof( Pixel ) * m_width * m_height );
+	pSlotHeader->sequence.store( frame, std::memory_order_release );
+	pHeader->latestFrame.store( frame, std::memory_order_release );
+}
+
+//********************************************************************************************************************************
+// Upscaling functions
+//********************************************************************************************************************************
+
+void PlayWindow::UpscalePixels( const Pixel* pSource, int width, int height, int scale, Pixel* pDest, PlayThreadPool* pPool )
+{
+	PLAY_ASSERT_MSG( scale > 0, "Invalid upscale" );
+	size_t destWidth = static_cast<size_t>( width ) * scale;
+
+	auto upscaleRows = [=]( size_t begin, size_t end )
+	{
+		for( size_t y = begin; y < end; y++ )
+		{
+			// Widen the row once, then copy it for the rest of the rows it covers
+			Pixel* pRow = pDest + y * scale * destWidth;
+			UpscaleRow( pSource + y * width, width, scale, pRow );
+			for( int copy = 1; copy < scale; copy++ )
+				memcpy( pRow + copy * destWidth, pRow, destWidth * sizeof( Pixel ) );
+		}
+	};
+
+	if( pPool )
+		pPool->ParallelFor( height, 16, upscaleRows );
+	else
+		upscaleRows( 0, height );
+}
+
+void PlayWindow::UpscaleRow( const Pixel* pSource, int width, int scale, Pixel* pDest )
+{
+	int x = 0;
+
+	switch( scale )
+	{
+		case 2:
+			for( ; x + 4 <= width; x += 4, pDest += 8 )
+			{
+				__m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + x ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest ), _mm_unpacklo_epi32( p, p ) ); // 0 0 1 1
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 4 ), _mm_unpackhi_epi32( p, p ) ); // 2 2 3 3
+			}
+			break;
+		case 3:
+			for( ; x + 4 <= width; x += 4, pDest += 12 )
+			{
+				__m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + x ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 1, 0, 0, 0 ) ) ); // 0 0 0 1
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 4 ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 2, 2, 1, 1 ) ) ); // 1 1 2 2
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 8 ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 3, 3, 3, 2 ) ) ); // 2 3 3 3
+			}
+			break;
+		case 4:
+			for( ; x + 4 <= width; x += 4, pDest += 16 )
+			{
+				__m128i p = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pSource + x ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 4 ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 1, 1, 1, 1 ) ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 8 ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 2, 2, 2, 2 ) ) );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>( pDest + 12 ), _mm_shuffle_epi32( p, _MM_SHUFFLE( 3, 3, 3, 3 ) ) );
+			}
+			break;
+	}
+
+	// The pixels left over at the end of the row (and any other scale) are done one at a time
+	for( ; x < width; x++ )
+	{
+		for( int copy = 0; copy < scale; copy++ )
+			*pDest++ = pSource[x];
+	}
+}
+
+void PlayWindow::SetUpscaleThreads( int workerCount )
+{
+	// Nothing can be presenting while the pool changes (and a repaint can't start the present thread again until it has)
+	std::unique_lock< std::mutex > lock = LockIdlePresent();
+	delete m_pUpscalePool;
+	m_pUpscalePool = workerCount > 0 ? new PlayThreadPool( workerCount ) : nullptr;
+}
+
+//********************************************************************************************************************************
+// Present thread functions
+//********************************************************************************************************************************
+
+void PlayWindow::StartPresentThread( std::function<void( Pixel*& )> onShown )
+{
+	if( IsPresentThreadRunning() || s_bHeadless )
+		return;
+
+	// The display buffer is the third buffer (they are all full size, whatever resolution the game is drawing at)
+	for( int b = 0; b < 2; b++ )
+		m_vFreeFrames.push_back( new Pixel[static_cast<size_t>( m_width ) * m_height] );
+
+	m_onFrameShown = onShown;
+	m_bStopPresenting = false;
+	m_replacedFrames = 0;
+	m_presentThread = std::thread( &PlayWindow::PresentThreadLoop, this );
+}
+
+void PlayWindow::StopPresentThread()
+{
+	if( !IsPresentThreadRunning() )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( m_presentMutex );
+		m_bStopPresenting = true;
+	}
+	m_presentCondition.notify_all();
+	m_presentThread.join();
+
+	// The display buffer belongs to PlayGraphics, and whichever buffers are left over are the back buffers
+	for( Pixel* pFrame : m_vFreeFrames )
+		delete[] pFrame;
+	delete[] m_pShownFrame;
+	m_vFreeFrames.clear();
+	m_pShownFrame = nullptr;
+}
+
+void PlayWindow::QueuePresent()
+{
+	Pixel*& pDisplayPixels = m_pPlayBuffer->pPixels;
+	{
+		std::lock_guard< std::mutex > lock( m_presentMutex );
+
+		if( m_pPendingFrame )
+		{
+			// The present thread is still busy with an older frame, so the one waiting is out of date
+			std::swap( pDisplayPixels, m_pPendingFrame );
+			m_replacedFrames++;
+		}
+		else
+		{
+			// With three buffers there is always a free one when nothing is waiting
+			PLAY_ASSERT_MSG( !m_vFreeFrames.empty(), "The present thread has run out of back buffers" );
+			m_pPendingFrame = pDisplayPixels;
+			pDisplayPixels = m_vFreeFrames.back();
+			m_vFreeFrames.pop_back();
+		}
+	}
+	m_presentCondition.notify_all();
+}
+
+void PlayWindow::WaitForPresent()
+{
+	LockIdlePresent();
+}
+
+std::unique_lock< std::mutex > PlayWindow::LockIdlePresent()
+{
+	std::unique_lock< std::mutex > lock( m_presentMutex );
+	m_presentCondition.wait( lock, [this]() { return !m_pPendingFrame && !m_bPresenting; } );
+	return lock;
+}
+
+int PlayWindow::GetReplacedFrameCount()
+{
+	std::lock_guard< std::mutex > lock( m_presentMutex );
+	return m_replacedFrames;
+}
+
+void PlayWindow::PresentThreadLoop()
+{
+	std::unique_lock< std::mutex > lock( m_presentMutex );
+
+	for( ;; )
+	{
+		m_presentCondition.wait( lock, [this]() { return m_bStopPresenting || m_pPendingFrame || m_bRepaint; } );
+
+		// Any frame still waiting is shown before stopping
+		bool bNewFrame = m_pPendingFrame != nullptr;
+		if( bNewFrame )
+		{
+			// The last frame shown is free again once a newer one starts being shown
+			if( m_pShownFrame )
+				m_vFreeFrames.push_back( m_pShownFrame );
+			m_pShownFrame = m_pPendingFrame;
+			m_pPendingFrame = nullptr;
+		}
+		else if( !m_bRepaint || !m_pShownFrame )
+		{
+			if( m_bStopPresenting )
+				return;
+			m_bRepaint = false;
+			continue;
+		}
+
+		// The game never draws into the shown frame, so it can be read without the lock
+		Pixel* pFrame = m_pShownFrame;
+		m_bRepaint = false;
+		m_bPresenting = true;
+		lock.unlock();
+
+		PresentPixels( pFrame );
+		if( bNewFrame )
+		{
+			ExportFrame( pFrame );
+			if( m_onFrameShown )
+				m_onFrameShown( pFrame );
+		}
+
+		lock.lock();
+		m_pShownFrame = pFrame;
+		m_bPresenting = false;
+		m_presentCondition.notify_all();
+	}
+}
+
+//********************************************************************************************************************************
+// Loading functions
+//********************************************************************************************************************************
+
+int PlayWindow::ReadPNGImage( std::string& fileAndPath, int& width, int& height )
+{
+	// Convert filename from single to wide string for GDI+ compatibility
+	size_t newsize = strlen( fileAndPath.c_str() ) + 1;
+	wchar_t* wcstring = new wchar_t[newsize];
+	size_t convertedChars = 0;
+	mbstowcs_s( &convertedChars, wcstring, newsize, fileAndPath.c_str(), _TRUNCATE );
+
+	HBITMAP hBitmap = NULL;
+
+	// Use GDI+ to load file into Bitmap structure
+	Gdiplus::Bitmap* bitmap = Gdiplus::Bitmap::FromFile( wcstring, false );
+	int status = bitmap->GetLastStatus();
+
+	if( status != Gdiplus::Ok )
+		return -status;
+
+	bitmap->GetHBITMAP( Gdiplus::Color( 255, 255, 255 ), &hBitmap );
 
 	width = bitmap->GetWidth();
 	height = bitmap->GetHeight();
@@ -2776,7 +4157,6 @@ void PlayBlitter::BlitBackground( PixelData& backgroundImage ) const
 //********************************************************************************************************************************
 
 
-PlayGraphics* PlayGraphics::s_pInstance = nullptr;
 
 //********************************************************************************************************************************
 // Constructor / Destructor (Private)
@@ -2785,6 +4165,9 @@ PlayGraphics* PlayGraphics::s_pInstance = nullptr;
 PlayGraphics::PlayGraphics( int bufferWidth, int bufferHeight, const char* path )
 {
 	// A working buffer for our display. Each pixel is stored as an unsigned 32-bit integer: alpha<<24 | red<<16 | green<<8 | blue
+	// > It is always big enough for the whole display, even when drawing at a lower resolution
+	m_displayWidth = bufferWidth;
+	m_displayHeight = bufferHeight;
 	m_playBuffer.width = bufferWidth;
 	m_playBuffer.height = bufferHeight;
 	m_playBuffer.pPixels = new Pixel[static_cast<size_t>( bufferWidth ) * bufferHeight];
@@ -2855,11 +4238,20 @@ PlayGraphics::~PlayGraphics()
 
 		if( s.preMultAlpha.pPixels )
 			delete[] s.preMultAlpha.pPixels;
+
+		for( std::pair< const int, PixelData >& copy : s.scaledCopies )
+			delete[] copy.second.pPixels;
 	}
 
 	for( PixelData& pBgBuffer : vBackgroundData )
 		delete[] pBgBuffer.pPixels;
 
+	for( std::map< int, PixelData >& copies : vScaledBackgroundCopies )
+	{
+		for( std::pair< const int, PixelData >& copy : copies )
+			delete[] copy.second.pPixels;
+	}
+
 	if( m_pDebugFontBuffer )
 		delete[] m_pDebugFontBuffer;
 
@@ -2872,22 +4264,22 @@ PlayGraphics::~PlayGraphics()
 
 PlayGraphics& PlayGraphics::Instance()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayGraphics without initialising it!" );
-	return *s_pInstance;
+	PLAY_ASSERT_MSG( Play::GetCurrentContext().pGraphics, "Trying to use PlayGraphics without initialising it!" );
+	return *Play::GetCurrentContext().pGraphics;
 }
 
 PlayGraphics& PlayGraphics::Instance( int bufferWidth, int bufferHeight, const char* path )
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayGraphics( bufferWidth, bufferHeight, path );
-	return *s_pInstance;
+	PLAY_ASSERT_MSG( !Play::GetCurrentContext().pGraphics, "Trying to create multiple instances of singleton class!" );
+	Play::GetCurrentContext().pGraphics = new PlayGraphics( bufferWidth, bufferHeight, path );
+	return *Play::GetCurrentContext().pGraphics;
 }
 
 void PlayGraphics::Destroy()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	PLAY_ASSERT_MSG( Play::GetCurrentContext().pGraphics, "Trying to use destroy PlayGraphics when it hasn't been instanced!" );
+	delete Play::GetCurrentContext().pGraphics;
+	Play::GetCurrentContext().pGraphics = nullptr;
 }
 
 //********************************************************************************************************************************
@@ -2982,6 +4374,7 @@ int PlayGraphics::AddSprite( const std::string& name, PixelData& pixelData, int
 	memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
 	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
 	s.canvasBuffer.preMultiplied = true;
+	ScaleSprite( s );
 
 	// Add the sprite to our vector
 	vSpriteData.push_back( s );
@@ -3017,6 +4410,8 @@ int PlayGraphics::UpdateSprite( const std::string& name, PixelData& pixelData, i
 			memset( s.preMultAlpha.pPixels, 0, sizeof( uint32_t ) * s.canvasBuffer.width * s.canvasBuffer.height );
 			PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, 0x00FFFFFF );
 			s.canvasBuffer.preMultiplied = true;
+			s.colour = 0x00FFFFFF;
+			ScaleSprite( s );
 
 			return s.id;
 		}
@@ -3032,7 +4427,7 @@ int PlayGraphics::LoadBackground( const char* fileAndPath )
 	PixelData backgroundImage;
 	Pixel* pSrc, * pDest;
 
-	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_playBuffer.width ) * m_playBuffer.height];
+	Pixel* correctSizeBuffer = new Pixel[static_cast<size_t>( m_displayWidth ) * m_displayHeight];
 	PLAY_ASSERT( correctSizeBuffer );
 
 	std::string pngFile( fileAndPath );
@@ -3043,21 +4438,26 @@ int PlayGraphics::LoadBackground( const char* fileAndPath )
 	pDest = correctSizeBuffer;
 
 	//Copy the image to our background buffer clipping where necessary
-	for( int h = 0; h < std::min( backgroundImage.height, m_playBuffer.height ); h++ )
+	for( int h = 0; h < std::min( backgroundImage.height, m_displayHeight ); h++ )
 	{
-		for( int w = 0; w < std::min( backgroundImage.width, m_playBuffer.width ); w++ )
+		for( int w = 0; w < std::min( backgroundImage.width, m_displayWidth ); w++ )
 			*pDest++ = *pSrc++;
 
 		// Skip pixels if we're clipping
-		pDest += std::max( m_playBuffer.width - backgroundImage.width, 0 );
-		pSrc += std::max( backgroundImage.width - m_playBuffer.width, 0 );
+		pDest += std::max( m_displayWidth - backgroundImage.width, 0 );
+		pSrc += std::max( backgroundImage.width - m_displayWidth, 0 );
 	}
 
 	// Free up the loading buffer
 	delete backgroundImage.pPixels;
 	backgroundImage.pPixels = correctSizeBuffer;
+	backgroundImage.width = m_displayWidth;
+	backgroundImage.height = m_displayHeight;
 
 	vBackgroundData.push_back( backgroundImage );
+	vScaledBackgroundCopies.emplace_back();
+	vScaledBackgroundData.emplace_back();
+	UpdateScaledBackground( vBackgroundData.size() - 1 );
 
 	return static_cast<int>( vBackgroundData.size() ) - 1;
 }
@@ -3160,6 +4560,16 @@ void PlayGraphics::SetSpriteOrigins( const char* rootName, Vector2f newOrigin, b
 void PlayGraphics::DrawTransparent( int spriteId, Point2f pos, int frameIndex, float alphaMultiply ) const
 {
 	const Sprite& spr = vSpriteData[spriteId];
+
+	if( m_divisor > 1 )
+	{
+		// The shrunk sprite is drawn the same way, with its origin shrunk to match
+		frameIndex = frameIndex % spr.totalCount;
+		int scaledOffset = ( frameIndex % spr.hCount ) * spr.scaledWidth + ( spr.scaledPreMultAlpha.width * ( frameIndex / spr.hCount ) * spr.scaledHeight );
+		m_blitter.BlitPixels( spr.scaledPreMultAlpha, scaledOffset, ToBuffer( pos.x - spr.originX ), ToBuffer( pos.y - spr.originY ), spr.scaledWidth, spr.scaledHeight, alphaMultiply );
+		return;
+	}
+
 	int destx = static_cast<int>( pos.x + 0.5f ) - spr.originX;
 	int desty = static_cast<int>( pos.y + 0.5f ) - spr.originY;
 	frameIndex = frameIndex % spr.totalCount;
@@ -3190,6 +4600,18 @@ void PlayGraphics::DrawTransformed( int spriteId, const Matrix2D& trans, int fra
 	int frameOffset = pixelX + ( spr.canvasBuffer.width * pixelY );
 
 	Vector2f origin = { spr.originX, spr.originY };
+
+	if( m_divisor > 1 )
+	{
+		// Shrinking the sprite and the translation by the same amount leaves the rotation and scale as they were
+		float divisor = static_cast<float>( m_divisor );
+		Matrix2D scaledTrans = trans;
+		scaledTrans.row[2] = { trans.row[2].x / divisor, trans.row[2].y / divisor, 1.0f };
+		int scaledOffset = frameX * spr.scaledWidth + ( spr.scaledPreMultAlpha.width * frameY * spr.scaledHeight );
+		m_blitter.TransformPixels( spr.scaledPreMultAlpha, scaledOffset, spr.scaledWidth, spr.scaledHeight, origin / divisor, scaledTrans, alphaMultiply );
+		return;
+	}
+
 	m_blitter.TransformPixels( spr.preMultAlpha, frameOffset, spr.width, spr.height, origin, trans, alphaMultiply );
 }
 
@@ -3198,7 +4620,7 @@ void PlayGraphics::DrawBackground( int backgroundId )
 {
 	PLAY_ASSERT_MSG( m_playBuffer.pPixels, "Trying to draw background without initialising display!" );
 	PLAY_ASSERT_MSG( vBackgroundData.size() > static_cast<size_t>(backgroundId), "Background image out of range!" );
-	m_blitter.BlitBackground( vBackgroundData[backgroundId] );
+	m_blitter.BlitBackground( m_divisor > 1 ? vScaledBackgroundData[backgroundId] : vBackgroundData[backgroundId] );
 }
 
 void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
@@ -3210,6 +4632,8 @@ void PlayGraphics::ColourSprite( int spriteId, int r, int g, int b )
 
 	PreMultiplyAlpha( s.canvasBuffer.pPixels, s.preMultAlpha.pPixels, s.canvasBuffer.width, s.canvasBuffer.height, s.width, 1.0f, col );
 	s.canvasBuffer.preMultiplied = true;
+	s.colour = col;
+	ScaleSprite( s );
 }
 
 int PlayGraphics::DrawString( int fontId, Point2f pos, std::string text ) const
@@ -3529,16 +4953,16 @@ void PlayGraphics::PreMultiplyAlpha( Pixel* source, Pixel* dest, int width, int
 void PlayGraphics::DrawPixel( Point2f pos, Pixel srcPix )
 {
 	// Convert floating point co-ordinates to pixels
-	m_blitter.DrawPixel( static_cast<int>( pos.x + 0.5f ), static_cast<int>( pos.y + 0.5f ), srcPix );
+	m_blitter.DrawPixel( ToBuffer( pos.x ), ToBuffer( pos.y ), srcPix );
 }
 
 void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
 {
 	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( startPos.x + 0.5f );
-	int y1 = static_cast<int>( startPos.y + 0.5f );
-	int x2 = static_cast<int>( endPos.x + 0.5f );
-	int y2 = static_cast<int>( endPos.y + 0.5f );
+	int x1 = ToBuffer( startPos.x );
+	int y1 = ToBuffer( startPos.y );
+	int x2 = ToBuffer( endPos.x );
+	int y2 = ToBuffer( endPos.y );
 
 	m_blitter.DrawLine( x1, y1, x2, y2, pix );
 }
@@ -3549,10 +4973,10 @@ void PlayGraphics::DrawLine( Point2f startPos, Point2f endPos, Pixel pix )
 void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bool fill )
 {
 	// Convert floating point co-ordinates to pixels
-	int x1 = static_cast<int>( topLeft.x + 0.5f );
-	int x2 = static_cast<int>( bottomRight.x + 0.5f );
-	int y1 = static_cast<int>( topLeft.y + 0.5f );
-	int y2 = static_cast<int>( bottomRight.y + 0.5f );
+	int x1 = ToBuffer( topLeft.x );
+	int x2 = ToBuffer( bottomRight.x );
+	int y1 = ToBuffer( topLeft.y );
+	int y2 = ToBuffer( bottomRight.y );
 
 	if( fill )
 	{
@@ -3571,24 +4995,25 @@ void PlayGraphics::DrawRect( Point2f topLeft, Point2f bottomRight, Pixel pix, bo
 	}
 }
 
-// Private function called by DrawCircle
+// Private function called by DrawCircle (in drawing buffer co-ordinates)
 void PlayGraphics::DrawCircleOctants( int posX, int posY, int offX, int offY, Pixel pix )
 {
-	DrawPixel( { posX + offX , posY + offY }, pix );
-	DrawPixel( { posX - offX , posY + offY }, pix );
-	DrawPixel( { posX + offX , posY - offY }, pix );
-	DrawPixel( { posX - offX , posY - offY }, pix );
-	DrawPixel( { posX - offY , posY + offX }, pix );
-	DrawPixel( { posX + offY , posY - offX }, pix );
-	DrawPixel( { posX - offY , posY - offX }, pix );
-	DrawPixel( { posX + offY , posY + offX }, pix );
+	m_blitter.DrawPixel( posX + offX , posY + offY, pix );
+	m_blitter.DrawPixel( posX - offX , posY + offY, pix );
+	m_blitter.DrawPixel( posX + offX , posY - offY, pix );
+	m_blitter.DrawPixel( posX - offX , posY - offY, pix );
+	m_blitter.DrawPixel( posX - offY , posY + offX, pix );
+	m_blitter.DrawPixel( posX + offY , posY - offX, pix );
+	m_blitter.DrawPixel( posX - offY , posY - offX, pix );
+	m_blitter.DrawPixel( posX + offY , posY + offX, pix );
 }
 
 void PlayGraphics::DrawCircle( Point2f pos, int radius, Pixel pix )
 {
 	// Convert floating point co-ordinates to pixels
-	int x = static_cast<int>( pos.x + 0.5f );
-	int y = static_cast<int>( pos.y + 0.5f );
+	int x = ToBuffer( pos.x );
+	int y = ToBuffer( pos.y );
+	radius /= m_divisor;
 
 	int dx = 0;
 	int dy = radius;
@@ -3619,10 +5044,183 @@ void PlayGraphics::DrawPixelData( PixelData* pixelData, Point2f pos, float alpha
 		PreMultiplyAlpha( pixelData->pPixels, pixelData->pPixels, pixelData->width, pixelData->height, pixelData->width );
 		pixelData->preMultiplied = true;
 	}
+
+	// Raw pixel data has no shrunk copy, so it is scaled down as it is drawn
+	if( m_divisor > 1 )
+	{
+		float scale = 1.0f / m_divisor;
+		Matrix2D trans = MatrixScale( scale, scale );
+		trans.row[2] = { pos.x * scale, pos.y * scale, 1.0f };
+		m_blitter.TransformPixels( *pixelData, 0, pixelData->width, pixelData->height, { 0.0f, 0.0f }, trans, alpha );
+		return;
+	}
+
 	m_blitter.BlitPixels( *pixelData, 0, static_cast<int>(pos.x), static_cast<int>(pos.y), pixelData->width, pixelData->height, alpha );
 }
 
 
+//********************************************************************************************************************************
+// Resolution scaling functions
+//********************************************************************************************************************************
+
+void PlayGraphics::SetResolutionDivisor( int divisor )
+{
+	PLAY_ASSERT_MSG( IsValidResolutionDivisor( divisor ), "The resolution divisor must divide the display width and height exactly" );
+	if( divisor == m_divisor )
+		return;
+
+	m_divisor = divisor;
+	m_playBuffer.width = m_displayWidth / divisor;
+	m_playBuffer.height = m_displayHeight / divisor;
+
+	// The shrunk copies are only made when the divisor changes, so drawing at a lower resolution costs nothing extra per frame
+	// > A divisor made by PrepareResolutionDivisors already has its copies, so they are only swapped in
+	for( Sprite& s : vSpriteData )
+		UpdateScaledSprite( s );
+
+	for( size_t b = 0; b < vBackgroundData.size(); b++ )
+		UpdateScaledBackground( b );
+}
+
+void PlayGraphics::PrepareResolutionDivisors( int maxDivisor )
+{
+	PLAY_ASSERT_MSG( maxDivisor > 0, "Invalid maximum resolution divisor" );
+	m_maxPreparedDivisor = maxDivisor;
+
+	for( Sprite& s : vSpriteData )
+		UpdateScaledSprite( s );
+
+	for( size_t b = 0; b < vBackgroundData.size(); b++ )
+		UpdateScaledBackground( b );
+}
+
+void PlayGraphics::ScaleSprite( Sprite& s )
+{
+	// The image has changed, so none of the old copies can be used
+	for( std::pair< const int, PixelData >& copy : s.scaledCopies )
+		delete[] copy.second.pPixels;
+	s.scaledCopies.clear();
+
+	UpdateScaledSprite( s );
+}
+
+void PlayGraphics::UpdateScaledSprite( Sprite& s )
+{
+	for( auto copy = s.scaledCopies.begin(); copy != s.scaledCopies.end(); )
+	{
+		if( IsKeptResolutionDivisor( copy->first ) )
+		{
+			copy++;
+			continue;
+		}
+		delete[] copy->second.pPixels;
+		copy = s.scaledCopies.erase( copy );
+	}
+
+	for( int divisor = 2; divisor <= std::max( m_divisor, m_maxPreparedDivisor ); divisor++ )
+	{
+		if( IsKeptResolutionDivisor( divisor ) && s.scaledCopies.find( divisor ) == s.scaledCopies.end() )
+			s.scaledCopies[divisor] = ScaleSpritePixels( s, divisor );
+	}
+
+	s.scaledWidth = ( s.width + m_divisor - 1 ) / m_divisor;
+	s.scaledHeight = ( s.height + m_divisor - 1 ) / m_divisor;
+	s.scaledPreMultAlpha = m_divisor > 1 ? s.scaledCopies[m_divisor] : PixelData();
+}
+
+void PlayGraphics::UpdateScaledBackground( size_t backgroundId )
+{
+	std::map< int, PixelData >& copies = vScaledBackgroundCopies[backgroundId];
+	for( auto copy = copies.begin(); copy != copies.end(); )
+	{
+		if( IsKeptResolutionDivisor( copy->first ) )
+		{
+			copy++;
+			continue;
+		}
+		delete[] copy->second.pPixels;
+		copy = copies.erase( copy );
+	}
+
+	for( int divisor = 2; divisor <= std::max( m_divisor, m_maxPreparedDivisor ); divisor++ )
+	{
+		if( IsKeptResolutionDivisor( divisor ) && copies.find( divisor ) == copies.end() )
+			copies[divisor] = ScaleBackground( vBackgroundData[backgroundId], divisor );
+	}
+
+	vScaledBackgroundData[backgroundId] = m_divisor > 1 ? copies[m_divisor] : PixelData();
+}
+
+PixelData PlayGraphics::ScaleSpritePixels( const Sprite& s, int divisor )
+{
+	// Shrink the original image, then pre-multiply it the same way as the full size one (so it skips transparent pixels too)
+	int scaledWidth = ( s.width + divisor - 1 ) / divisor;
+	int scaledHeight = ( s.height + divisor - 1 ) / divisor;
+
+	PixelData scaled;
+	scaled.width = scaledWidth * s.hCount;
+	scaled.height = scaledHeight * s.vCount;
+	scaled.pPixels = new Pixel[static_cast<size_t>( scaled.width ) * scaled.height];
+	DownscalePixels( s.canvasBuffer.pPixels, s.canvasBuffer.width, s.width, s.height, s.hCount, s.vCount, divisor, scaled.pPixels );
+	PreMultiplyAlpha( scaled.pPixels, scaled.pPixels, scaled.width, scaled.height, scaledWidth, 1.0f, s.colour );
+	scaled.preMultiplied = true;
+	return scaled;
+}
+
+PixelData PlayGraphics::ScaleBackground( const PixelData& background, int divisor ) const
+{
+	PixelData scaled;
+	scaled.width = m_displayWidth / divisor;
+	scaled.height = m_displayHeight / divisor;
+	scaled.pPixels = new Pixel[static_cast<size_t>( scaled.width ) * scaled.height];
+	DownscalePixels( background.pPixels, background.width, background.width, background.height, 1, 1, divisor, scaled.pPixels );
+	return scaled;
+}
+
+void PlayGraphics::DownscalePixels( const Pixel* pSource, int sourceWidth, int frameWidth, int frameHeight, int hCount, int vCount, int divisor, Pixel* pDest )
+{
+	int scaledWidth = ( frameWidth + divisor - 1 ) / divisor;
+	int scaledHeight = ( frameHeight + divisor - 1 ) / divisor;
+
+	for( int destY = 0; destY < scaledHeight * vCount; destY++ )
+	{
+		int frameTop = ( destY / scaledHeight ) * frameHeight;
+		int top = frameTop + ( destY % scaledHeight ) * divisor;
+		int bottom = std::min( top + divisor, frameTop + frameHeight );
+
+		for( int destX = 0; destX < scaledWidth * hCount; destX++ )
+		{
+			int frameLeft = ( destX / scaledWidth ) * frameWidth;
+			int left = frameLeft + ( destX % scaledWidth ) * divisor;
+			int right = std::min( left + divisor, frameLeft + frameWidth );
+
+			// The colours are weighted by alpha, so transparent pixels don't darken the edges of a sprite
+			uint32_t alpha = 0, red = 0, green = 0, blue = 0;
+			uint32_t plainRed = 0, plainGreen = 0, plainBlue = 0;
+			for( int y = top; y < bottom; y++ )
+			{
+				for( int x = left; x < right; x++ )
+				{
+					Pixel pix = pSource[y * sourceWidth + x];
+					alpha += pix.a;
+					red += pix.r * pix.a;
+					green += pix.g * pix.a;
+					blue += pix.b * pix.a;
+					plainRed += pix.r;
+					plainGreen += pix.g;
+					plainBlue += pix.b;
+				}
+			}
+
+			uint32_t count = static_cast<uint32_t>( ( bottom - top ) * ( right - left ) );
+			if( alpha > 0 )
+				*pDest++ = Pixel( alpha / count, red / alpha, green / alpha, blue / alpha );
+			else
+				*pDest++ = Pixel( 0, plainRed / count, plainGreen / count, plainBlue / count );
+		}
+	}
+}
+
 //********************************************************************************************************************************
 // Debug font functions
 //********************************************************************************************************************************
@@ -3794,11 +5392,14 @@ void PlayGraphics::TimingBarBegin( Pixel pix )
 // Instruct Visual Studio to link the multimedia library  
 #pragma comment(lib, "winmm.lib")
 
-PlayAudio* PlayAudio::s_pInstance = nullptr;
 
 //********************************************************************************************************************************
 // Constructor and destructor (private)
 //********************************************************************************************************************************
+PlayAudio* PlayAudio::s_pInstance = nullptr;
+int PlayAudio::s_instanceCount = 0;
+std::mutex PlayAudio::s_mutex;
+
 PlayAudio::PlayAudio( const char* path )
 {
 	PLAY_ASSERT_MSG( !s_pInstance, "PlayAudio is a singleton class: multiple instances not allowed!" );
@@ -3819,8 +5420,6 @@ PlayAudio::PlayAudio( const char* path )
 			mciSendStringA( command.c_str(), NULL, 0, 0 );
 		}
 	}
-
-	s_pInstance = this;
 }
 
 PlayAudio::~PlayAudio( void )
@@ -3830,8 +5429,6 @@ PlayAudio::~PlayAudio( void )
 		std::string command = "close " + s;
 		mciSendStringA( command.c_str(), NULL, 0, 0 );
 	}
-
-	s_pInstance = nullptr;
 }
 
 //********************************************************************************************************************************
@@ -3840,22 +5437,36 @@ PlayAudio::~PlayAudio( void )
 
 PlayAudio& PlayAudio::Instance()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use PlayAudio without initialising it!" );
-	return *s_pInstance;
+	PLAY_ASSERT_MSG( Play::GetCurrentContext().pAudio, "Trying to use PlayAudio without initialising it!" );
+	return *Play::GetCurrentContext().pAudio;
 }
 
 PlayAudio& PlayAudio::Instance( const char* path )
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "Trying to create multiple instances of singleton class!" );
-	s_pInstance = new PlayAudio( path );
+	PLAY_ASSERT_MSG( !Play::GetCurrentContext().pAudio, "Trying to create multiple instances of singleton class!" );
+	std::lock_guard<std::mutex> lock( s_mutex );
+
+	// Opening the same aliases again would fail, so later contexts share the sounds the first one loaded
+	if( !s_pInstance )
+		s_pInstance = new PlayAudio( path );
+
+	s_instanceCount++;
+	Play::GetCurrentContext().pAudio = s_pInstance;
 	return *s_pInstance;
 }
 
 void PlayAudio::Destroy()
 {
-	PLAY_ASSERT_MSG( s_pInstance, "Trying to use destroy PlayAudio which hasn't been instanced!" );
-	delete s_pInstance;
-	s_pInstance = nullptr;
+	PLAY_ASSERT_MSG( Play::GetCurrentContext().pAudio, "Trying to use destroy PlayAudio which hasn't been instanced!" );
+	std::lock_guard<std::mutex> lock( s_mutex );
+	Play::GetCurrentContext().pAudio = nullptr;
+
+	// Closing the aliases would stop the sounds for every other context too
+	if( --s_instanceCount == 0 )
+	{
+		delete s_pInstance;
+		s_pInstance = nullptr;
+	}
 }
 
 //********************************************************************************************************************************
@@ -3863,6 +5474,7 @@ void PlayAudio::Destroy()
 //********************************************************************************************************************************
 void PlayAudio::StartAudio( const char* name, bool bLoop )
 {
+	std::lock_guard<std::mutex> lock( s_mutex );
 	std::string filename( name );
 	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
 
@@ -3882,6 +5494,7 @@ void PlayAudio::StartAudio( const char* name, bool bLoop )
 
 void PlayAudio::StopAudio( const char* name )
 {
+	std::lock_guard<std::mutex> lock( s_mutex );
 	std::string filename( name );
 	for( char& c : filename ) c = static_cast<char>( toupper( c ) );
 
@@ -3905,20 +5518,20 @@ void PlayAudio::StopAudio( const char* name )
 //********************************************************************************************************************************
 
 
-PlayInput* PlayInput::s_pInstance = nullptr;
 
 //********************************************************************************************************************************
 // Constructor and destructor (private)
 //********************************************************************************************************************************
 PlayInput::PlayInput( void )
 {
-	PLAY_ASSERT_MSG( !s_pInstance, "PlayInput is a singleton class: multiple instances not allowed!" );
-	s_pInstance = this;
+	PLAY_ASSERT_MSG( !Play::GetCurrentContext().pInput, "PlayInput is a singleton class: multiple instances not allowed!" );
+	Play::GetCurrentContext().pInput = this;
+	m_randomSeed = static_cast<unsigned int>( time( NULL ) );
 }
 
 PlayInput::~PlayInput( void )
 {
-	s_pInstance = nullptr;
+	StopRecording();
 }
 
 //********************************************************************************************************************************
@@ -3927,16 +5540,16 @@ PlayInput::~PlayInput( void )
 
 PlayInput& PlayInput::Instance()
 {
-	if( !s_pInstance )
-		s_pInstance = new PlayInput();
+	if( !Play::GetCurrentContext().pInput )
+		Play::GetCurrentContext().pInput = new PlayInput();
 
-	return *s_pInstance;
+	return *Play::GetCurrentContext().pInput;
 }
 
 void PlayInput::Destroy()
 {
-	if( s_pInstance )
-		delete s_pInstance;
+	delete Play::GetCurrentContext().pInput;
+	Play::GetCurrentContext().pInput = nullptr;
 }
 
 //********************************************************************************************************************************
@@ -3947,17 +5560,17 @@ bool PlayInput::GetMouseDown( MouseButton button ) const
 {
 	PLAY_ASSERT_MSG( button == BUTTON_LEFT || button == BUTTON_RIGHT, "Invalid mouse button selected." );
 
+	const MouseData& mouse = UsingScriptedState() ? m_scriptedMouse : m_mouseData;
+
 	if( button == BUTTON_LEFT )
-		return m_mouseData.left;
+		return mouse.left;
 	else
-		return m_mouseData.right;
+		return mouse.right;
 };
 
 bool PlayInput::KeyPressed( int vKey, int frame )
 {
-	static std::map< int, int > keyMap;
-
-	int& previous_frame = keyMap[vKey];
+	int& previous_frame = m_keyPressedFrames[vKey];
 
 	// Returns true if key wasn't pressed the last time we checked or if this is the same frame as the last check
 	if( KeyDown( vKey ) && ( previous_frame == 0 || ( previous_frame == frame && frame != -1 ) ) )
@@ -3974,671 +5587,2754 @@ bool PlayInput::KeyPressed( int vKey, int frame )
 
 bool PlayInput::KeyDown( int vKey )
 {
+	if( UsingScriptedState() )
+		return m_scriptedKeys[vKey & 0xFF];
+
 	return GetAsyncKeyState( vKey ) & 0x8000; // Don't want multiple calls to KeyState
 }
+
+void PlayInput::SetKeyState( int vKey, bool bDown )
+{
+	m_scriptedKeys[vKey & 0xFF] = bDown;
+}
+
 //********************************************************************************************************************************
-// File:		PlayManager.cpp
-// Description:	A manager for providing simplified access to the PlayBuffer framework
-// Platform:	Independent
-// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+// Recording and replay functions
 //********************************************************************************************************************************
 
-//**************************************************************************************************
-// GameObject Class Definition
-//**************************************************************************************************
-
-// Define this to opt in to the PlayManager
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+// The recording file starts with a header, followed by one record per frame:
+// > float elapsedTime, uint8_t changed, and then only if the input has changed since the last frame:
+// > uint8_t keys[32] (one bit per key), float mouseX, float mouseY, uint8_t mouseButtons
+constexpr char RECORDING_ID[4] = { 'P', 'L', 'R', 'C' };
+constexpr uint32_t RECORDING_VERSION = 1;
 
-// Constructor for the GameObject struct - kept as simple as possible
-GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int spriteId = 0 )
-	: type( type ), pos( newPos ), radius( collisionRadius ), spriteId( spriteId )
+void PlayInput::StartRecording( const char* fileName )
 {
-	// Member variables are assigned default values in the class header
-	static int uniqueId = 0;
-	m_id = uniqueId++;
+	StopRecording();
+
+	m_recording.open( fileName, std::ios::binary | std::ios::trunc );
+	PLAY_ASSERT_MSG( m_recording.is_open(), "Unable to save the input recording" );
+	m_recordedFrames = 0;
+
+	m_recording.write( RECORDING_ID, 4 );
+	m_recording.write( reinterpret_cast<const char*>( &RECORDING_VERSION ), sizeof( uint32_t ) );
+	m_recording.write( reinterpret_cast<const char*>( &m_randomSeed ), sizeof( uint32_t ) );
+	m_recording.flush();
 }
 
-#endif
+void PlayInput::StopRecording()
+{
+	if( m_recording.is_open() )
+		m_recording.close();
+	m_bRecordedInput = false;
+}
 
-// The PlayManager is namespace rather than a class
-namespace Play
+bool PlayInput::StartReplay( const char* fileName )
 {
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+	std::ifstream file( fileName, std::ios::binary );
+	if( !file )
+		return false;
 
-	// A map is used internally to store all the GameObjects and their unique ids
-	static std::map<int, GameObject&> objectMap;
+	m_replay.assign( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
 
-	// Used instead of Null return values, PlayMangager operations performed on this GameObject should fail transparently
-	static GameObject noObject{ -1,{ 0, 0 }, 0, -1 };
+	uint32_t version = 0;
+	if( m_replay.size() < 12 || memcmp( m_replay.data(), RECORDING_ID, 4 ) != 0 || ( memcpy( &version, &m_replay[4], 4 ), version != RECORDING_VERSION ) )
+	{
+		PLAY_ASSERT_MSG( false, "Not a valid input recording" );
+		m_replay.clear();
+		return false;
+	}
+
+	memcpy( &m_randomSeed, &m_replay[8], sizeof( uint32_t ) );
+	m_replayPos = 12;
+	m_bScriptedInput = true;
+	return true;
+}
+
+float PlayInput::UpdateInput( float elapsedTime )
+{
+	uint8_t input[RECORDING_INPUT_SIZE];
+
+	if( IsReplaying() )
+	{
+		// A truncated recording ends the replay rather than reading past the end of it
+		if( m_replayPos + sizeof( float ) + 1 > m_replay.size() )
+		{
+			PLAY_ASSERT_MSG( false, "The input recording is truncated" );
+			m_replayPos = m_replay.size();
+			m_bScriptedInput = false;
+			return elapsedTime;
+		}
+
+		memcpy( &elapsedTime, &m_replay[m_replayPos], sizeof( float ) );
+		bool bChanged = m_replay[m_replayPos + sizeof( float )] != 0;
+		m_replayPos += sizeof( float ) + 1;
+
+		if( bChanged )
+		{
+			if( m_replayPos + RECORDING_INPUT_SIZE > m_replay.size() )
+			{
+				PLAY_ASSERT_MSG( false, "The input recording is truncated" );
+				m_replayPos = m_replay.size();
+				m_bScriptedInput = false;
+				return elapsedTime;
+			}
+
+			memcpy( input, &m_replay[m_replayPos], RECORDING_INPUT_SIZE );
+			m_replayPos += RECORDING_INPUT_SIZE;
+
+			for( int k = 0; k < 256; k++ )
+				m_scriptedKeys[k] = ( input[k / 8] >> ( k % 8 ) ) & 1;
+			memcpy( &m_scriptedMouse.pos.x, &input[32], sizeof( float ) );
+			memcpy( &m_scriptedMouse.pos.y, &input[32 + sizeof( float )], sizeof( float ) );
+			m_scriptedMouse.left = input[32 + sizeof( float ) * 2] & 1;
+			m_scriptedMouse.right = input[32 + sizeof( float ) * 2] & 2;
+		}
+
+		// Go back to the keyboard and mouse at the end of the recording
+		if( !IsReplaying() )
+			m_bScriptedInput = false;
+
+		return elapsedTime;
+	}
+
+	if( !m_recording.is_open() )
+		return elapsedTime;
+
+	// Take a snapshot of the keyboard and mouse so the whole frame sees exactly what was recorded
+	// > Scripted input (such as headless runs) is recorded as it was set instead
+	if( !m_bScriptedInput )
+	{
+		for( int k = 0; k < 256; k++ )
+			m_scriptedKeys[k] = GetAsyncKeyState( k ) & 0x8000;
+		m_scriptedMouse = m_mouseData;
+		m_bRecordedInput = true;
+	}
+
+	memset( input, 0, sizeof( input ) );
+	for( int k = 0; k < 256; k++ )
+		input[k / 8] |= static_cast<uint8_t>( m_scriptedKeys[k] ) << ( k % 8 );
+	memcpy( &input[32], &m_scriptedMouse.pos.x, sizeof( float ) );
+	memcpy( &input[32 + sizeof( float )], &m_scriptedMouse.pos.y, sizeof( float ) );
+	input[32 + sizeof( float ) * 2] = ( m_scriptedMouse.left ? 1 : 0 ) | ( m_scriptedMouse.right ? 2 : 0 );
+
+	// Most frames have the same input as the one before, so those only store the elapsed time
+	bool bChanged = m_recordedFrames++ == 0 || memcmp( input, m_lastRecordedInput, RECORDING_INPUT_SIZE ) != 0;
+	memcpy( m_lastRecordedInput, input, RECORDING_INPUT_SIZE );
+
+	char changed = bChanged ? 1 : 0;
+	m_recording.write( reinterpret_cast<const char*>( &elapsedTime ), sizeof( float ) );
+	m_recording.write( &changed, 1 );
+	if( bChanged )
+		m_recording.write( reinterpret_cast<const char*>( input ), RECORDING_INPUT_SIZE );
+
+	// Flushed every frame, so the recording reaches the frame a crash happens on (a record is only a few bytes)
+	m_recording.flush();
+
+	return elapsedTime;
+}
+//********************************************************************************************************************************
+// File:		PlayThreadPool.cpp
+// Description:	A simple pool of worker threads for splitting loops across multiple cores
+// Platform:	Independent
+//********************************************************************************************************************************
+
+//********************************************************************************************************************************
+// Constructor and destructor
+//********************************************************************************************************************************
+
+PlayThreadPool::PlayThreadPool( int workerCount )
+{
+	PLAY_ASSERT( workerCount >= 0 );
+	for( int n = 0; n < workerCount; n++ )
+		m_vWorkers.emplace_back( &PlayThreadPool::WorkerLoop, this );
+}
+
+PlayThreadPool::~PlayThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_bQuit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for( std::thread& t : m_vWorkers )
+		t.join();
+}
+
+//********************************************************************************************************************************
+// Parallel functions
+//********************************************************************************************************************************
+
+void PlayThreadPool::ParallelFor( size_t count, size_t minChunkSize, const std::function< void( size_t, size_t ) >& job )
+{
+	if( count == 0 )
+		return;
+
+	// Aim for a few chunks per thread so that uneven work balances out, but never less than the minimum
+	size_t threads = m_vWorkers.size() + 1;
+	size_t chunkSize = std::max( std::max( minChunkSize, static_cast<size_t>( 1 ) ), ( count + ( threads * 4 ) - 1 ) / ( threads * 4 ) );
+
+	// Not worth waking anyone up for a single chunk
+	if( m_vWorkers.empty() || chunkSize >= count )
+	{
+		job( 0, count );
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_pJob = &job;
+		m_count = count;
+		m_chunkSize = chunkSize;
+		m_nextChunk = 0;
+		m_busyWorkers = static_cast<int>( m_vWorkers.size() );
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	RunChunks();
+
+	// Wait for the workers to finish their last chunks
+	std::unique_lock< std::mutex > lock( m_mutex );
+	m_doneCondition.wait( lock, [this]() { return m_busyWorkers == 0; } );
+	m_pJob = nullptr;
+}
+
+void PlayThreadPool::RunChunks()
+{
+	for( ;; )
+	{
+		size_t begin = m_nextChunk.fetch_add( m_chunkSize );
+		if( begin >= m_count )
+			return;
+
+		( *m_pJob )( begin, std::min( begin + m_chunkSize, m_count ) );
+	}
+}
+
+void PlayThreadPool::WorkerLoop()
+{
+	unsigned int lastGeneration = 0;
+
+	for( ;; )
+	{
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			m_wakeCondition.wait( lock, [&]() { return m_bQuit || m_generation != lastGeneration; } );
+			if( m_bQuit )
+				return;
+			lastGeneration = m_generation;
+		}
+
+		RunChunks();
+
+		{
+			std::lock_guard< std::mutex > lock( m_mutex );
+			m_busyWorkers--;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+//********************************************************************************************************************************
+// File:		PlaySocket.cpp
+// Description:	A non-blocking UDP socket for passing small messages between programs on the same machine
+// Platform:	Windows
+//********************************************************************************************************************************
+
+#pragma comment(lib, "ws2_32.lib")
+
+PlaySocket::PlaySocket()
+{
+	WSADATA wsaData;
+	int result = WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+	PLAY_ASSERT_MSG( result == 0, "Failed to start Winsock" );
+}
+
+PlaySocket::~PlaySocket()
+{
+	Close();
+	WSACleanup();
+}
+
+bool PlaySocket::Open( int localPort, int remotePort )
+{
+	Close();
+
+	m_socket = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	PLAY_ASSERT_MSG( m_socket != INVALID_SOCKET, "Failed to create a socket" );
+
+	sockaddr_in localAddress{};
+	localAddress.sin_family = AF_INET;
+	localAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	localAddress.sin_port = htons( static_cast<u_short>( localPort ) );
+	if( bind( m_socket, reinterpret_cast<sockaddr*>( &localAddress ), sizeof( localAddress ) ) == SOCKET_ERROR )
+	{
+		Close();
+		return false;
+	}
+
+	// Receive shouldn't wait for messages to arrive
+	u_long nonBlocking = 1;
+	ioctlsocket( m_socket, FIONBIO, &nonBlocking );
+
+	m_remoteAddress = {};
+	m_remoteAddress.sin_family = AF_INET;
+	m_remoteAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	m_remoteAddress.sin_port = htons( static_cast<u_short>( remotePort ) );
+	return true;
+}
+
+void PlaySocket::Close()
+{
+	if( m_socket != INVALID_SOCKET )
+		closesocket( m_socket );
+	m_socket = INVALID_SOCKET;
+}
+
+void PlaySocket::Send( const void* pData, int size )
+{
+	PLAY_ASSERT_MSG( IsOpen(), "Sending on a socket which isn't open" );
+	sendto( m_socket, static_cast<const char*>( pData ), size, 0, reinterpret_cast<sockaddr*>( &m_remoteAddress ), sizeof( m_remoteAddress ) );
+}
+
+int PlaySocket::Receive( void* pData, int maxSize )
+{
+	PLAY_ASSERT_MSG( IsOpen(), "Receiving on a socket which isn't open" );
+	// Errors (including WSAEWOULDBLOCK when nothing has arrived, or WSAECONNRESET when the other end isn't there yet) just mean no message
+	int size = recv( m_socket, static_cast<char*>( pData ), maxSize, 0 );
+	return size > 0 ? size : 0;
+}
+//********************************************************************************************************************************
+// File:		PlayFrameCapture.cpp
+// Description:	Records frames to disk on worker threads without holding up the game
+// Platform:	Windows
+//********************************************************************************************************************************
+
+PlayFrameCapture::PlayFrameCapture( const char* path, Format format, int width, int height, int workerCount, int bufferCount )
+	: m_path( path ), m_format( format ), m_width( width ), m_height( height )
+{
+	PLAY_ASSERT_MSG( workerCount > 0 && bufferCount > 0, "Frame capture needs at least one worker and one buffer" );
+
+	for( int b = 0; b < bufferCount; b++ )
+		m_freeBuffers.push_back( new Pixel[static_cast<size_t>( width ) * height] );
+
+	if( format == CAPTURE_VIDEO )
+	{
+		m_videoFile.open( path, std::ios::binary );
+		PLAY_ASSERT_MSG( m_videoFile, "Couldn't create the video file" );
+		int32_t header[4] = { 0, 1, width, height };
+		memcpy( header, "PLVD", 4 );
+		m_videoFile.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+	}
+	else
+	{
+		// Find GDI+'s PNG encoder
+		UINT encoderCount = 0, encoderBytes = 0;
+		Gdiplus::GetImageEncodersSize( &encoderCount, &encoderBytes );
+		std::vector< uint8_t > encoders( encoderBytes );
+		Gdiplus::ImageCodecInfo* pEncoders = reinterpret_cast<Gdiplus::ImageCodecInfo*>( encoders.data() );
+		Gdiplus::GetImageEncoders( encoderCount, encoderBytes, pEncoders );
+
+		bool bFound = false;
+		for( UINT e = 0; e < encoderCount && !bFound; e++ )
+		{
+			if( wcscmp( pEncoders[e].MimeType, L"image/png" ) == 0 )
+			{
+				m_pngEncoder = pEncoders[e].Clsid;
+				bFound = true;
+			}
+		}
+		PLAY_ASSERT_MSG( bFound, "GDI+ doesn't have a PNG encoder" );
+	}
+
+	for( int w = 0; w < workerCount; w++ )
+		m_vWorkers.emplace_back( &PlayFrameCapture::WorkerLoop, this );
+}
+
+PlayFrameCapture::~PlayFrameCapture()
+{
+	Finish();
+
+	for( Pixel* pBuffer : m_freeBuffers )
+		delete[] pBuffer;
+}
+
+void PlayFrameCapture::Finish()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_bQuit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for( std::thread& worker : m_vWorkers )
+		worker.join();
+	m_vWorkers.clear();
+
+	if( m_pLastFrame )
+		ReleaseBuffer( m_pLastFrame );
+	m_pLastFrame = nullptr;
+	m_videoFile.close();
+}
+
+bool PlayFrameCapture::Capture( Pixel*& pPixels )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		PLAY_ASSERT_MSG( !m_bQuit, "Capturing a frame after the capture has finished" );
+		int frame = m_stats.captured++;
+
+		if( m_freeBuffers.empty() )
+		{
+			m_stats.dropped++;
+			return false;
+		}
+
+		Job job{ frame, m_nextOrder++, pPixels, nullptr };
+		m_bufferReferences[pPixels] = 1;
+
+		// Each video frame keeps the one before it until it has been compared with it
+		if( m_format == CAPTURE_VIDEO )
+		{
+			job.pPrevious = m_pLastFrame;
+			m_bufferReferences[pPixels]++;
+			m_pLastFrame = pPixels;
+		}
+
+		m_queue.push_back( job );
+		pPixels = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+	}
+
+	m_wakeCondition.notify_one();
+	return true;
+}
+
+PlayFrameCapture::Stats PlayFrameCapture::GetStats()
+{
+	std::lock_guard< std::mutex > lock( m_mutex );
+	return m_stats;
+}
+
+void PlayFrameCapture::WorkerLoop()
+{
+	for( ;; )
+	{
+		Job job;
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			m_wakeCondition.wait( lock, [this]() { return m_bQuit || !m_queue.empty(); } );
+
+			// Everything which was captured is written before the workers stop
+			if( m_queue.empty() )
+				return;
+
+			job = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		bool bWritten = ( m_format == CAPTURE_VIDEO ) ? WriteVideoFrame( job ) : WritePNG( job );
+
+		std::lock_guard< std::mutex > lock( m_mutex );
+		ReleaseBuffer( job.pPixels );
+		if( job.pPrevious )
+			ReleaseBuffer( job.pPrevious );
+		( bWritten ? m_stats.written : m_stats.failed )++;
+	}
+}
+
+bool PlayFrameCapture::WritePNG( const Job& job )
+{
+	char fileName[16];
+	sprintf_s( fileName, "_%06d.png", job.frame );
+	std::string file = m_path + fileName;
+
+	// Convert filename from single to wide string for GDI+ compatibility
+	std::vector< wchar_t > wideFile( file.size() + 1 );
+	size_t convertedChars = 0;
+	mbstowcs_s( &convertedChars, wideFile.data(), wideFile.size(), file.c_str(), _TRUNCATE );
+
+	// The display buffer's pixels are already in GDI+'s 32 bit RGB format, so the bitmap can use them directly
+	Gdiplus::Bitmap bitmap( m_width, m_height, m_width * sizeof( Pixel ), PixelFormat32bppRGB, reinterpret_cast<BYTE*>( job.pPixels ) );
+	return bitmap.Save( wideFile.data(), &m_pngEncoder, nullptr ) == Gdiplus::Ok;
+}
+
+bool PlayFrameCapture::WriteVideoFrame( const Job& job )
+{
+	// The frame's number and size go first, and the size is filled in at the end
+	std::vector< uint8_t > data( sizeof( int32_t ) * 2 );
+	memcpy( data.data(), &job.frame, sizeof( int32_t ) );
+	int count = m_width * m_height;
+	int pos = 0;
+
+	auto append = [&data]( const void* pData, size_t size )
+	{
+		data.insert( data.end(), static_cast<const uint8_t*>( pData ), static_cast<const uint8_t*>( pData ) + size );
+	};
+
+	// Most of the screen is the background, so most of each frame is skipped over as unchanged
+	while( pos < count )
+	{
+		int start = pos;
+		if( job.pPrevious )
+		{
+			while( pos < count && job.pPixels[pos].bits == job.pPrevious[pos].bits )
+				pos++;
+		}
+		uint32_t unchanged = static_cast<uint32_t>( pos - start );
+
+		start = pos;
+		if( job.pPrevious )
+		{
+			while( pos < count && job.pPixels[pos].bits != job.pPrevious[pos].bits )
+				pos++;
+		}
+		else
+		{
+			pos = count;
+		}
+		uint32_t changed = static_cast<uint32_t>( pos - start );
+
+		append( &unchanged, sizeof( unchanged ) );
+		append( &changed, sizeof( changed ) );
+		append( job.pPixels + start, changed * sizeof( Pixel ) );
+	}
+
+	int32_t size = static_cast<int32_t>( data.size() - sizeof( int32_t ) * 2 );
+	memcpy( data.data() + sizeof( int32_t ), &size, sizeof( int32_t ) );
+
+	std::lock_guard< std::mutex > lock( m_writeMutex );
+	m_finishedFrames[job.order] = std::move( data );
+
+	// Write this frame and any after it which were waiting for it
+	for( auto it = m_finishedFrames.find( m_nextWrite ); it != m_finishedFrames.end(); it = m_finishedFrames.find( m_nextWrite ) )
+	{
+		m_videoFile.write( reinterpret_cast<const char*>( it->second.data() ), it->second.size() );
+		m_finishedFrames.erase( it );
+		m_nextWrite++;
+	}
+
+	// A frame waiting for an earlier one hasn't been written yet, but it will fail too if the file already has
+	return !m_videoFile.fail();
+}
+
+void PlayFrameCapture::ReleaseBuffer( Pixel* pPixels )
+{
+	if( --m_bufferReferences[pPixels] > 0 )
+		return;
+
+	m_bufferReferences.erase( pPixels );
+	m_freeBuffers.push_back( pPixels );
+}
+//********************************************************************************************************************************
+// File:		PlayManager.cpp
+// Description:	A manager for providing simplified access to the PlayBuffer framework
+// Platform:	Independent
+// Notes:		The GameObject management is "opt in" as many will want to create their own GameObject class
+//********************************************************************************************************************************
+
+//**************************************************************************************************
+// GameObject Class Definition
+//**************************************************************************************************
+
+// Define this to opt in to the PlayManager
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+namespace Play
+{
+	// The GameObject members integrated by UpdateAllGameObjects, as a plain struct for snapshots to copy
+	struct GameObjectHotData
+	{
+		Point2D pos{ 0.0f, 0.0f };
+		Point2D oldPos{ 0.0f, 0.0f };
+		Vector2D velocity{ 0.0f, 0.0f };
+		Vector2D acceleration{ 0.0f, 0.0f };
+		float rotation{ 0.0f };
+		float rotSpeed{ 0.0f };
+		float oldRot{ 0.0f };
+		int frame{ 0 };
+		float framePos{ 0.0f };
+		float animSpeed{ 0.0f };
+		int lastFrameUpdated{ -1 };
+	};
+
+	// The number of GameObjects in each block of the store (a multiple of four so the SIMD lanes never straddle two blocks)
+	constexpr int GAMEOBJECT_BLOCK_SIZE = 1024;
+
+	// Structure-of-arrays storage for the GameObjectHotData of GAMEOBJECT_BLOCK_SIZE objects
+	// > Each member is packed contiguously so UpdateAllGameObjects can load four objects at a time straight from it
+	struct GameObjectBlock
+	{
+		GameObject* owners[GAMEOBJECT_BLOCK_SIZE]{}; // nullptr for free slots
+		Point2D pos[GAMEOBJECT_BLOCK_SIZE];
+		Point2D oldPos[GAMEOBJECT_BLOCK_SIZE];
+		Vector2D velocity[GAMEOBJECT_BLOCK_SIZE];
+		Vector2D acceleration[GAMEOBJECT_BLOCK_SIZE];
+		float rotation[GAMEOBJECT_BLOCK_SIZE];
+		float rotSpeed[GAMEOBJECT_BLOCK_SIZE];
+		float oldRot[GAMEOBJECT_BLOCK_SIZE];
+		int frame[GAMEOBJECT_BLOCK_SIZE];
+		float framePos[GAMEOBJECT_BLOCK_SIZE];
+		float animSpeed[GAMEOBJECT_BLOCK_SIZE];
+		int lastFrameUpdated[GAMEOBJECT_BLOCK_SIZE];
+	};
+
+	// The slots GameObjects keep their hot members in
+	// > Blocks are never moved or freed until the store is, so the GameObjects' references to them stay valid
+	struct GameObjectStore
+	{
+		std::vector<std::unique_ptr<GameObjectBlock>> blocks;
+		std::vector<int> freeSlots;
+		int slotCount{ 0 }; // Slots [0, slotCount) have been handed out at some point
+	};
+
+	// Not exposed externally
+	// > Takes the next unique id from the current context
+	int TakeGameObjectId();
+	GameObjectStore& GetGameObjectStore();
+	int TakeGameObjectSlot( GameObjectStore& store, GameObject* pOwner );
+	void ReleaseGameObjectSlot( GameObjectStore& store, int slot );
+}
+
+// Constructor for the GameObject struct - kept as simple as possible
+GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int spriteId = 0 )
+	: GameObject( type, newPos, collisionRadius, spriteId, Play::GetGameObjectStore() )
+{
+}
+
+GameObject::GameObject( int type, Point2f newPos, int collisionRadius, int spriteId, Play::GameObjectStore& store )
+	: m_pStore( &store ), m_slot( Play::TakeGameObjectSlot( store, this ) ),
+	pos( Block().pos[Index()] ), oldPos( Block().oldPos[Index()] ), velocity( Block().velocity[Index()] ), acceleration( Block().acceleration[Index()] ),
+	rotation( Block().rotation[Index()] ), rotSpeed( Block().rotSpeed[Index()] ), oldRot( Block().oldRot[Index()] ),
+	frame( Block().frame[Index()] ), framePos( Block().framePos[Index()] ), animSpeed( Block().animSpeed[Index()] ),
+	lastFrameUpdated( Block().lastFrameUpdated[Index()] )
+{
+	// Member variables are assigned default values in the class header (and the store)
+	this->type = type;
+	this->pos = newPos;
+	this->radius = collisionRadius;
+	this->spriteId = spriteId;
+	m_id = Play::TakeGameObjectId();
+}
+
+GameObject::~GameObject()
+{
+	Play::ReleaseGameObjectSlot( *m_pStore, m_slot );
+}
+
+Play::GameObjectBlock& GameObject::Block() const
+{
+	return *m_pStore->blocks[m_slot / Play::GAMEOBJECT_BLOCK_SIZE];
+}
+
+int GameObject::Index() const
+{
+	return m_slot % Play::GAMEOBJECT_BLOCK_SIZE;
+}
+
+#endif
+
+// The PlayManager is namespace rather than a class
+namespace Play
+{
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+	// The functions which add the game's own state to snapshots (see RegisterSnapshotState)
+	struct SnapshotState
+	{
+		std::function<void( std::vector<uint8_t>& )> save;
+		std::function<size_t( const uint8_t* )> load;
+	};
+
+	// A uniform hash grid which records the cells covered by each object's collision radius
+	// > Queries only visit the cells they overlap, so their cost depends on how crowded an area is rather than on the total number of objects
+	struct SpatialGrid
+	{
+		// The range of cells an object was last inserted into
+		struct Entry
+		{
+			int minX{ 0 }, minY{ 0 }, maxX{ -1 }, maxY{ -1 };
+			unsigned int queryStamp{ 0 }; // Stops objects covering several cells being reported twice
+		};
+
+		float cellSize{ 128.0f };
+		unsigned int queryStamp{ 0 };
+		std::unordered_map<long long, std::vector<int>> cells;
+		std::unordered_map<int, Entry> entries;
+	};
+
+	// The working data for UpdateContacts, which keeps its capacity between frames
+	struct ContactList
+	{
+		std::vector<std::pair<int, int>> pairs; // The registered pairs of types
+		std::vector<Contact> sweptHits; // Hits from MoveAndCollide since the last update
+		std::vector<Contact> touching; // Every pair of objects touching in this update
+		std::vector<Contact> previous; // Every pair of objects touching in the previous update
+		std::vector<Contact> contacts; // The results, including the ones which have ended
+	};
+
+#endif 
+
+	// A set of default colour definitions
+	Colour cBlack{ 0.0f, 0.0f, 0.0f };
+	Colour cRed{ 100.0f, 0.0f, 0.0f };
+	Colour cGreen{ 0.0f, 100.0f, 0.0f };
+	Colour cBlue{ 0.0f, 0.0f, 100.0f };
+	Colour cMagenta{ 100.0f, 0.0f, 100.0f };
+	Colour cCyan{ 0.0f, 100.0f, 100.0f };
+	Colour cYellow{ 100.0f, 100.0f, 0.0f };
+	Colour cOrange{ 100.0f, 50.0f, 0.0f };
+	Colour cWhite{ 100.0f, 100.0f, 100.0f };
+	Colour cGrey{ 50.0f, 50.0f, 50.0f };
+
+	// The pipelined renderer used by RunPipelined
+	// > The game records into one snapshot while the render thread draws the other
+	struct RenderPipeline
+	{
+		RenderSnapshot snapshots[2];
+		int renderIndex{ 0 };
+		bool bRendering{ false }; // The render thread is drawing snapshots[renderIndex]
+		bool bFramePending{ false }; // The drawing buffer holds a finished frame which hasn't been presented yet
+		bool bRedraw{ false }; // The next snapshot is drawn even if it's the same as the last one (the resolution has changed)
+		std::atomic< double > lastRenderMs{ 0.0 }; // How long the render thread took to draw the last snapshot
+		bool bQuit{ false };
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+	};
+
+	// Not exposed externally
+	void StopRenderPipeline();
+	void UpdateDynamicResolution();
+
+	// SetDynamicResolution waits this many frames after each change before measuring again, so the resolution doesn't flip back and forth
+	constexpr int DYNAMIC_RESOLUTION_SETTLE_FRAMES = 30;
+	// The resolution only goes back up once drawing and showing a frame takes less than this fraction of the budget
+	constexpr float DYNAMIC_RESOLUTION_HEADROOM = 0.6f;
+
+	// Everything a Context owns apart from its instances
+	struct ContextState
+	{
+		~ContextState();
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		// A map is used internally to store all the GameObjects and their unique ids
+		std::map<int, GameObject&> objectMap;
+		// The id given to the next GameObject to be created
+		int nextGameObjectId{ 0 };
+		std::vector<SnapshotState> snapshotStates;
+		SpatialGrid spatialGrid;
+		ContactList contactList;
+		// Where the GameObjects keep the members UpdateAllGameObjects integrates
+		GameObjectStore objectStore;
+		// Holds noObject apart, so UpdateAllGameObjects never moves it
+		GameObjectStore noObjectStore;
+		// The worker threads used by UpdateAllGameObjects (nullptr when updating on the game thread only)
+		PlayThreadPool* pUpdateThreadPool{ nullptr };
+		// Whether GameObjects are integrated in fixed point (see SetFixedPointPhysics)
+		bool bFixedPointPhysics{ false };
+		// Returned instead of a missing GameObject (made the first time it is needed, see NoObject)
+		GameObject* pNoObject{ nullptr };
+#endif
+
+		int frameCount{ 0 }; // Updated in Play::Present and by each RunFixedTimestep update
+
+		// The fixed timestep
+		float fixedTimestep{ 1.0f / FRAMES_PER_SECOND };
+		int maxUpdatesPerFrame{ 5 };
+		float timestepAccumulator{ 0.0f };
+		float drawInterpolation{ 1.0f }; // Used by the DrawObject functions (1 draws objects at their current position)
+		int lastUpdateFrame{ -1 }; // The frameCount of the last RunFixedTimestep or RunPipelined update (presenting moves frameCount on without an update)
+
+		RenderPipeline renderPipeline;
+
+		// The camera
+		Point2f cameraPos{ 0.0f, 0.0f };
+		DrawingSpace drawSpace{ WORLD };
+		// Toggled with F1 to show the debug information over every frame
+		bool bDebugInfo{ false };
+
+		// The stream used by RandomRoll and RandomRollRange
+		RandomStream randomStream;
+
+		// Records the frames shown by PresentDrawingBuffer (nullptr when not capturing)
+		PlayFrameCapture* pFrameCapture{ nullptr };
+
+		// Dynamic resolution (a budget of 0 when it is off)
+		float resolutionBudgetMs{ 0.0f };
+		int maxResolutionDivisor{ 1 };
+		float averageFrameMs{ 0.0f };
+		int framesAtResolution{ 0 };
+	};
+
+	// The context used by threads which haven't called SetCurrentContext
+	// > Created the first time it is needed so it is ready for any GameObjects constructed during static initialisation
+	Context& DefaultContext()
+	{
+		static Context defaultContext;
+		return defaultContext;
+	}
+
+	static thread_local Context* pCurrentContext = nullptr;
+
+	Context::Context()
+	{
+		pState = new ContextState;
+	}
+
+	Context::~Context()
+	{
+		delete pState;
+	}
+
+	ContextState::~ContextState()
+	{
+		delete pFrameCapture;
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		delete pUpdateThreadPool;
+		delete pNoObject;
+		for( std::pair<const int, GameObject&>& p : objectMap )
+			delete& p.second;
+#endif
+	}
+
+	void SetCurrentContext( Context* pContext )
+	{
+		pCurrentContext = pContext;
+	}
+
+	Context& GetCurrentContext()
+	{
+		return pCurrentContext ? *pCurrentContext : DefaultContext();
+	}
+
+	// Not exposed externally
+	// > Everything in the Play namespace goes through this to reach the state of the current context
+	inline ContextState& GetContextState()
+	{
+		return *GetCurrentContext().pState;
+	}
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+	int TakeGameObjectId()
+	{
+		return GetContextState().nextGameObjectId++;
+	}
+
+	GameObjectStore& GetGameObjectStore()
+	{
+		return GetContextState().objectStore;
+	}
+
+	// Not exposed externally
+	// > Puts a slot back to the default values (so free slots and padding lanes can be integrated without changing anything)
+	void ClearGameObjectSlot( GameObjectBlock& block, int index )
+	{
+		const GameObjectHotData defaults;
+		block.owners[index] = nullptr;
+		block.pos[index] = defaults.pos;
+		block.oldPos[index] = defaults.oldPos;
+		block.velocity[index] = defaults.velocity;
+		block.acceleration[index] = defaults.acceleration;
+		block.rotation[index] = defaults.rotation;
+		block.rotSpeed[index] = defaults.rotSpeed;
+		block.oldRot[index] = defaults.oldRot;
+		block.frame[index] = defaults.frame;
+		block.framePos[index] = defaults.framePos;
+		block.animSpeed[index] = defaults.animSpeed;
+		block.lastFrameUpdated[index] = defaults.lastFrameUpdated;
+	}
+
+	int TakeGameObjectSlot( GameObjectStore& store, GameObject* pOwner )
+	{
+		int slot = 0;
+		if( !store.freeSlots.empty() )
+		{
+			slot = store.freeSlots.back();
+			store.freeSlots.pop_back();
+		}
+		else
+		{
+			slot = store.slotCount++;
+			if( slot / GAMEOBJECT_BLOCK_SIZE == static_cast<int>( store.blocks.size() ) )
+			{
+				store.blocks.push_back( std::make_unique<GameObjectBlock>() );
+				for( int n = 0; n < GAMEOBJECT_BLOCK_SIZE; n++ )
+					ClearGameObjectSlot( *store.blocks.back(), n );
+			}
+		}
+
+		store.blocks[slot / GAMEOBJECT_BLOCK_SIZE]->owners[slot % GAMEOBJECT_BLOCK_SIZE] = pOwner;
+		return slot;
+	}
+
+	void ReleaseGameObjectSlot( GameObjectStore& store, int slot )
+	{
+		ClearGameObjectSlot( *store.blocks[slot / GAMEOBJECT_BLOCK_SIZE], slot % GAMEOBJECT_BLOCK_SIZE );
+		store.freeSlots.push_back( slot );
+	}
+
+	// Used instead of Null return values, PlayMangager operations performed on this GameObject should fail transparently
+	// > Each context has its own, so a game writing through a missing id can't race with the games on other threads
+	// > Not exposed externally
+	GameObject& NoObject()
+	{
+		ContextState& state = GetContextState();
+		if( !state.pNoObject )
+		{
+			// It doesn't use up an id, so the ids the game's objects are given don't depend on whether it has been made
+			int nextId = state.nextGameObjectId;
+			state.pNoObject = new GameObject( -1, { 0, 0 }, 0, -1, state.noObjectStore );
+			state.nextGameObjectId = nextId;
+		}
+		return *state.pNoObject;
+	}
+#endif
+
+	#define TRANSFORM_SPACE( p )  GetContextState().drawSpace == WORLD ? p - GetContextState().cameraPos : p
+	#define TRANSFORM_MATRIX_SPACE( t ) GetContextState().drawSpace == WORLD ? (MatrixTranslation( -GetContextState().cameraPos.x, -GetContextState().cameraPos.y ) * t) : t
+
+	//**************************************************************************************************
+	// Manager creation and deletion
+	//**************************************************************************************************
+
+	void CreateManager( int displayWidth, int displayHeight, int displayScale )
+	{
+		PlayGraphics::Instance( displayWidth, displayHeight, "Data\\Sprites\\" );
+		PlayWindow::Instance( PlayGraphics::Instance().GetDrawingBuffer(), displayScale );
+		PlayWindow::Instance().RegisterMouse( PlayInput::Instance().GetMouseData() );
+		PlayAudio::Instance( "Data\\Audio\\" );
+		// Seed the game's random number generators based on the time (or the seed from the input recording being replayed)
+		srand( PlayInput::Instance().GetRandomSeed() );
+		SeedRandom( PlayInput::Instance().GetRandomSeed() );
+	}
+
+	void DestroyManager()
+	{
+		StopRenderPipeline();
+		if( GetCurrentContext().pWindow )
+			PlayWindow::Instance().StopPresentThread();
+		StopFrameCapture();
+		PlayAudio::Destroy();
+		PlayGraphics::Destroy();
+		PlayWindow::Destroy();
+		PlayInput::Destroy();
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		SetUpdateThreadCount( 1 );
+		for( std::pair<const int, GameObject&>& p : GetContextState().objectMap )
+			delete& p.second;
+		GetContextState().objectMap.clear();
+		GetContextState().spatialGrid.cells.clear();
+		GetContextState().spatialGrid.entries.clear();
+		GetContextState().contactList = ContactList();
+		GetContextState().snapshotStates.clear();
+#endif
+	}
+
+	int GetBufferWidth()
+	{
+		return PlayWindow::Instance().GetWidth();
+	}
+
+	int GetBufferHeight()
+	{
+		return PlayWindow::Instance().GetHeight();
+	}
+
+	//**************************************************************************************************
+	// Timing functions
+	//**************************************************************************************************
+
+	void SetTargetFrameRate( int framesPerSecond )
+	{
+		PlayWindow::Instance().SetTargetFrameRate( framesPerSecond );
+	}
+
+	const PlayWindow::FramePacingStats& GetFramePacingStats()
+	{
+		return PlayWindow::Instance().GetFramePacingStats();
+	}
+
+	void NextFrame()
+	{
+		GetContextState().frameCount++;
+	}
+
+	void SetFixedTimestep( int updatesPerSecond, int maxUpdates )
+	{
+		PLAY_ASSERT_MSG( updatesPerSecond > 0 && maxUpdates > 0, "Invalid fixed timestep" );
+		GetContextState().fixedTimestep = 1.0f / updatesPerSecond;
+		GetContextState().maxUpdatesPerFrame = maxUpdates;
+	}
+
+	bool RunFixedTimestep( float elapsedTime, const std::function<bool()>& update, const std::function<void( float )>& render )
+	{
+		ContextState& context = GetContextState();
+
+		// After a long hitch it's better to slow the game down than to freeze trying to catch up
+		context.timestepAccumulator = std::min( context.timestepAccumulator + elapsedTime, context.fixedTimestep * context.maxUpdatesPerFrame );
+
+		while( context.timestepAccumulator >= context.fixedTimestep )
+		{
+			context.timestepAccumulator -= context.fixedTimestep;
+
+			// Each update counts as a new frame, so objects can be updated once per update
+			context.frameCount++;
+			context.lastUpdateFrame = context.frameCount;
+			if( update() )
+				return true;
+		}
+
+		context.drawInterpolation = context.timestepAccumulator / context.fixedTimestep;
+		render( context.drawInterpolation );
+		context.drawInterpolation = 1.0f;
+		return false;
+	}
+
+	// Not exposed externally
+	// > Draws each snapshot it is given until StopRenderPipeline is called
+	// > The render thread works on the context of the game which started it
+	void RenderThreadLoop( Context* pContext )
+	{
+		SetCurrentContext( pContext );
+		RenderPipeline& pipeline = GetContextState().renderPipeline;
+		std::unique_lock<std::mutex> lock( pipeline.mutex );
+
+		while( true )
+		{
+			pipeline.wakeCondition.wait( lock, [&pipeline] { return pipeline.bRendering || pipeline.bQuit; } );
+
+			if( pipeline.bQuit )
+				return;
+
+			lock.unlock();
+			LARGE_INTEGER frequency, before, after;
+			QueryPerformanceFrequency( &frequency );
+			QueryPerformanceCounter( &before );
+			pipeline.snapshots[pipeline.renderIndex].Render();
+			QueryPerformanceCounter( &after );
+			pipeline.lastRenderMs = ( after.QuadPart - before.QuadPart ) * 1000.0 / frequency.QuadPart;
+			lock.lock();
+
+			pipeline.bRendering = false;
+			pipeline.doneCondition.notify_all();
+		}
+	}
+
+	// Not exposed externally
+	void WaitForRenderThread()
+	{
+		RenderPipeline& pipeline = GetContextState().renderPipeline;
+		std::unique_lock<std::mutex> lock( pipeline.mutex );
+		pipeline.doneCondition.wait( lock, [&pipeline] { return !pipeline.bRendering; } );
+	}
+
+	// Not exposed externally
+	void StopRenderPipeline()
+	{
+		RenderPipeline& pipeline = GetContextState().renderPipeline;
+		if( !pipeline.thread.joinable() )
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock( pipeline.mutex );
+			pipeline.bQuit = true;
+		}
+		pipeline.wakeCondition.notify_all();
+		pipeline.thread.join();
+
+		pipeline.bRendering = false;
+		pipeline.bFramePending = false;
+		pipeline.bQuit = false;
+		pipeline.snapshots[0].Reset();
+		pipeline.snapshots[1].Reset();
+	}
+
+	bool RunPipelined( float elapsedTime, const std::function<bool()>& update, const std::function<void( RenderSnapshot&, float )>& describe )
+	{
+		ContextState& context = GetContextState();
+		RenderPipeline& pipeline = context.renderPipeline;
+
+		if( !pipeline.thread.joinable() && !PlayWindow::IsHeadless() )
+			pipeline.thread = std::thread( RenderThreadLoop, &GetCurrentContext() );
+
+		// The updates run at the same time as the render thread draws the last frame
+		context.timestepAccumulator = std::min( context.timestepAccumulator + elapsedTime, context.fixedTimestep * context.maxUpdatesPerFrame );
+
+		while( context.timestepAccumulator >= context.fixedTimestep )
+		{
+			context.timestepAccumulator -= context.fixedTimestep;
+
+			context.frameCount++;
+			context.lastUpdateFrame = context.frameCount;
+			if( update() )
+			{
+				WaitForRenderThread();
+				return true;
+			}
+		}
+
+		// Nothing is drawn in headless mode
+		if( PlayWindow::IsHeadless() )
+		{
+			PresentDrawingBuffer();
+			return false;
+		}
+
+		// Record the new frame into the snapshot the render thread isn't using
+		RenderSnapshot& snapshot = pipeline.snapshots[1 - pipeline.renderIndex];
+		snapshot.Reset();
+		context.drawInterpolation = context.timestepAccumulator / context.fixedTimestep;
+		describe( snapshot, context.drawInterpolation );
+		context.drawInterpolation = 1.0f;
+
+		// Show the last frame once it has been drawn, then start drawing the new one
+		WaitForRenderThread();
+		if( pipeline.bFramePending )
+		{
+			PresentDrawingBuffer();
+			pipeline.bFramePending = false;
+		}
+
+		// The drawing buffer already holds this frame (static screens like menus send the same frame over and over)
+		// > Capturing swaps the drawing buffer each frame, so every frame is drawn while it is on
+		bool bIdle = !context.pFrameCapture && !pipeline.bRedraw && snapshot.IsSameAs( pipeline.snapshots[pipeline.renderIndex] );
+		pipeline.bRedraw = false;
+		PlayWindow::Instance().SetIdle( bIdle );
+		if( bIdle )
+			return false;
+
+		{
+			std::lock_guard<std::mutex> lock( pipeline.mutex );
+			pipeline.renderIndex = 1 - pipeline.renderIndex;
+			pipeline.bRendering = true;
+			pipeline.bFramePending = true;
+		}
+		pipeline.wakeCondition.notify_one();
+
+		return false;
+	}
+
+	//**************************************************************************************************
+	// PlayGraphics functions
+	//**************************************************************************************************
+
+	void ClearDrawingBuffer( Colour c )
+	{
+		if( PlayWindow::IsHeadless() ) return; // Nothing is drawn in headless mode
+		int r = static_cast<int>( c.red * 2.55f );
+		int g = static_cast<int>( c.green * 2.55f );
+		int b = static_cast<int>( c.blue * 2.55f );
+		PlayGraphics::Instance().ClearBuffer( { r, g, b } );
+	}
+
+	int LoadBackground( const char* pngFilename )
+	{
+		return PlayGraphics::Instance().LoadBackground( pngFilename );
+	}
+
+	void DrawBackground( int background )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawBackground( background );
+	}
+
+	void DrawDebugText( Point2D pos, const char* text, Colour c, bool centred )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawDebugString( TRANSFORM_SPACE( pos ), text, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, centred );
+	}
+
+	void PresentDrawingBuffer()
+	{
+		if( PlayWindow::IsHeadless() )
+		{
+			// Still counts as a frame so headless runs behave the same as normal ones
+			GetContextState().frameCount++;
+			return;
+		}
+
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		DrawingSpace originalDrawSpace = GetContextState().drawSpace;
+
+		if( KeyPressed( VK_F1 ) )
+			GetContextState().bDebugInfo = !GetContextState().bDebugInfo;
+
+		if( GetContextState().bDebugInfo )
+		{
+			GetContextState().drawSpace = SCREEN;
+
+			int textX = 10;
+			int textY = 10;
+			std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
+			pblt.DrawDebugString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
+			pblt.DrawDebugString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
+			pblt.DrawDebugString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
+			pblt.DrawDebugString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
+			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false );
+
+			GetContextState().drawSpace = WORLD;
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+			
+			for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+			{
+				GameObject& obj = i.second;
+				int id = obj.spriteId;
+				Vector2D size = pblt.GetSpriteSize( obj.spriteId );
+				Vector2D origin = pblt.GetSpriteOrigin( id );
+
+				// Corners of sprite drawing area
+				Point2D p0 = obj.pos - origin;
+				Point2D p2 = { obj.pos.x + size.width - origin.x, obj.pos.y + size.height - origin.y };
+				Point2D p1 = { p2.x, p0.y };
+				Point2D p3 = { p0.x, p2.y };
+
+				DrawLine( p0, p1, cRed );
+				DrawLine( p1, p2, cRed );
+				DrawLine( p2, p3, cRed );
+				DrawLine( p3, p0, cRed );
+
+				DrawCircle( obj.pos, obj.radius, cBlue );
+
+				DrawLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, cWhite );
+				DrawLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, cWhite );
+
+				s = pblt.GetSpriteName( obj.spriteId ) + " f[" + std::to_string( obj.frame % pblt.GetSpriteFrames( obj.spriteId ) ) + "]";
+				DrawDebugText( { ( p0.x + p1.x ) / 2.0f, p0.y - 20 }, s.c_str() );
+			}
+#endif
+		}
+
+		// The present thread shows, exports and captures the frame itself while the next one is drawn
+		PlayWindow& window = PlayWindow::Instance();
+		if( window.IsPresentThreadRunning() )
+		{
+			window.QueuePresent();
+		}
+		else
+		{
+			window.Present();
+			window.ExportFrame( pblt.GetDrawingBuffer()->pPixels );
+			if( GetContextState().pFrameCapture )
+				GetContextState().pFrameCapture->Capture( pblt.GetDrawingBuffer()->pPixels );
+		}
+		GetContextState().frameCount++;
+
+		GetContextState().drawSpace = originalDrawSpace;
+
+		// The next frame hasn't started drawing yet, so this is when the resolution can change
+		UpdateDynamicResolution();
+	}
+
+	// Not exposed externally
+	void UpdateDynamicResolution()
+	{
+		ContextState& context = GetContextState();
+		if( context.resolutionBudgetMs <= 0.0f )
+			return;
+
+		PlayWindow& window = PlayWindow::Instance();
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		int divisor = graphics.GetResolutionDivisor();
+
+		if( context.pFrameCapture || window.IsExportingFrames() )
+		{
+			SetResolutionDivisor( 1 );
+			return;
+		}
+
+		// Frames which are skipped while idle say nothing about how long drawing takes
+		if( window.IsIdle() )
+			return;
+
+		// Only drawing and showing a frame get faster at a lower resolution, so the game logic isn't counted
+		// > Without the render thread the frame is drawn inside MainGameUpdate, so the whole update is all there is to go on
+		RenderPipeline& pipeline = context.renderPipeline;
+		double frameMs = pipeline.thread.joinable() ? pipeline.lastRenderMs + window.GetLastPresentMs() : window.GetLastUpdateMs();
+
+		// An average over the last few frames, so one slow frame doesn't change the resolution
+		float drawMs = static_cast<float>( frameMs );
+		context.averageFrameMs = context.framesAtResolution == 0 ? drawMs : context.averageFrameMs + ( drawMs - context.averageFrameMs ) * 0.1f;
+		if( ++context.framesAtResolution < DYNAMIC_RESOLUTION_SETTLE_FRAMES )
+			return;
+
+		// Step to the next divisor which fits the display exactly
+		int newDivisor = divisor;
+		if( context.averageFrameMs > context.resolutionBudgetMs )
+		{
+			for( newDivisor = divisor + 1; newDivisor <= context.maxResolutionDivisor && !graphics.IsValidResolutionDivisor( newDivisor ); newDivisor++ );
+		}
+		else if( context.averageFrameMs < context.resolutionBudgetMs * DYNAMIC_RESOLUTION_HEADROOM )
+		{
+			for( newDivisor = divisor - 1; newDivisor > 1 && !graphics.IsValidResolutionDivisor( newDivisor ); newDivisor-- );
+		}
+
+		if( newDivisor >= 1 && newDivisor <= context.maxResolutionDivisor )
+			SetResolutionDivisor( newDivisor );
+	}
+
+	bool StartFrameExport( const char* name, int slotCount )
+	{
+		// Exported frames are always the full size of the display
+		SetResolutionDivisor( 1 );
+		return PlayWindow::Instance().StartFrameExport( name, slotCount );
+	}
+
+	void StopFrameExport()
+	{
+		PlayWindow::Instance().StopFrameExport();
+	}
+
+	void SetPresentThread( bool threaded )
+	{
+		if( !threaded )
+		{
+			PlayWindow::Instance().StopPresentThread();
+			return;
+		}
+
+		// Frames are captured from the present thread, as that is where they are shown
+		ContextState& state = GetContextState();
+		PlayWindow::Instance().StartPresentThread( [&state]( Pixel*& pPixels )
+		{
+			if( state.pFrameCapture )
+				state.pFrameCapture->Capture( pPixels );
+		} );
+	}
+
+	void SetUpscaleThreads( int workerCount )
+	{
+		PlayWindow::Instance().SetUpscaleThreads( workerCount );
+	}
+
+	double GetUpscaleMs()
+	{
+		return PlayWindow::Instance().GetLastUpscaleMs();
+	}
+
+	void SetResolutionDivisor( int divisor )
+	{
+		PlayGraphics& graphics = PlayGraphics::Instance();
+		if( divisor == graphics.GetResolutionDivisor() )
+			return;
+
+		// Nothing can be drawing or showing a frame while the drawing buffer changes size
+		WaitForRenderThread();
+		PlayWindow::Instance().WaitForPresent();
+		graphics.SetResolutionDivisor( divisor );
+
+		GetContextState().renderPipeline.bRedraw = true;
+		GetContextState().framesAtResolution = 0;
+	}
+
+	int GetResolutionDivisor()
+	{
+		return PlayGraphics::Instance().GetResolutionDivisor();
+	}
+
+	void SetDynamicResolution( float budgetMs, int maxDivisor )
+	{
+		PLAY_ASSERT_MSG( maxDivisor > 0, "Invalid maximum resolution divisor" );
+		ContextState& context = GetContextState();
+		context.resolutionBudgetMs = std::max( budgetMs, 0.0f );
+		context.maxResolutionDivisor = maxDivisor;
+		context.framesAtResolution = 0;
+
+		if( budgetMs <= 0.0f || GetResolutionDivisor() > maxDivisor )
+			SetResolutionDivisor( 1 );
+
+		// Shrinking every sprite takes a while, so it is done now rather than when a frame is already over budget
+		WaitForRenderThread();
+		PlayGraphics::Instance().PrepareResolutionDivisors( budgetMs > 0.0f ? maxDivisor : 1 );
+	}
+
+	void StartFrameCapture( const char* path, PlayFrameCapture::Format format, int workerCount, int bufferCount )
+	{
+		StopFrameCapture();
+		SetResolutionDivisor( 1 );
+		PlayWindow::Instance().WaitForPresent();
+		GetContextState().pFrameCapture = new PlayFrameCapture( path, format, GetBufferWidth(), GetBufferHeight(), workerCount, bufferCount );
+	}
+
+	PlayFrameCapture::Stats StopFrameCapture()
+	{
+		PlayFrameCapture* pCapture = GetContextState().pFrameCapture;
+		if( !pCapture )
+			return PlayFrameCapture::Stats();
+
+		// The present thread may still be capturing the last frame
+		if( GetCurrentContext().pWindow )
+			PlayWindow::Instance().WaitForPresent();
+
+		pCapture->Finish();
+		PlayFrameCapture::Stats stats = pCapture->GetStats();
+		delete pCapture;
+		GetContextState().pFrameCapture = nullptr;
+		return stats;
+	}
+
+	PlayFrameCapture::Stats GetFrameCaptureStats()
+	{
+		return GetContextState().pFrameCapture ? GetContextState().pFrameCapture->GetStats() : PlayFrameCapture::Stats();
+	}
+
+	Point2D GetMousePos()
+	{
+		PlayInput& input = PlayInput::Instance();
+		return input.GetMousePos();
+	}
+
+	bool GetMouseButton( Align button )
+	{
+		PlayInput& input = PlayInput::Instance();
+		return input.GetMouseDown( static_cast<PlayInput::MouseButton>(button));
+	}
+
+	//**************************************************************************************************
+	// PlaySpeaker functions
+	//**************************************************************************************************
+
+	void PlayAudio( const char* fileName )
+	{
+		PlayAudio::Instance().StartAudio( fileName, false );
+	}
+
+	void StartAudioLoop( const char* fileName )
+	{
+		PlayAudio::Instance().StartAudio( fileName, true );
+	}
+
+	void StopAudioLoop( const char* fileName )
+	{
+		PlayAudio::Instance().StopAudio( fileName );
+	}
+
+	//**************************************************************************************************
+	// Camera functions
+	//**************************************************************************************************
+
+	void SetCameraPosition( Point2f pos ) { GetContextState().cameraPos = pos; }
+
+	Point2f GetCameraPosition( void ) { return GetContextState().cameraPos; }
+
+	void SetDrawingSpace( DrawingSpace space ) { GetContextState().drawSpace = space;	}
+
+	DrawingSpace GetDrawingSpace( void ) { return GetContextState().drawSpace; }
+
+	//**************************************************************************************************
+	// PlayGraphics functions
+	//**************************************************************************************************
+
+	int GetSpriteId( const char* spriteName )
+	{
+		return PlayGraphics::Instance().GetSpriteId( spriteName );
+	}
+
+	int GetSpriteHeight( const char* spriteName )
+	{
+		return static_cast<int>(PlayGraphics::Instance().GetSpriteSize( GetSpriteId( spriteName ) ).height);
+	}
+
+	int GetSpriteWidth( const char* spriteName )
+	{
+		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( GetSpriteId( spriteName ) ).width );
+	}
+
+	int GetSpriteHeight( int spriteId )
+	{
+		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( spriteId ).height );
+	}
+
+	int GetSpriteWidth( int spriteId )
+	{
+		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( spriteId ).width );
+	}
+
+	Point2D GetSpriteOrigin( const char* spriteName )
+	{
+		return PlayGraphics::Instance().GetSpriteOrigin( GetSpriteId( spriteName ) );
+	}
+
+	Point2D GetSpriteOrigin( int spriteId )
+	{
+		return PlayGraphics::Instance().GetSpriteOrigin( spriteId );
+	}
+
+	const char* GetSpriteName( int spriteId )
+	{
+		return PlayGraphics::Instance().GetSpriteName( spriteId ).c_str();
+	}
+
+	const PixelData* GetSpritePixelData( int spriteId )
+	{
+		return PlayGraphics::Instance().GetSpritePixelData( spriteId );
+	}
+
+	int GetSpriteFrames( int spriteId )
+	{
+		return static_cast<int>( PlayGraphics::Instance().GetSpriteFrames( spriteId ) );
+	}
+
+	void ColourSprite( const char* spriteName, Colour c )
+	{
+		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
+		PlayGraphics::Instance().ColourSprite( spriteId, static_cast<int>( c.red * 2.55f ), static_cast<int>( c.green * 2.55f), static_cast<int>( c.blue * 2.55f ) );
+	}
+
+	void CentreSpriteOrigin( const char* spriteName )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		int spriteId = pblt.GetSpriteId( spriteName );
+		pblt.SetSpriteOrigin( spriteId, pblt.GetSpriteSize( spriteId ) / 2, false );
+	}
+
+	void CentreMatchingSpriteOrigins( const char* rootName )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		int spriteId = pblt.GetSpriteId( rootName ); // Finds the first matching sprite and assumes same dimensions
+		pblt.SetSpriteOrigins( rootName, pblt.GetSpriteSize( spriteId ) / 2, false );
+	}
+
+	void CentreAllSpriteOrigins()
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+
+		for( int i = 0; i < pblt.GetTotalLoadedSprites(); i++ )
+			pblt.SetSpriteOrigin( i, pblt.GetSpriteSize( i ) / 2, false );
+	}
+
+	void MoveSpriteOrigin( const char* spriteName, int xOffset, int yOffset )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		int spriteId = pblt.GetSpriteId( spriteName );
+		pblt.SetSpriteOrigin( spriteId, { xOffset, yOffset }, true ); // relative option set
+	}
 
-#endif 
+	void MoveMatchingSpriteOrigins( const char* rootName, int xoffset, int yoffset )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		pblt.SetSpriteOrigins( rootName, { xoffset, yoffset }, true ); // relative option set
+	}
 
-	// A set of default colour definitions
-	Colour cBlack{ 0.0f, 0.0f, 0.0f };
-	Colour cRed{ 100.0f, 0.0f, 0.0f };
-	Colour cGreen{ 0.0f, 100.0f, 0.0f };
-	Colour cBlue{ 0.0f, 0.0f, 100.0f };
-	Colour cMagenta{ 100.0f, 0.0f, 100.0f };
-	Colour cCyan{ 0.0f, 100.0f, 100.0f };
-	Colour cYellow{ 100.0f, 100.0f, 0.0f };
-	Colour cOrange{ 100.0f, 50.0f, 0.0f };
-	Colour cWhite{ 100.0f, 100.0f, 100.0f };
-	Colour cGrey{ 50.0f, 50.0f, 50.0f };
+	void MoveAllSpriteOrigins()
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
 
-	int frameCount = 0; // Updated in Play::Present
+		for( int i = 0; i < pblt.GetTotalLoadedSprites(); i++ )
+			pblt.SetSpriteOrigin( i, pblt.GetSpriteSize( i ) / 2, true );
+	}
 
-	// The camera
-	Point2f cameraPos{ 0.0f, 0.0f };
-	DrawingSpace drawSpace = WORLD;
+	void SetSpriteOrigin( int spriteId, int xOrigin, int yOrigin )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		pblt.SetSpriteOrigin( spriteId, { xOrigin, yOrigin } );
+	}
 
-	#define TRANSFORM_SPACE( p )  drawSpace == WORLD ? p - cameraPos : p
-	#define TRANSFORM_MATRIX_SPACE( t ) drawSpace == WORLD ? (MatrixTranslation( -cameraPos.x, -cameraPos.y ) * t) : t
+	void SetSpriteOrigin( const char* spriteName, int xOrigin, int yOrigin )
+	{
+		PlayGraphics& pblt = PlayGraphics::Instance();
+		int spriteId = pblt.GetSpriteId( spriteName );
+		pblt.SetSpriteOrigin( spriteId, { xOrigin, yOrigin } ); 
+	}
 
-	//**************************************************************************************************
-	// Manager creation and deletion
-	//**************************************************************************************************
+	void DrawSprite( const char* spriteName, Point2D pos, int frameIndex )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().Draw( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex );
+	}
 
-	void CreateManager( int displayWidth, int displayHeight, int displayScale )
+	void DrawSprite( int spriteID, Point2D pos, int frameIndex )
 	{
-		PlayGraphics::Instance( displayWidth, displayHeight, "Data\\Sprites\\" );
-		PlayWindow::Instance( PlayGraphics::Instance().GetDrawingBuffer(), displayScale );
-		PlayWindow::Instance().RegisterMouse( PlayInput::Instance().GetMouseData() );
-		PlayAudio::Instance( "Data\\Audio\\" );
-		// Seed the game's random number generator based on the time
-		srand( (int)time( NULL ) );
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().Draw( spriteID, TRANSFORM_SPACE( pos ), frameIndex );
 	}
 
-	void DestroyManager()
+	void DrawSpriteTransparent( const char* spriteName, Point2D pos, int frameIndex, float opacity )
 	{
-		PlayAudio::Destroy();
-		PlayGraphics::Destroy();
-		PlayWindow::Destroy();
-		PlayInput::Destroy();
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
-		for( std::pair<const int, GameObject&>& p : objectMap )
-			delete& p.second;
-		objectMap.clear();
-#endif
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawTransparent( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex, opacity );
 	}
 
-	int GetBufferWidth()
+	void DrawSpriteTransparent( int spriteID, Point2D pos, int frameIndex, float opacity )
 	{
-		return PlayWindow::Instance().GetWidth();
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawTransparent( spriteID, TRANSFORM_SPACE( pos ), frameIndex, opacity );
 	}
 
-	int GetBufferHeight()
+	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frameIndex, float angle, float scale, float opacity )
 	{
-		return PlayWindow::Instance().GetHeight();
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawRotated( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex, angle, scale, opacity );
 	}
 
-	//**************************************************************************************************
-	// PlayGraphics functions
-	//**************************************************************************************************
+	void DrawSpriteRotated( int spriteID, Point2D pos, int frameIndex, float angle, float scale, float opacity )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawRotated( spriteID, TRANSFORM_SPACE( pos ), frameIndex, angle, scale, opacity );
+	}
 
-	void ClearDrawingBuffer( Colour c )
+	void DrawSpriteTransformed( int spriteID, const Matrix2D& transform, int frameIndex, float opacity  )
 	{
-		int r = static_cast<int>( c.red * 2.55f );
-		int g = static_cast<int>( c.green * 2.55f );
-		int b = static_cast<int>( c.blue * 2.55f );
-		PlayGraphics::Instance().ClearBuffer( { r, g, b } );
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawTransformed( spriteID, TRANSFORM_MATRIX_SPACE( transform ), frameIndex, opacity );
 	}
 
-	int LoadBackground( const char* pngFilename )
+	void DrawLine( Point2f start, Point2f end, Colour c )
 	{
-		return PlayGraphics::Instance().LoadBackground( pngFilename );
+		if( PlayWindow::IsHeadless() ) return;
+		return PlayGraphics::Instance().DrawLine( TRANSFORM_SPACE( start ), TRANSFORM_SPACE( end ), { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }  );
 	}
 
-	void DrawBackground( int background )
+	void DrawCircle( Point2D pos, int radius, Colour c )
 	{
-		PlayGraphics::Instance().DrawBackground( background );
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawCircle( TRANSFORM_SPACE( pos ), radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
 	}
 
-	void DrawDebugText( Point2D pos, const char* text, Colour c, bool centred )
+	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour c, bool fill )
 	{
-		PlayGraphics::Instance().DrawDebugString( TRANSFORM_SPACE( pos ), text, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, centred );
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawRect( TRANSFORM_SPACE( topLeft ), TRANSFORM_SPACE( bottomRight ), { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, fill );
 	}
 
-	void PresentDrawingBuffer()
+	void DrawSpriteLine( Point2f startPos, Point2f endPos, const char* penSprite, Colour c )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		static bool debugInfo = false;
-		DrawingSpace originalDrawSpace = drawSpace;
+		if( PlayWindow::IsHeadless() ) return;
+		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
+		ColourSprite( penSprite, c );
 
-		if( KeyPressed( VK_F1 ) )
-			debugInfo = !debugInfo;
+		//Draws a line in any angle
+		int x1 = static_cast<int>( startPos.x );
+		int y1 = static_cast<int>( startPos.y );
+		int x2 = static_cast<int>( endPos.x );
+		int y2 = static_cast<int>( endPos.y );
+
+		//Implementation of Bresenham's Line Drawing Algorithm
+		int dx = abs( x2 - x1 );
+		int sx = 1;
+		if( x2 < x1 ) { sx = -1; }
 
-		if( debugInfo )
+		int dy = -abs( y2 - y1 );
+		int sy = 1;
+		if( y2 < y1 ) { sy = -1; }
+		
+		int err = dx + dy;
+
+		if( dx == 0 && dy == 0 ) return;
+
+		while( true )
 		{
-			drawSpace = SCREEN;
+			Play::DrawSprite( spriteId, { x1, y1 }, 0 );
+			
+			if( x1 == x2 && y1 == y2 )
+				break;
 
-			int textX = 10;
-			int textY = 10;
-			std::string s = "PlayBuffer Version:" + std::string( PLAY_VERSION );
-			pblt.DrawDebugString( { textX - 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX + 1, textY - 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX - 1, textY + 1 }, s, PIX_BLACK, false );
-			pblt.DrawDebugString( { textX, textY }, s, PIX_YELLOW, false );
+			int e2 = 2 * err;
+			if( e2 >= dy )
+			{
+				err += dy;
+				x1 += sx;
+			}
+			if( e2 <= dx )
+			{
+				err += dx;
+				y1 += sy;
+			}
+		}
+	}
+
+	// Not exposed externally
+	void DrawCircleOctants( int spriteId, int x, int y, int ox, int oy )
+	{
+		//displaying all 8 coordinates of(x,y) residing in 8-octants
+		Play::DrawSprite( spriteId, { x + ox, y + oy }, 0 );
+		Play::DrawSprite( spriteId, { x - ox, y + oy }, 0 );
+		Play::DrawSprite( spriteId, { x + ox, y - oy }, 0 );
+		Play::DrawSprite( spriteId, { x - ox, y - oy }, 0 );
+		Play::DrawSprite( spriteId, { x + oy, y + ox }, 0 );
+		Play::DrawSprite( spriteId, { x - oy, y + ox }, 0 );
+		Play::DrawSprite( spriteId, { x + oy, y - ox }, 0 );
+		Play::DrawSprite( spriteId, { x - oy, y - ox }, 0 );
+	}
+
+	void DrawSpriteCircle( Point2D pos, int radius, const char* penSprite, Colour c )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
+		ColourSprite( penSprite, c );
+
+		pos = TRANSFORM_SPACE( pos );
+
+		int ox = 0, oy = radius;
+		int d = 3 - 2 * radius;
+		DrawCircleOctants( spriteId, static_cast<int>(pos.x), static_cast<int>(pos.y), ox, oy );
+
+		while( oy >= ox )
+		{
+			ox++;
+			if( d > 0 )
+			{
+				oy--;
+				d = d + 4 * ( ox - oy ) + 10;
+			}
+			else
+			{
+				d = d + 4 * ox + 6;
+			}
+			DrawCircleOctants( spriteId, static_cast<int>(pos.x), static_cast<int>(pos.y), ox, oy );
+		}
+	};
+
+	void DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		int font = PlayGraphics::Instance().GetSpriteId( fontId );
+
+		int totalWidth{ 0 };
+
+		for( char c : text )
+			totalWidth += PlayGraphics::Instance().GetFontCharWidth( font, c );
+
+		switch( justify )
+		{
+			case CENTRE:
+				pos.x -= totalWidth / 2;
+				break;
+			case RIGHT:
+				pos.x -= totalWidth;
+				break;
+			default:
+				break;
+		}
+
+		pos.x += PlayGraphics::Instance().GetSpriteOrigin( font ).x;
+		PlayGraphics::Instance().DrawString( font, TRANSFORM_SPACE( pos ), text );
+	}
+
+	void BeginTimingBar( Colour c )
+	{
+		PlayGraphics::Instance().TimingBarBegin( Pixel( c.red*2.55f, c.green*2.55f, c.blue*2.55f ) );
+	}
+
+	int ColourTimingBar( Colour c )
+	{
+		return PlayGraphics::Instance().SetTimingBarColour( Pixel( c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f ) );
+	}
+
+	void DrawTimingBar( Point2f pos, Point2f size )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		PlayGraphics::Instance().DrawTimingBar( pos, size );
+	}
+
+
+	//**************************************************************************************************
+	// GameObject functions
+	//**************************************************************************************************
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+	//**************************************************************************************************
+	// Spatial index
+	//**************************************************************************************************
+
+	// Not exposed externally
+	long long SpatialCellKey( int x, int y )
+	{
+		return ( static_cast<long long>( x ) << 32 ) | static_cast<unsigned int>( y );
+	}
+
+	// Not exposed externally
+	int SpatialCellCoord( float f )
+	{
+		return static_cast<int>( floor( f / GetContextState().spatialGrid.cellSize ) );
+	}
+
+	// Not exposed externally
+	void RemoveFromSpatialCells( int id, const SpatialGrid::Entry& e )
+	{
+		for( int y = e.minY; y <= e.maxY; y++ )
+		{
+			for( int x = e.minX; x <= e.maxX; x++ )
+			{
+				std::unordered_map<long long, std::vector<int>>::iterator cell = GetContextState().spatialGrid.cells.find( SpatialCellKey( x, y ) );
+				if( cell == GetContextState().spatialGrid.cells.end() )
+					continue;
+
+				std::vector<int>& ids = cell->second;
+				std::vector<int>::iterator i = std::find( ids.begin(), ids.end(), id );
+				if( i != ids.end() )
+				{
+					// Order within a cell doesn't matter, so swap with the last one rather than shuffling everything down
+					*i = ids.back();
+					ids.pop_back();
+				}
+
+				if( ids.empty() )
+					GetContextState().spatialGrid.cells.erase( cell );
+			}
+		}
+	}
 
-			drawSpace = WORLD;
+	void UpdateSpatialIndex( GameObject& obj )
+	{
+		if( obj.type == -1 ) return; // Not for noObject
 
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
-			
-			for( std::pair<const int, GameObject&>& i : objectMap )
-			{
-				GameObject& obj = i.second;
-				int id = obj.spriteId;
-				Vector2D size = pblt.GetSpriteSize( obj.spriteId );
-				Vector2D origin = pblt.GetSpriteOrigin( id );
+		// Objects are indexed by whichever is bigger of their collision radius and collision box
+		float rx = std::max( static_cast<float>( obj.radius ), obj.aabb.x );
+		float ry = std::max( static_cast<float>( obj.radius ), obj.aabb.y );
+		SpatialGrid::Entry& e = GetContextState().spatialGrid.entries[obj.GetId()];
 
-				// Corners of sprite drawing area
-				Point2D p0 = obj.pos - origin;
-				Point2D p2 = { obj.pos.x + size.width - origin.x, obj.pos.y + size.height - origin.y };
-				Point2D p1 = { p2.x, p0.y };
-				Point2D p3 = { p0.x, p2.y };
+		int minX = SpatialCellCoord( obj.pos.x - rx );
+		int minY = SpatialCellCoord( obj.pos.y - ry );
+		int maxX = SpatialCellCoord( obj.pos.x + rx );
+		int maxY = SpatialCellCoord( obj.pos.y + ry );
 
-				DrawLine( p0, p1, cRed );
-				DrawLine( p1, p2, cRed );
-				DrawLine( p2, p3, cRed );
-				DrawLine( p3, p0, cRed );
+		// Most objects stay in the same cells from one frame to the next
+		if( minX == e.minX && minY == e.minY && maxX == e.maxX && maxY == e.maxY )
+			return;
 
-				DrawCircle( obj.pos, obj.radius, cBlue );
+		RemoveFromSpatialCells( obj.GetId(), e );
 
-				DrawLine( { obj.pos.x - 20,  obj.pos.y - 20 }, { obj.pos.x + 20, obj.pos.y + 20 }, cWhite );
-				DrawLine( { obj.pos.x + 20, obj.pos.y - 20 }, { obj.pos.x - 20, obj.pos.y + 20 }, cWhite );
+		e.minX = minX; e.minY = minY;
+		e.maxX = maxX; e.maxY = maxY;
 
-				s = pblt.GetSpriteName( obj.spriteId ) + " f[" + std::to_string( obj.frame % pblt.GetSpriteFrames( obj.spriteId ) ) + "]";
-				DrawDebugText( { ( p0.x + p1.x ) / 2.0f, p0.y - 20 }, s.c_str() );
-			}
-#endif
+		for( int y = minY; y <= maxY; y++ )
+		{
+			for( int x = minX; x <= maxX; x++ )
+				GetContextState().spatialGrid.cells[SpatialCellKey( x, y )].push_back( obj.GetId() );
 		}
+	}
 
-		PlayWindow::Instance().Present();
-		frameCount++;
+	// Not exposed externally
+	void RemoveFromSpatialIndex( int id )
+	{
+		std::unordered_map<int, SpatialGrid::Entry>::iterator e = GetContextState().spatialGrid.entries.find( id );
+		if( e == GetContextState().spatialGrid.entries.end() )
+			return;
 
-		drawSpace = originalDrawSpace;
+		RemoveFromSpatialCells( id, e->second );
+		GetContextState().spatialGrid.entries.erase( e );
 	}
 
-	Point2D GetMousePos()
+	void SetSpatialIndexCellSize( float cellSize )
 	{
-		PlayInput& input = PlayInput::Instance();
-		return input.GetMousePos();
+		PLAY_ASSERT_MSG( cellSize > 0.0f, "Invalid spatial index cell size" );
+		GetContextState().spatialGrid.cellSize = cellSize;
+
+		// Every object needs to be re-inserted using the new cells
+		GetContextState().spatialGrid.cells.clear();
+		GetContextState().spatialGrid.entries.clear();
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+			UpdateSpatialIndex( i.second );
 	}
 
-	bool GetMouseButton( Align button )
+	// Not exposed externally
+	// > Calls visit( obj ) once for each object of the given type in the cells overlapping the rectangle
+	template< typename Visitor > void VisitSpatialCells( Point2D topLeft, Point2D bottomRight, int type, Visitor visit )
 	{
-		PlayInput& input = PlayInput::Instance();
-		return input.GetMouseDown( static_cast<PlayInput::MouseButton>(button));
-	}
+		unsigned int stamp = ++GetContextState().spatialGrid.queryStamp;
 
-	//**************************************************************************************************
-	// PlaySpeaker functions
-	//**************************************************************************************************
+		int minX = SpatialCellCoord( topLeft.x );
+		int minY = SpatialCellCoord( topLeft.y );
+		int maxX = SpatialCellCoord( bottomRight.x );
+		int maxY = SpatialCellCoord( bottomRight.y );
 
-	void PlayAudio( const char* fileName )
-	{
-		PlayAudio::Instance().StartAudio( fileName, false );
+		for( int y = minY; y <= maxY; y++ )
+		{
+			for( int x = minX; x <= maxX; x++ )
+			{
+				std::unordered_map<long long, std::vector<int>>::iterator cell = GetContextState().spatialGrid.cells.find( SpatialCellKey( x, y ) );
+				if( cell == GetContextState().spatialGrid.cells.end() )
+					continue;
+
+				for( int id : cell->second )
+				{
+					SpatialGrid::Entry& e = GetContextState().spatialGrid.entries[id];
+					if( e.queryStamp == stamp )
+						continue;
+					e.queryStamp = stamp;
+
+					GameObject& obj = GetGameObject( id );
+					if( type == -1 || obj.type == type )
+						visit( obj );
+				}
+			}
+		}
 	}
 
-	void StartAudioLoop( const char* fileName )
+	int CreateGameObject( int type, Point2f newPos, int collisionRadius, const char* spriteName )
 	{
-		PlayAudio::Instance().StartAudio( fileName, true );
+		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
+		// Deletion is handled in DestroyGameObject()
+		GameObject* pObj = new GameObject( type, newPos, collisionRadius, spriteId );
+		int id = pObj->GetId();
+		GetContextState().objectMap.insert( std::map<int, GameObject&>::value_type( id, *pObj ) );
+		UpdateSpatialIndex( *pObj );
+		return id;
 	}
 
-	void StopAudioLoop( const char* fileName )
+	GameObject& GetGameObject( int ID )
 	{
-		PlayAudio::Instance().StopAudio( fileName );
-	}
+		std::map<int, GameObject&>::iterator i = GetContextState().objectMap.find( ID );
 
-	//**************************************************************************************************
-	// Camera functions
-	//**************************************************************************************************
+		if( i == GetContextState().objectMap.end() )
+			return NoObject();
 
-	void SetCameraPosition( Point2f pos ) { cameraPos = pos; }
+		return i->second;
+	}
 
-	Point2f GetCameraPosition( void ) { return cameraPos; }
+	GameObject& GetGameObjectByType( int type )
+	{
+		int count = 0;
 
-	void SetDrawingSpace( DrawingSpace space ) { drawSpace = space;	}
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+			if( i.second.type == type ) { count++; }
 
-	DrawingSpace GetDrawingSpace( void ) { return drawSpace; }
+		PLAY_ASSERT_MSG( count <= 1, "Multiple objects of type found, use CollectGameObjectIDsByType instead" );
 
-	//**************************************************************************************************
-	// PlayGraphics functions
-	//**************************************************************************************************
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+		{
+			if( i.second.type == type )
+				return i.second;
+		}
 
-	int GetSpriteId( const char* spriteName )
-	{
-		return PlayGraphics::Instance().GetSpriteId( spriteName );
+		return NoObject();
 	}
 
-	int GetSpriteHeight( const char* spriteName )
+	std::vector<int> CollectGameObjectIDsByType( int type )
 	{
-		return static_cast<int>(PlayGraphics::Instance().GetSpriteSize( GetSpriteId( spriteName ) ).height);
+		std::vector<int> vec;
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+		{
+			if( i.second.type == type )
+				vec.push_back( i.first );
+		}
+		return vec; // Returning a copy of the vector
 	}
 
-	int GetSpriteWidth( const char* spriteName )
+	std::vector<int> CollectAllGameObjectIDs()
 	{
-		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( GetSpriteId( spriteName ) ).width );
-	}
+		std::vector<int> vec;
 
-	int GetSpriteHeight( int spriteId )
-	{
-		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( spriteId ).height );
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+			vec.push_back( i.first );
+
+		return vec; // Returning a copy of the vector
 	}
 
-	int GetSpriteWidth( int spriteId )
+	// Not exposed externally
+	void WrapGameObject( GameObject& obj, int wrapBorderSize, int dWidth, int dHeight )
 	{
-		return static_cast<int>( PlayGraphics::Instance().GetSpriteSize( spriteId ).width );
+		Vector2f origin = PlayGraphics::Instance().GetSpriteOrigin( obj.spriteId );
+
+		if( obj.pos.x - origin.x - wrapBorderSize > dWidth )
+			obj.pos.x = 0.0f - wrapBorderSize + origin.x;
+		else if( obj.pos.x + origin.x + wrapBorderSize < 0 )
+			obj.pos.x = dWidth + wrapBorderSize - origin.x;
+
+		if( obj.pos.y - origin.y - wrapBorderSize > dHeight )
+			obj.pos.y = 0.0f - wrapBorderSize + origin.y;
+		else if( obj.pos.y + origin.y + wrapBorderSize < 0 )
+			obj.pos.y = dHeight + wrapBorderSize - origin.y;
 	}
 
-	Point2D GetSpriteOrigin( const char* spriteName )
+	// The number of fixed point units in one pixel (16.16)
+	constexpr float FIXED_POINT_ONE = 65536.0f;
+
+	// Not exposed externally
+	// > Scaling by a power of two is exact and the conversion is correctly rounded, so the result only depends on the input
+	int64_t ToFixedPoint( float f )
 	{
-		return PlayGraphics::Instance().GetSpriteOrigin( GetSpriteId( spriteName ) );
+		return std::llrint( f * FIXED_POINT_ONE );
 	}
 
-	Point2D GetSpriteOrigin( int spriteId )
+	// Not exposed externally
+	// > Gets the exact value, unless the game has changed the float since it was last rounded from it
+	int64_t& GetFixedPoint( FixedPointValue& value, float f )
 	{
-		return PlayGraphics::Instance().GetSpriteOrigin( spriteId );
+		if( f != value.asFloat )
+			value.fixed = ToFixedPoint( f );
+		return value.fixed;
 	}
 
-	const char* GetSpriteName( int spriteId )
+	// Not exposed externally
+	// > Rounds the exact value to the float the game sees
+	float SetFixedPoint( FixedPointValue& value, int64_t fixed )
 	{
-		return PlayGraphics::Instance().GetSpriteName( spriteId ).c_str();
+		value.fixed = fixed;
+		value.asFloat = static_cast<float>( static_cast<double>( fixed ) / FIXED_POINT_ONE );
+		return value.asFloat;
 	}
 
-	const PixelData* GetSpritePixelData( int spriteId )
+	// Not exposed externally
+	// > The same simple physical model as UpdateGameObject, but carried on from the exact fixed point state with every addition done on integers
+	void IntegrateGameObjectFixed( GameObject& obj )
 	{
-		return PlayGraphics::Instance().GetSpritePixelData( spriteId );
+		int64_t velX = GetFixedPoint( obj.fixedVelocity[0], obj.velocity.x ) + ToFixedPoint( obj.acceleration.x );
+		int64_t velY = GetFixedPoint( obj.fixedVelocity[1], obj.velocity.y ) + ToFixedPoint( obj.acceleration.y );
+		int64_t posX = GetFixedPoint( obj.fixedPos[0], obj.pos.x ) + velX;
+		int64_t posY = GetFixedPoint( obj.fixedPos[1], obj.pos.y ) + velY;
+		int64_t rotation = GetFixedPoint( obj.fixedRotation, obj.rotation ) + ToFixedPoint( obj.rotSpeed );
+		int64_t framePos = GetFixedPoint( obj.fixedFramePos, obj.framePos ) + ToFixedPoint( obj.animSpeed );
+
+		if( framePos > ToFixedPoint( 1.0f ) )
+		{
+			obj.frame++;
+			framePos -= ToFixedPoint( 1.0f );
+		}
+
+		obj.velocity = { SetFixedPoint( obj.fixedVelocity[0], velX ), SetFixedPoint( obj.fixedVelocity[1], velY ) };
+		obj.pos = { SetFixedPoint( obj.fixedPos[0], posX ), SetFixedPoint( obj.fixedPos[1], posY ) };
+		obj.rotation = SetFixedPoint( obj.fixedRotation, rotation );
+		obj.framePos = SetFixedPoint( obj.fixedFramePos, framePos );
 	}
 
-	int GetSpriteFrames( int spriteId )
+	void SetFixedPointPhysics( bool enabled )
 	{
-		return static_cast<int>( PlayGraphics::Instance().GetSpriteFrames( spriteId ) );
+		GetContextState().bFixedPointPhysics = enabled;
 	}
 
-	void ColourSprite( const char* spriteName, Colour c )
+	bool GetFixedPointPhysics()
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
-		PlayGraphics::Instance().ColourSprite( spriteId, static_cast<int>( c.red * 2.55f ), static_cast<int>( c.green * 2.55f), static_cast<int>( c.blue * 2.55f ) );
+		return GetContextState().bFixedPointPhysics;
 	}
 
-	void CentreSpriteOrigin( const char* spriteName )
+	void MoveAllGameObjects( Vector2D offset )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		int spriteId = pblt.GetSpriteId( spriteName );
-		pblt.SetSpriteOrigin( spriteId, pblt.GetSpriteSize( spriteId ) / 2, false );
+		int64_t offsetX = ToFixedPoint( offset.x );
+		int64_t offsetY = ToFixedPoint( offset.y );
+
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+		{
+			GameObject& obj = i.second;
+			if( GetContextState().bFixedPointPhysics )
+				obj.pos = { SetFixedPoint( obj.fixedPos[0], GetFixedPoint( obj.fixedPos[0], obj.pos.x ) + offsetX ), SetFixedPoint( obj.fixedPos[1], GetFixedPoint( obj.fixedPos[1], obj.pos.y ) + offsetY ) };
+			else
+				obj.pos += offset;
+
+			obj.oldPos += offset;
+			UpdateSpatialIndex( obj );
+		}
 	}
 
-	void CentreMatchingSpriteOrigins( const char* rootName )
+	void UpdateGameObject( GameObject& obj, bool bWrap, int wrapBorderSize, bool allowMultipleUpdatesPerFrame )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		int spriteId = pblt.GetSpriteId( rootName ); // Finds the first matching sprite and assumes same dimensions
-		pblt.SetSpriteOrigins( rootName, pblt.GetSpriteSize( spriteId ) / 2, false );
+		if( obj.type == -1 ) return; // Don't update noObject
+
+		// We allow multiple updates if the object type has changed
+		PLAY_ASSERT_MSG( obj.lastFrameUpdated != GetContextState().frameCount || obj.type != obj.oldType || allowMultipleUpdatesPerFrame, "Trying to update the same GameObject more than once in the same frame!" );
+		obj.lastFrameUpdated = GetContextState().frameCount;
+
+		// Save the current position in case we need to go back
+		obj.oldPos = obj.pos;
+		obj.oldRot = obj.rotation;
+
+		if( GetContextState().bFixedPointPhysics )
+		{
+			IntegrateGameObjectFixed( obj );
+		}
+		else
+		{
+			// Move the object according to a very simple physical model
+			obj.velocity += obj.acceleration;
+			obj.pos += obj.velocity;
+			obj.rotation += obj.rotSpeed;
+
+			// Handle the animation frame update
+			obj.framePos += obj.animSpeed;
+			if( obj.framePos > 1.0f )
+			{
+				obj.frame++;
+				obj.framePos -= 1.0f;
+			}
+		}
+
+		// Wrap objects around the screen
+		if( bWrap )
+			WrapGameObject( obj, wrapBorderSize, PlayWindow::Instance().GetWidth(), PlayWindow::Instance().GetHeight() );
+
+		UpdateSpatialIndex( obj );
 	}
 
-	void CentreAllSpriteOrigins()
+	static_assert( sizeof( Vector2D ) == 2 * sizeof( float ), "UpdateAllGameObjects loads the store's vectors as packed floats" );
+
+	// Not exposed externally
+	// > Integrates slots [begin, end) of a block, where begin and end are multiples of four, reading and writing the store directly
+	// > Only touches the slots in its own range, so separate ranges can safely be updated on different threads
+	void IntegrateGameObjectBlock( GameObjectBlock& b, int begin, int end, int frameCount )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
+		const __m128 one = _mm_set1_ps( 1.0f );
+		const __m128i frameCount4 = _mm_set1_epi32( frameCount );
 
-		for( int i = 0; i < pblt.GetTotalLoadedSprites(); i++ )
-			pblt.SetSpriteOrigin( i, pblt.GetSpriteSize( i ) / 2, false );
+		for( int i = begin; i < end; i += 4 )
+		{
+			// Objects already updated this frame are rare, so they are only checked one at a time once the four lanes have been compared together
+			__m128i* pLastFrameUpdated = reinterpret_cast<__m128i*>( &b.lastFrameUpdated[i] );
+			if( _mm_movemask_epi8( _mm_cmpeq_epi32( _mm_loadu_si128( pLastFrameUpdated ), frameCount4 ) ) )
+			{
+				for( int n = i; n < i + 4; n++ )
+				{
+					GameObject* pObj = b.owners[n];
+					PLAY_ASSERT_MSG( !pObj || b.lastFrameUpdated[n] != frameCount || pObj->type != pObj->oldType, "Trying to update the same GameObject more than once in the same frame!" );
+				}
+			}
+			_mm_storeu_si128( pLastFrameUpdated, frameCount4 );
+
+			// Each Vector2D is two floats, so the vectors are handled two objects per register
+			float* pPos = &b.pos[i].x;
+			float* pOldPos = &b.oldPos[i].x;
+			float* pVelocity = &b.velocity[i].x;
+			const float* pAcceleration = &b.acceleration[i].x;
+			for( int half = 0; half < 8; half += 4 )
+			{
+				// Save the current positions in case we need to go back
+				__m128 pos = _mm_loadu_ps( pPos + half );
+				_mm_storeu_ps( pOldPos + half, pos );
+
+				// Move the objects according to the same simple physical model as UpdateGameObject (and in the same order so the results are identical)
+				__m128 velocity = _mm_add_ps( _mm_loadu_ps( pVelocity + half ), _mm_loadu_ps( pAcceleration + half ) );
+				_mm_storeu_ps( pVelocity + half, velocity );
+				_mm_storeu_ps( pPos + half, _mm_add_ps( pos, velocity ) );
+			}
+
+			__m128 rotation = _mm_loadu_ps( &b.rotation[i] );
+			_mm_storeu_ps( &b.oldRot[i], rotation );
+			_mm_storeu_ps( &b.rotation[i], _mm_add_ps( rotation, _mm_loadu_ps( &b.rotSpeed[i] ) ) );
+
+			// Advance the animation: the comparison mask is all ones (-1) where the frame moves on, so subtracting it increments the frame
+			__m128 framePos = _mm_add_ps( _mm_loadu_ps( &b.framePos[i] ), _mm_loadu_ps( &b.animSpeed[i] ) );
+			__m128 advance = _mm_cmpgt_ps( framePos, one );
+			framePos = _mm_sub_ps( framePos, _mm_and_ps( advance, one ) ); // x - 0.0f == x, so untouched lanes are unchanged
+			_mm_storeu_ps( &b.framePos[i], framePos );
+
+			__m128i frame = _mm_loadu_si128( reinterpret_cast<const __m128i*>( &b.frame[i] ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( &b.frame[i] ), _mm_sub_epi32( frame, _mm_castps_si128( advance ) ) );
+		}
 	}
 
-	void MoveSpriteOrigin( const char* spriteName, int xOffset, int yOffset )
+	// Not exposed externally
+	// > Integrates the objects in slots [begin, end) of a block in fixed point, one at a time exactly as UpdateGameObject does it
+	// > Fixed point is integer maths with nothing for the SIMD path to gain
+	void IntegrateGameObjectBlockFixed( GameObjectBlock& b, int begin, int end, int frameCount )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		int spriteId = pblt.GetSpriteId( spriteName );
-		pblt.SetSpriteOrigin( spriteId, { xOffset, yOffset }, true ); // relative option set
+		for( int i = begin; i < end; i++ )
+		{
+			GameObject* pObj = b.owners[i];
+			if( !pObj )
+				continue;
+
+			PLAY_ASSERT_MSG( pObj->lastFrameUpdated != frameCount || pObj->type != pObj->oldType, "Trying to update the same GameObject more than once in the same frame!" );
+			pObj->lastFrameUpdated = frameCount;
+
+			// Save the current position in case we need to go back
+			pObj->oldPos = pObj->pos;
+			pObj->oldRot = pObj->rotation;
+
+			IntegrateGameObjectFixed( *pObj );
+		}
 	}
 
-	void MoveMatchingSpriteOrigins( const char* rootName, int xoffset, int yoffset )
+	// Not exposed externally
+	// > Integrates the store's slots [begin, end), where begin and end are multiples of four
+	void IntegrateGameObjectSlots( GameObjectStore& store, int begin, int end, int frameCount, bool bFixedPoint )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		pblt.SetSpriteOrigins( rootName, { xoffset, yoffset }, true ); // relative option set
+		while( begin < end )
+		{
+			GameObjectBlock& b = *store.blocks[begin / GAMEOBJECT_BLOCK_SIZE];
+			int blockStart = begin - begin % GAMEOBJECT_BLOCK_SIZE;
+			int blockEnd = std::min( end - blockStart, GAMEOBJECT_BLOCK_SIZE );
+
+			if( bFixedPoint )
+				IntegrateGameObjectBlockFixed( b, begin - blockStart, blockEnd, frameCount );
+			else
+				IntegrateGameObjectBlock( b, begin - blockStart, blockEnd, frameCount );
+
+			begin = blockStart + blockEnd;
+		}
 	}
 
-	void MoveAllSpriteOrigins()
+	// The smallest number of objects worth handing to another thread
+	constexpr size_t UPDATE_MIN_CHUNK_SIZE = 1024;
+
+	void SetUpdateThreadCount( int threadCount )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
+		PLAY_ASSERT_MSG( threadCount >= 0, "Invalid number of update threads" );
 
-		for( int i = 0; i < pblt.GetTotalLoadedSprites(); i++ )
-			pblt.SetSpriteOrigin( i, pblt.GetSpriteSize( i ) / 2, true );
+		delete GetContextState().pUpdateThreadPool;
+		GetContextState().pUpdateThreadPool = nullptr;
+
+		if( threadCount == 0 )
+			threadCount = static_cast<int>( std::thread::hardware_concurrency() );
+
+		// The game thread counts as one of the threads
+		if( threadCount > 1 )
+			GetContextState().pUpdateThreadPool = new PlayThreadPool( threadCount - 1 );
 	}
 
-	void SetSpriteOrigin( int spriteId, int xOrigin, int yOrigin )
+	int GetUpdateThreadCount()
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		pblt.SetSpriteOrigin( spriteId, { xOrigin, yOrigin } );
+		return GetContextState().pUpdateThreadPool ? GetContextState().pUpdateThreadPool->GetWorkerCount() + 1 : 1;
 	}
 
-	void SetSpriteOrigin( const char* spriteName, int xOrigin, int yOrigin )
+	void UpdateAllGameObjects( bool bWrap, int wrapBorderSize )
 	{
-		PlayGraphics& pblt = PlayGraphics::Instance();
-		int spriteId = pblt.GetSpriteId( spriteName );
-		pblt.SetSpriteOrigin( spriteId, { xOrigin, yOrigin } ); 
+		// The free slots and the padding after the last one hold default values, so they are integrated along with the rest without changing anything
+		GameObjectStore& store = GetContextState().objectStore;
+		int slotCount = ( store.slotCount + 3 ) & ~3;
+		int frameCount = GetContextState().frameCount;
+		bool bFixedPoint = GetContextState().bFixedPointPhysics;
+
+		if( GetContextState().pUpdateThreadPool )
+		{
+			// Split the slots into chunks of whole SIMD lanes and wait for them all before carrying on (so collisions and drawing see the results)
+			// > Everything the workers need is passed in, so they don't use the context at all
+			size_t lanes = slotCount / 4;
+			GetContextState().pUpdateThreadPool->ParallelFor( lanes, UPDATE_MIN_CHUNK_SIZE / 4, [&]( size_t beginLane, size_t endLane )
+			{
+				IntegrateGameObjectSlots( store, static_cast<int>( beginLane * 4 ), static_cast<int>( endLane * 4 ), frameCount, bFixedPoint );
+			} );
+		}
+		else
+		{
+			IntegrateGameObjectSlots( store, 0, slotCount, frameCount, bFixedPoint );
+		}
+
+		// Wrapping and the spatial index are done in id order on the game thread (the spatial index is shared)
+		int dWidth = bWrap ? PlayWindow::Instance().GetWidth() : 0;
+		int dHeight = bWrap ? PlayWindow::Instance().GetHeight() : 0;
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+		{
+			if( bWrap )
+				WrapGameObject( i.second, wrapBorderSize, dWidth, dHeight );
+
+			UpdateSpatialIndex( i.second );
+		}
 	}
 
-	void DrawSprite( const char* spriteName, Point2D pos, int frameIndex )
+	void DestroyGameObject( int ID )
 	{
-		PlayGraphics::Instance().Draw( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex );
+		if( GetContextState().objectMap.find( ID ) == GetContextState().objectMap.end() )
+		{
+			PLAY_ASSERT_MSG( false, "Unable to find object with given ID" );
+		}
+		else
+		{
+			GameObject* go = &GetContextState().objectMap.find( ID )->second;
+			RemoveFromSpatialIndex( ID );
+			delete go;
+			GetContextState().objectMap.erase( ID );
+		}
 	}
 
-	void DrawSprite( int spriteID, Point2D pos, int frameIndex )
+	void DestroyGameObjectsByType( int objType )
 	{
-		PlayGraphics::Instance().Draw( spriteID, TRANSFORM_SPACE( pos ), frameIndex );
+		std::vector<int> typeVec = CollectGameObjectIDsByType( objType );
+		for( size_t i = 0; i < typeVec.size(); i++ )
+			DestroyGameObject( typeVec[i] );
 	}
 
-	void DrawSpriteTransparent( const char* spriteName, Point2D pos, int frameIndex, float opacity )
+	bool IsColliding( GameObject& object1, GameObject& object2 )
 	{
-		PlayGraphics::Instance().DrawTransparent( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex, opacity );
+		//Don't collide with noObject
+		if( object1.type == -1 || object2.type == -1 )
+			return false;
+
+		int xDiff = int( object1.pos.x ) - int( object2.pos.x );
+		int yDiff = int( object1.pos.y ) - int( object2.pos.y );
+		int radii = object2.radius + object1.radius;
+
+		// Game progammers don't do square root!
+		return( ( xDiff * xDiff ) + ( yDiff * yDiff ) < radii * radii );
 	}
 
-	void DrawSpriteTransparent( int spriteID, Point2D pos, int frameIndex, float opacity )
+	std::vector<int> QueryCircle( Point2D pos, float radius, int type )
 	{
-		PlayGraphics::Instance().DrawTransparent( spriteID, TRANSFORM_SPACE( pos ), frameIndex, opacity );
-	}
+		std::vector<int> vec;
 
-	void DrawSpriteRotated( const char* spriteName, Point2D pos, int frameIndex, float angle, float scale, float opacity )
-	{
-		PlayGraphics::Instance().DrawRotated( PlayGraphics::Instance().GetSpriteId( spriteName ), TRANSFORM_SPACE( pos ), frameIndex, angle, scale, opacity );
-	}
+		VisitSpatialCells( { pos.x - radius, pos.y - radius }, { pos.x + radius, pos.y + radius }, type, [&]( GameObject& obj )
+		{
+			float radii = radius + obj.radius;
+			if( lengthSqr( obj.pos - pos ) < radii * radii )
+				vec.push_back( obj.GetId() );
+		} );
 
-	void DrawSpriteRotated( int spriteID, Point2D pos, int frameIndex, float angle, float scale, float opacity )
-	{
-		PlayGraphics::Instance().DrawRotated( spriteID, TRANSFORM_SPACE( pos ), frameIndex, angle, scale, opacity );
+		// Same order as CollectGameObjectIDsByType
+		std::sort( vec.begin(), vec.end() );
+		return vec; // Returning a copy of the vector
 	}
 
-	void DrawSpriteTransformed( int spriteID, const Matrix2D& transform, int frameIndex, float opacity  )
+	std::vector<int> QueryAABB( Point2D topLeft, Point2D bottomRight, int type )
 	{
-		PlayGraphics::Instance().DrawTransformed( spriteID, TRANSFORM_MATRIX_SPACE( transform ), frameIndex, opacity );
-	}
+		std::vector<int> vec;
 
-	void DrawLine( Point2f start, Point2f end, Colour c )
-	{
-		return PlayGraphics::Instance().DrawLine( TRANSFORM_SPACE( start ), TRANSFORM_SPACE( end ), { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }  );
+		VisitSpatialCells( topLeft, bottomRight, type, [&]( GameObject& obj )
+		{
+			// Distance from the centre of the circle to the nearest point in the rectangle
+			float dx = obj.pos.x - std::clamp( obj.pos.x, topLeft.x, bottomRight.x );
+			float dy = obj.pos.y - std::clamp( obj.pos.y, topLeft.y, bottomRight.y );
+			if( ( dx * dx ) + ( dy * dy ) <= static_cast<float>( obj.radius * obj.radius ) )
+				vec.push_back( obj.GetId() );
+		} );
+
+		// Same order as CollectGameObjectIDsByType
+		std::sort( vec.begin(), vec.end() );
+		return vec; // Returning a copy of the vector
 	}
 
-	void DrawCircle( Point2D pos, int radius, Colour c )
+	std::vector<std::pair<int, int>> CollectCollidingPairs( int typeA, int typeB )
 	{
-		PlayGraphics::Instance().DrawCircle( TRANSFORM_SPACE( pos ), radius, { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f } );
-	}
+		std::vector<std::pair<int, int>> vec;
 
-	void DrawRect( Point2D topLeft, Point2D bottomRight, Colour c, bool fill )
-	{
-		PlayGraphics::Instance().DrawRect( TRANSFORM_SPACE( topLeft ), TRANSFORM_SPACE( bottomRight ), { c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f }, fill );
+		for( int idA : CollectGameObjectIDsByType( typeA ) )
+		{
+			GameObject& objA = GetGameObject( idA );
+			float r = static_cast<float>( objA.radius );
+
+			// The neighbours only need to come from the cells around this object
+			VisitSpatialCells( { objA.pos.x - r, objA.pos.y - r }, { objA.pos.x + r, objA.pos.y + r }, typeB, [&]( GameObject& objB )
+			{
+				// Report pairs of the same type only once
+				if( typeA == typeB && objB.GetId() <= idA )
+					return;
+
+				if( IsColliding( objA, objB ) )
+					vec.push_back( { idA, objB.GetId() } );
+			} );
+		}
+
+		std::sort( vec.begin(), vec.end() );
+		return vec; // Returning a copy of the vector
 	}
 
-	void DrawSpriteLine( Point2f startPos, Point2f endPos, const char* penSprite, Colour c )
+	bool SweepAABB( Point2D pos, Vector2D halfSize, Vector2D move, Point2D otherPos, Vector2D otherHalfSize, SweepHit& hit )
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
-		ColourSprite( penSprite, c );
-
-		//Draws a line in any angle
-		int x1 = static_cast<int>( startPos.x );
-		int y1 = static_cast<int>( startPos.y );
-		int x2 = static_cast<int>( endPos.x );
-		int y2 = static_cast<int>( endPos.y );
+		// Growing the other box by our size lets us treat our box as a single point moving along a line
+		Vector2D ext = halfSize + otherHalfSize;
+		Vector2D d = pos - otherPos;
 
-		//Implementation of Bresenham's Line Drawing Algorithm
-		int dx = abs( x2 - x1 );
-		int sx = 1;
-		if( x2 < x1 ) { sx = -1; }
+		if( fabs( d.x ) < ext.x && fabs( d.y ) < ext.y )
+		{
+			// Already overlapping, so push out along whichever side is closest
+			Vector2D normal = ( ext.x - fabs( d.x ) < ext.y - fabs( d.y ) ) ? Vector2D( d.x < 0.0f ? -1.0f : 1.0f, 0.0f ) : Vector2D( 0.0f, d.y < 0.0f ? -1.0f : 1.0f );
+			if( dot( move, normal ) >= 0.0f )
+				return false;
 
-		int dy = -abs( y2 - y1 );
-		int sy = 1;
-		if( y2 < y1 ) { sy = -1; }
-		
-		int err = dx + dy;
+			hit.time = 0.0f;
+			hit.normal = normal;
+			hit.pos = pos;
+			return true;
+		}
 
-		if( dx == 0 && dy == 0 ) return;
+		// Find the range of times the point is between each pair of sides
+		float tEnter = -FLT_MAX;
+		float tExit = FLT_MAX;
+		Vector2D normal{ 0.0f, 0.0f };
 
-		while( true )
+		auto Slab = [&]( float dist, float speed, float extent, Vector2D axis ) -> bool
 		{
-			Play::DrawSprite( spriteId, { x1, y1 }, 0 );
-			
-			if( x1 == x2 && y1 == y2 )
-				break;
+			if( speed == 0.0f )
+				return fabs( dist ) < extent;
 
-			int e2 = 2 * err;
-			if( e2 >= dy )
+			float t1 = ( -extent - dist ) / speed;
+			float t2 = ( extent - dist ) / speed;
+			if( std::min( t1, t2 ) > tEnter )
 			{
-				err += dy;
-				x1 += sx;
-			}
-			if( e2 <= dx )
-			{
-				err += dx;
-				y1 += sy;
+				tEnter = std::min( t1, t2 );
+				normal = speed > 0.0f ? -axis : axis;
 			}
-		}
-	}
+			tExit = std::min( tExit, std::max( t1, t2 ) );
+			return true;
+		};
 
-	// Not exposed externally
-	void DrawCircleOctants( int spriteId, int x, int y, int ox, int oy )
-	{
-		//displaying all 8 coordinates of(x,y) residing in 8-octants
-		Play::DrawSprite( spriteId, { x + ox, y + oy }, 0 );
-		Play::DrawSprite( spriteId, { x - ox, y + oy }, 0 );
-		Play::DrawSprite( spriteId, { x + ox, y - oy }, 0 );
-		Play::DrawSprite( spriteId, { x - ox, y - oy }, 0 );
-		Play::DrawSprite( spriteId, { x + oy, y + ox }, 0 );
-		Play::DrawSprite( spriteId, { x - oy, y + ox }, 0 );
-		Play::DrawSprite( spriteId, { x + oy, y - ox }, 0 );
-		Play::DrawSprite( spriteId, { x - oy, y - ox }, 0 );
+		if( !Slab( d.x, move.x, ext.x, { 1.0f, 0.0f } ) || !Slab( d.y, move.y, ext.y, { 0.0f, 1.0f } ) )
+			return false;
+
+		// Only just touching the corner doesn't count
+		if( tEnter >= tExit || tEnter < 0.0f || tEnter > 1.0f )
+			return false;
+
+		hit.time = tEnter;
+		hit.normal = normal;
+		hit.pos = pos + ( move * tEnter );
+		return true;
 	}
 
-	void DrawSpriteCircle( Point2D pos, int radius, const char* penSprite, Colour c )
+	bool SweepCircle( Point2D pos, float radius, Vector2D move, Point2D otherPos, float otherRadius, SweepHit& hit )
 	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( penSprite );
-		ColourSprite( penSprite, c );
+		float radii = radius + otherRadius;
+		Vector2D d = pos - otherPos;
 
-		pos = TRANSFORM_SPACE( pos );
+		if( lengthSqr( d ) < radii * radii )
+		{
+			// Already overlapping, so push out directly away from the other centre
+			// > Concentric circles have no direction to push out in, so they push back along the move (and don't hit when not moving)
+			if( lengthSqr( d ) == 0.0f && lengthSqr( move ) == 0.0f )
+				return false;
 
-		int ox = 0, oy = radius;
-		int d = 3 - 2 * radius;
-		DrawCircleOctants( spriteId, static_cast<int>(pos.x), static_cast<int>(pos.y), ox, oy );
+			Vector2D normal = lengthSqr( d ) > 0.0f ? normalize( d ) : -normalize( move );
+			if( dot( move, normal ) >= 0.0f )
+				return false;
 
-		while( oy >= ox )
-		{
-			ox++;
-			if( d > 0 )
-			{
-				oy--;
-				d = d + 4 * ( ox - oy ) + 10;
-			}
-			else
-			{
-				d = d + 4 * ox + 6;
-			}
-			DrawCircleOctants( spriteId, static_cast<int>(pos.x), static_cast<int>(pos.y), ox, oy );
+			hit.time = 0.0f;
+			hit.normal = normal;
+			hit.pos = pos;
+			return true;
 		}
-	};
 
-	void DrawFontText( const char* fontId, std::string text, Point2D pos, Align justify )
+		// Solve |d + move * t| = radii for the first t
+		float a = dot( move, move );
+		float b = dot( d, move );
+		float c = dot( d, d ) - ( radii * radii );
+		float discriminant = ( b * b ) - ( a * c );
+		if( a == 0.0f || discriminant < 0.0f )
+			return false;
+
+		float t = ( -b - sqrt( discriminant ) ) / a;
+		if( t < 0.0f || t > 1.0f )
+			return false;
+
+		hit.time = t;
+		hit.normal = normalize( d + ( move * t ) );
+		hit.pos = pos + ( move * t );
+		return true;
+	}
+
+	bool SweepCircleAABB( Point2D pos, float radius, Vector2D move, Point2D boxPos, Vector2D boxHalfSize, SweepHit& hit )
 	{
-		int font = PlayGraphics::Instance().GetSpriteId( fontId );
+		Vector2D d = pos - boxPos;
+		Vector2D nearest{ std::clamp( d.x, -boxHalfSize.x, boxHalfSize.x ), std::clamp( d.y, -boxHalfSize.y, boxHalfSize.y ) };
 
-		int totalWidth{ 0 };
+		if( lengthSqr( d - nearest ) < radius * radius )
+		{
+			// Already overlapping, so push out away from the nearest point on the box
+			if( lengthSqr( d - nearest ) > 0.0f )
+			{
+				Vector2D normal = normalize( d - nearest );
+				if( dot( move, normal ) >= 0.0f )
+					return false;
 
-		for( char c : text )
-			totalWidth += PlayGraphics::Instance().GetFontCharWidth( font, c );
+				hit.time = 0.0f;
+				hit.normal = normal;
+				hit.pos = pos;
+				return true;
+			}
 
-		switch( justify )
+			// The centre is inside the box, which behaves the same as a box of the circle's size
+			return SweepAABB( pos, { radius, radius }, move, boxPos, boxHalfSize, hit );
+		}
+
+		// Sweep against the box grown by the radius first, which is exact except at the rounded corners
+		SweepHit boxHit;
+		bool bBoxHit = SweepAABB( pos, { radius, radius }, move, boxPos, boxHalfSize, boxHit );
+		Vector2D contact = bBoxHit ? boxHit.pos - boxPos : d;
+
+		if( fabs( contact.x ) <= boxHalfSize.x || fabs( contact.y ) <= boxHalfSize.y )
 		{
-			case CENTRE:
-				pos.x -= totalWidth / 2;
-				break;
-			case RIGHT:
-				pos.x -= totalWidth;
-				break;
-			default:
-				break;
+			if( bBoxHit )
+				hit = boxHit;
+			return bBoxHit;
 		}
 
-		pos.x += PlayGraphics::Instance().GetSpriteOrigin( font ).x;
-		PlayGraphics::Instance().DrawString( font, TRANSFORM_SPACE( pos ), text );
+		// The contact is in one of the rounded corners, so the circle can only hit that corner point
+		Vector2D corner{ contact.x < 0.0f ? -boxHalfSize.x : boxHalfSize.x, contact.y < 0.0f ? -boxHalfSize.y : boxHalfSize.y };
+		return SweepCircle( pos, radius, move, boxPos + corner, 0.0f, hit );
 	}
 
-	void BeginTimingBar( Colour c )
+	// Not exposed externally
+	// > Sweeps obj against other, using boxes or circles depending on whether each object's aabb is set
+	bool SweepGameObjects( GameObject& obj, Vector2D move, GameObject& other, SweepHit& hit )
 	{
-		PlayGraphics::Instance().TimingBarBegin( Pixel( c.red*2.55f, c.green*2.55f, c.blue*2.55f ) );
-	}
+		bool bBox = obj.aabb.x > 0.0f || obj.aabb.y > 0.0f;
+		bool bOtherBox = other.aabb.x > 0.0f || other.aabb.y > 0.0f;
+		float r = static_cast<float>( obj.radius );
+		float otherR = static_cast<float>( other.radius );
 
-	int ColourTimingBar( Colour c )
-	{
-		return PlayGraphics::Instance().SetTimingBarColour( Pixel( c.red * 2.55f, c.green * 2.55f, c.blue * 2.55f ) );
+		if( bBox && bOtherBox )
+			return SweepAABB( obj.pos, obj.aabb, move, other.pos, other.aabb, hit );
+
+		if( !bBox && bOtherBox )
+			return SweepCircleAABB( obj.pos, r, move, other.pos, other.aabb, hit );
+
+		if( !bBox && !bOtherBox )
+			return SweepCircle( obj.pos, r, move, other.pos, otherR, hit );
+
+		// A box hitting a circle is the same as the circle hitting the box in the opposite direction
+		if( !SweepCircleAABB( other.pos, otherR, -move, obj.pos, obj.aabb, hit ) )
+			return false;
+
+		hit.normal = -hit.normal;
+		hit.pos = obj.pos + ( move * hit.time );
+		return true;
 	}
 
-	void DrawTimingBar( Point2f pos, Point2f size )
+	std::vector<SweepHit> MoveAndCollide( GameObject& obj, const std::vector<int>& types, int maxHits, bool allowMultipleUpdatesPerFrame )
 	{
-		PlayGraphics::Instance().DrawTimingBar( pos, size );
-	}
+		std::vector<SweepHit> hits;
+		if( obj.type == -1 ) return hits; // Not for noObject
 
+		// Let UpdateGameObject do the usual update, then redo the movement a piece at a time
+		UpdateGameObject( obj, false, 0, allowMultipleUpdatesPerFrame );
+		Vector2D move = obj.pos - obj.oldPos;
+		obj.pos = obj.oldPos;
 
-	//**************************************************************************************************
-	// GameObject functions
-	//**************************************************************************************************
+		float rx = obj.aabb.x > 0.0f || obj.aabb.y > 0.0f ? obj.aabb.x : static_cast<float>( obj.radius );
+		float ry = obj.aabb.x > 0.0f || obj.aabb.y > 0.0f ? obj.aabb.y : static_cast<float>( obj.radius );
 
-#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+		while( lengthSqr( move ) > 0.0f )
+		{
+			// Only the objects in the cells covered by the whole movement can be hit
+			Point2D end = obj.pos + move;
+			Point2D topLeft{ std::min( obj.pos.x, end.x ) - rx, std::min( obj.pos.y, end.y ) - ry };
+			Point2D bottomRight{ std::max( obj.pos.x, end.x ) + rx, std::max( obj.pos.y, end.y ) + ry };
 
-	int CreateGameObject( int type, Point2f newPos, int collisionRadius, const char* spriteName )
-	{
-		int spriteId = PlayGraphics::Instance().GetSpriteId( spriteName );
-		// Deletion is handled in DestroyGameObject()
-		GameObject* pObj = new GameObject( type, newPos, collisionRadius, spriteId );
-		int id = pObj->GetId();
-		objectMap.insert( std::map<int, GameObject&>::value_type( id, *pObj ) );
-		return id;
-	}
+			SweepHit first;
+			first.time = FLT_MAX;
 
-	GameObject& GetGameObject( int ID )
-	{
-		std::map<int, GameObject&>::iterator i = objectMap.find( ID );
+			VisitSpatialCells( topLeft, bottomRight, -1, [&]( GameObject& other )
+			{
+				if( &other == &obj || std::find( types.begin(), types.end(), other.type ) == types.end() )
+					return;
 
-		if( i == objectMap.end() )
-			return noObject;
+				SweepHit hit;
+				if( !SweepGameObjects( obj, move, other, hit ) )
+					return;
 
-		return i->second;
-	}
+				// Ties go to the lowest id so the result doesn't depend on the order of the cells
+				if( hit.time < first.time || ( hit.time == first.time && other.GetId() < first.id ) )
+				{
+					first = hit;
+					first.id = other.GetId();
+				}
+			} );
 
-	GameObject& GetGameObjectByType( int type )
-	{
-		int count = 0;
+			if( first.id == -1 )
+			{
+				obj.pos = end;
+				break;
+			}
 
-		for( std::pair<const int, GameObject&>& i : objectMap )
-			if( i.second.type == type ) { count++; }
+			hits.push_back( first );
+			obj.pos = first.pos;
 
-		PLAY_ASSERT_MSG( count <= 1, "Multiple objects of type found, use CollectGameObjectIDsByType instead" );
+			// UpdateContacts reports these too, as the objects won't be overlapping by then
+			if( !GetContextState().contactList.pairs.empty() )
+			{
+				Contact c;
+				c.idA = obj.GetId();
+				c.idB = first.id;
+				c.normal = first.normal;
+				c.bSwept = true;
+				GetContextState().contactList.sweptHits.push_back( c );
+			}
 
-		for( std::pair<const int, GameObject&>& i : objectMap )
-		{
-			if( i.second.type == type )
-				return i.second;
+			// Bounce off the surface by reflecting the velocity and what's left of the movement
+			Vector2D remaining = move * ( 1.0f - first.time );
+			move = remaining - ( first.normal * ( 2.0f * dot( remaining, first.normal ) ) );
+			obj.velocity = obj.velocity - ( first.normal * ( 2.0f * dot( obj.velocity, first.normal ) ) );
+
+			// Stop dead rather than risk passing through something
+			if( static_cast<int>( hits.size() ) >= maxHits )
+				break;
 		}
 
-		return noObject;
+		UpdateSpatialIndex( obj );
+		return hits;
 	}
 
-	std::vector<int> CollectGameObjectIDsByType( int type )
+	void RegisterCollisionPair( int typeA, int typeB )
 	{
-		std::vector<int> vec;
-		for( std::pair<const int, GameObject&>& i : objectMap )
+		for( std::pair<int, int>& p : GetContextState().contactList.pairs )
 		{
-			if( i.second.type == type )
-				vec.push_back( i.first );
+			if( ( p.first == typeA && p.second == typeB ) || ( p.first == typeB && p.second == typeA ) )
+				return;
 		}
-		return vec; // Returning a copy of the vector
+
+		GetContextState().contactList.pairs.push_back( { typeA, typeB } );
 	}
 
-	std::vector<int> CollectAllGameObjectIDs()
+	// Not exposed externally
+	// > Finds how far a circle overlaps a box, with the normal pointing from the box towards the circle
+	bool OverlapCircleAABB( Point2D pos, float radius, Point2D boxPos, Vector2D boxHalfSize, Vector2D& normal, float& penetration )
 	{
-		std::vector<int> vec;
+		Vector2D d = pos - boxPos;
+		Vector2D nearest{ std::clamp( d.x, -boxHalfSize.x, boxHalfSize.x ), std::clamp( d.y, -boxHalfSize.y, boxHalfSize.y ) };
+		float distSqr = lengthSqr( d - nearest );
 
-		for( std::pair<const int, GameObject&>& i : objectMap )
-			vec.push_back( i.first );
+		if( distSqr >= radius * radius )
+			return false;
 
-		return vec; // Returning a copy of the vector
+		if( distSqr > 0.0f )
+		{
+			normal = normalize( d - nearest );
+			penetration = radius - sqrt( distSqr );
+			return true;
+		}
+
+		// The centre is inside the box, so push out through the nearest side
+		float px = boxHalfSize.x - fabs( d.x );
+		float py = boxHalfSize.y - fabs( d.y );
+		normal = px < py ? Vector2D( d.x < 0.0f ? -1.0f : 1.0f, 0.0f ) : Vector2D( 0.0f, d.y < 0.0f ? -1.0f : 1.0f );
+		penetration = std::min( px, py ) + radius;
+		return true;
 	}
 
-	void UpdateGameObject( GameObject& obj, bool bWrap, int wrapBorderSize, bool allowMultipleUpdatesPerFrame )
+	// Not exposed externally
+	// > Finds how far two objects overlap, using boxes or circles depending on whether each object's aabb is set
+	bool OverlapGameObjects( GameObject& objA, GameObject& objB, Vector2D& normal, float& penetration )
 	{
-		if( obj.type == -1 ) return; // Don't update noObject
+		bool bBoxA = objA.aabb.x > 0.0f || objA.aabb.y > 0.0f;
+		bool bBoxB = objB.aabb.x > 0.0f || objB.aabb.y > 0.0f;
+		Vector2D d = objA.pos - objB.pos;
 
-		// We allow multiple updates if the object type has changed
-		PLAY_ASSERT_MSG( obj.lastFrameUpdated != frameCount || obj.type != obj.oldType || allowMultipleUpdatesPerFrame, "Trying to update the same GameObject more than once in the same frame!" );
-		obj.lastFrameUpdated = frameCount;
+		if( bBoxA && bBoxB )
+		{
+			float px = objA.aabb.x + objB.aabb.x - fabs( d.x );
+			float py = objA.aabb.y + objB.aabb.y - fabs( d.y );
+			if( px <= 0.0f || py <= 0.0f )
+				return false;
 
-		// Save the current position in case we need to go back
-		obj.oldPos = obj.pos;
-		obj.oldRot = obj.rotation;
+			normal = px < py ? Vector2D( d.x < 0.0f ? -1.0f : 1.0f, 0.0f ) : Vector2D( 0.0f, d.y < 0.0f ? -1.0f : 1.0f );
+			penetration = std::min( px, py );
+			return true;
+		}
 
-		// Move the object according to a very simple physical model
-		obj.velocity += obj.acceleration;
-		obj.pos += obj.velocity;
-		obj.rotation += obj.rotSpeed;
+		if( !bBoxA && bBoxB )
+			return OverlapCircleAABB( objA.pos, static_cast<float>( objA.radius ), objB.pos, objB.aabb, normal, penetration );
 
-		// Handle the animation frame update
-		obj.framePos += obj.animSpeed;
-		if( obj.framePos > 1.0f )
+		if( bBoxA && !bBoxB )
 		{
-			obj.frame++;
-			obj.framePos -= 1.0f;
+			if( !OverlapCircleAABB( objB.pos, static_cast<float>( objB.radius ), objA.pos, objA.aabb, normal, penetration ) )
+				return false;
+
+			normal = -normal;
+			return true;
 		}
 
-		// Wrap objects around the screen
-		if( bWrap )
+		float radii = static_cast<float>( objA.radius + objB.radius );
+		if( lengthSqr( d ) >= radii * radii )
+			return false;
+
+		normal = lengthSqr( d ) > 0.0f ? normalize( d ) : Vector2D( 0.0f, -1.0f );
+		penetration = radii - length( d );
+		return true;
+	}
+
+	// Not exposed externally
+	bool ContactOrder( const Contact& lhs, const Contact& rhs )
+	{
+		return lhs.idA < rhs.idA || ( lhs.idA == rhs.idA && lhs.idB < rhs.idB );
+	}
+
+	void UpdateContacts()
+	{
+		ContactList& cl = GetContextState().contactList;
+		cl.previous.swap( cl.touching );
+		cl.touching.clear();
+		cl.contacts.clear();
+
+		// A single pass over the objects, checking each one against its neighbours from the registered types
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
 		{
-			int dWidth = PlayWindow::Instance().GetWidth();
-			int dHeight = PlayWindow::Instance().GetHeight();
-			Vector2f origin = PlayGraphics::Instance().GetSpriteOrigin( obj.spriteId );
-
-			if( obj.pos.x - origin.x - wrapBorderSize > dWidth )
-				obj.pos.x = 0.0f - wrapBorderSize + origin.x;
-			else if( obj.pos.x + origin.x + wrapBorderSize < 0 )
-				obj.pos.x = dWidth + wrapBorderSize - origin.x;
-
-			if( obj.pos.y - origin.y - wrapBorderSize > dHeight )
-				obj.pos.y = 0.0f - wrapBorderSize + origin.y;
-			else if( obj.pos.y + origin.y + wrapBorderSize < 0 )
-				obj.pos.y = dHeight + wrapBorderSize - origin.y;
+			GameObject& objA = i.second;
+
+			for( std::pair<int, int>& p : cl.pairs )
+			{
+				if( objA.type != p.first )
+					continue;
+
+				float rx = std::max( static_cast<float>( objA.radius ), objA.aabb.x );
+				float ry = std::max( static_cast<float>( objA.radius ), objA.aabb.y );
+
+				VisitSpatialCells( { objA.pos.x - rx, objA.pos.y - ry }, { objA.pos.x + rx, objA.pos.y + ry }, p.second, [&]( GameObject& objB )
+				{
+					// Pairs of the same type are only reported once
+					if( &objA == &objB || ( p.first == p.second && objB.GetId() < objA.GetId() ) )
+						return;
+
+					Contact c;
+					if( OverlapGameObjects( objA, objB, c.normal, c.penetration ) )
+					{
+						c.idA = objA.GetId();
+						c.idB = objB.GetId();
+						c.typeA = objA.type;
+						c.typeB = objB.type;
+						cl.touching.push_back( c );
+					}
+				} );
+			}
 		}
 
-	}
+		// Objects which hit each other while moving have usually bounced apart again by now
+		for( Contact& hit : cl.sweptHits )
+		{
+			GameObject& objA = GetGameObject( hit.idA );
+			GameObject& objB = GetGameObject( hit.idB );
+
+			for( std::pair<int, int>& p : cl.pairs )
+			{
+				if( objA.type == p.first && objB.type == p.second )
+				{
+					hit.typeA = objA.type;
+					hit.typeB = objB.type;
+					cl.touching.push_back( hit );
+					break;
+				}
+
+				if( objA.type == p.second && objB.type == p.first )
+				{
+					std::swap( hit.idA, hit.idB );
+					hit.typeA = objB.type;
+					hit.typeB = objA.type;
+					hit.normal = -hit.normal;
+					cl.touching.push_back( hit );
+					break;
+				}
+			}
+		}
+		cl.sweptHits.clear();
 
-	void DestroyGameObject( int ID )
-	{
-		if( objectMap.find( ID ) == objectMap.end() )
+		// Sort and remove the duplicates (keeping the overlaps, which came first, but remembering whether they were also hit while moving)
+		std::stable_sort( cl.touching.begin(), cl.touching.end(), ContactOrder );
+		size_t kept = 0;
+		for( size_t t = 0; t < cl.touching.size(); t++ )
 		{
-			PLAY_ASSERT_MSG( false, "Unable to find object with given ID" );
+			if( kept > 0 && cl.touching[kept - 1].idA == cl.touching[t].idA && cl.touching[kept - 1].idB == cl.touching[t].idB )
+				cl.touching[kept - 1].bSwept |= cl.touching[t].bSwept;
+			else
+				cl.touching[kept++] = cl.touching[t];
 		}
-		else
+		cl.touching.resize( kept );
+
+		// Both lists are sorted, so they can be merged in one pass to find which contacts are new, continuing or finished
+		size_t c = 0, p = 0;
+		while( c < cl.touching.size() || p < cl.previous.size() )
 		{
-			GameObject* go = &objectMap.find( ID )->second;
-			delete go;
-			objectMap.erase( ID );
+			if( p == cl.previous.size() || ( c < cl.touching.size() && ContactOrder( cl.touching[c], cl.previous[p] ) ) )
+			{
+				cl.touching[c].state = CONTACT_BEGIN;
+				cl.contacts.push_back( cl.touching[c++] );
+			}
+			else if( c == cl.touching.size() || ContactOrder( cl.previous[p], cl.touching[c] ) )
+			{
+				cl.previous[p].state = CONTACT_END;
+				cl.contacts.push_back( cl.previous[p++] );
+			}
+			else
+			{
+				cl.touching[c].state = CONTACT_STAY;
+				cl.contacts.push_back( cl.touching[c++] );
+				p++;
+			}
 		}
 	}
 
-	void DestroyGameObjectsByType( int objType )
-	{
-		std::vector<int> typeVec = CollectGameObjectIDsByType( objType );
-		for( size_t i = 0; i < typeVec.size(); i++ )
-			DestroyGameObject( typeVec[i] );
-	}
-
-	bool IsColliding( GameObject& object1, GameObject& object2 )
+	const std::vector<Contact>& GetContacts()
 	{
-		//Don't collide with noObject
-		if( object1.type == -1 || object2.type == -1 )
-			return false;
-
-		int xDiff = int( object1.pos.x ) - int( object2.pos.x );
-		int yDiff = int( object1.pos.y ) - int( object2.pos.y );
-		int radii = object2.radius + object1.radius;
-
-		// Game progammers don't do square root!
-		return( ( xDiff * xDiff ) + ( yDiff * yDiff ) < radii * radii );
+		return GetContextState().contactList.contacts;
 	}
 
 	bool IsVisible( GameObject& obj )
@@ -4729,33 +8425,537 @@ namespace Play
 		obj.animSpeed = animSpeed;
 	}
 
+	// Not exposed externally
+	// > Gets the position to draw an object at, which is part way from oldPos to pos while RunFixedTimestep is rendering
+	Point2D DrawPosition( GameObject& obj )
+	{
+		// Objects which weren't moved by the last update are already where they should be
+		// > Frames drawn without an update still interpolate, so this compares against the last update rather than the current frame
+		if( GetContextState().drawInterpolation == 1.0f || obj.lastFrameUpdated != GetContextState().lastUpdateFrame )
+			return obj.pos;
+
+		return obj.oldPos + ( ( obj.pos - obj.oldPos ) * GetContextState().drawInterpolation );
+	}
+
+	// Not exposed externally
+	float DrawRotation( GameObject& obj )
+	{
+		if( GetContextState().drawInterpolation == 1.0f || obj.lastFrameUpdated != GetContextState().lastUpdateFrame )
+			return obj.rotation;
+
+		return obj.oldRot + ( ( obj.rotation - obj.oldRot ) * GetContextState().drawInterpolation );
+	}
+
 	void DrawObject( GameObject& obj )
 	{
+		if( PlayWindow::IsHeadless() ) return;
 		if( obj.type == -1 ) return; // Don't draw noObject
-		PlayGraphics::Instance().Draw( obj.spriteId, TRANSFORM_SPACE( obj.pos ), obj.frame );
+		PlayGraphics::Instance().Draw( obj.spriteId, TRANSFORM_SPACE( DrawPosition( obj ) ), obj.frame );
 	}
 
 	void DrawObjectTransparent( GameObject& obj, float opacity )
 	{
+		if( PlayWindow::IsHeadless() ) return;
 		if( obj.type == -1 ) return; // Don't draw noObject
-		PlayGraphics::Instance().DrawTransparent( obj.spriteId, TRANSFORM_SPACE( obj.pos ), obj.frame, opacity );
+		PlayGraphics::Instance().DrawTransparent( obj.spriteId, TRANSFORM_SPACE( DrawPosition( obj ) ), obj.frame, opacity );
 	}
 
 	void DrawObjectRotated( GameObject& obj, float opacity )
+	{
+		if( PlayWindow::IsHeadless() ) return;
+		if( obj.type == -1 ) return; // Don't draw noObject
+		PlayGraphics::Instance().DrawRotated( obj.spriteId, TRANSFORM_SPACE( DrawPosition( obj ) ), obj.frame, DrawRotation( obj ), obj.scale, opacity );
+	}
+
+	//**************************************************************************************************
+	// Snapshot functions
+	//**************************************************************************************************
+
+	// The engine state at the start of every snapshot
+	// > It is followed by the ids of the objects, then the objects themselves, then the registered state
+	struct SnapshotHeader
+	{
+		uint32_t objectCount{ 0 };
+		int nextId{ 0 };
+		RandomStream random;
+		Point2f cameraPos{ 0.0f, 0.0f };
+		uint32_t touchingCount{ 0 };
+		uint32_t sweptHitCount{ 0 };
+	};
+
+	// Snapshots copy the GameObjectData and GameObjectHotData of each GameObject and the Contacts byte for byte, which is only safe while they don't own any memory
+	// > GameObject's deleted copy operations are only there to stop the game copying objects by mistake, so they are skipped by copying the data alone
+	static_assert( std::is_trivially_copyable_v<GameObjectData>, "GameObject members (including PLAY_ADD_GAMEOBJECT_MEMBERS) must be plain data for snapshots to copy them" );
+	static_assert( std::is_trivially_copyable_v<GameObjectHotData>, "The GameObject members in the store must be plain data for snapshots to copy them" );
+
+	// Not exposed externally
+	GameObjectHotData GetGameObjectHotData( const GameObject& obj )
+	{
+		return { obj.pos, obj.oldPos, obj.velocity, obj.acceleration, obj.rotation, obj.rotSpeed, obj.oldRot, obj.frame, obj.framePos, obj.animSpeed, obj.lastFrameUpdated };
+	}
+
+	// Not exposed externally
+	void SetGameObjectHotData( GameObject& obj, const GameObjectHotData& hot )
+	{
+		obj.pos = hot.pos;
+		obj.oldPos = hot.oldPos;
+		obj.velocity = hot.velocity;
+		obj.acceleration = hot.acceleration;
+		obj.rotation = hot.rotation;
+		obj.rotSpeed = hot.rotSpeed;
+		obj.oldRot = hot.oldRot;
+		obj.frame = hot.frame;
+		obj.framePos = hot.framePos;
+		obj.animSpeed = hot.animSpeed;
+		obj.lastFrameUpdated = hot.lastFrameUpdated;
+	}
+
+	// The bytes each GameObject takes up in a snapshot
+	constexpr size_t SNAPSHOT_OBJECT_SIZE = sizeof( GameObjectData ) + sizeof( GameObjectHotData );
+	static_assert( std::is_trivially_copyable_v<Contact>, "Contacts must be plain data for snapshots to copy them" );
+
+	void AppendSnapshotBytes( std::vector<uint8_t>& snapshot, const void* pData, size_t size )
+	{
+		size_t offset = snapshot.size();
+		snapshot.resize( offset + size );
+		if( size > 0 )
+			memcpy( &snapshot[offset], pData, size );
+	}
+
+	void RegisterSnapshotState( void* pData, size_t size )
+	{
+		RegisterSnapshotCallbacks( [pData, size]( std::vector<uint8_t>& snapshot ) { AppendSnapshotBytes( snapshot, pData, size ); },
+			[pData, size]( const uint8_t* pSaved ) -> size_t { memcpy( pData, pSaved, size ); return size; } );
+	}
+
+	void RegisterSnapshotCallbacks( std::function<void( std::vector<uint8_t>& snapshot )> save, std::function<size_t( const uint8_t* pData )> load )
+	{
+		GetContextState().snapshotStates.push_back( { save, load } );
+	}
+
+	void ClearSnapshotState()
+	{
+		GetContextState().snapshotStates.clear();
+	}
+
+	void TakeSnapshot( std::vector<uint8_t>& snapshot )
+	{
+		SnapshotHeader header;
+		header.objectCount = static_cast<uint32_t>( GetContextState().objectMap.size() );
+		header.nextId = GetContextState().nextGameObjectId;
+		header.random = GetRandomStream();
+		header.cameraPos = GetContextState().cameraPos;
+		header.touchingCount = static_cast<uint32_t>( GetContextState().contactList.touching.size() );
+		header.sweptHitCount = static_cast<uint32_t>( GetContextState().contactList.sweptHits.size() );
+
+		// Size the snapshot up front so the objects are copied straight into place
+		size_t idsOffset = sizeof( header );
+		size_t objectsOffset = idsOffset + GetContextState().objectMap.size() * sizeof( int );
+		snapshot.resize( objectsOffset + GetContextState().objectMap.size() * SNAPSHOT_OBJECT_SIZE );
+		memcpy( snapshot.data(), &header, sizeof( header ) );
+
+		// The map is in id order, which RestoreSnapshot relies on
+		uint8_t* pIds = snapshot.data() + idsOffset;
+		uint8_t* pObjects = snapshot.data() + objectsOffset;
+		for( std::pair<const int, GameObject&>& i : GetContextState().objectMap )
+		{
+			// Copied out through GameObjectData's own copy constructor, as the base of a GameObject can share its tail padding with GameObject's members
+			GameObjectData data = i.second;
+			GameObjectHotData hot = GetGameObjectHotData( i.second );
+			memcpy( pIds, &i.first, sizeof( int ) );
+			memcpy( pObjects, &data, sizeof( data ) );
+			memcpy( pObjects + sizeof( data ), &hot, sizeof( hot ) );
+			pIds += sizeof( int );
+			pObjects += SNAPSHOT_OBJECT_SIZE;
+		}
+
+		// The next UpdateContacts decides which contacts have just begun from these, so they have to go back with the objects
+		AppendSnapshotBytes( snapshot, GetContextState().contactList.touching.data(), header.touchingCount * sizeof( Contact ) );
+		AppendSnapshotBytes( snapshot, GetContextState().contactList.sweptHits.data(), header.sweptHitCount * sizeof( Contact ) );
+
+		for( SnapshotState& state : GetContextState().snapshotStates )
+			state.save( snapshot );
+	}
+
+	void RestoreSnapshot( const std::vector<uint8_t>& snapshot )
+	{
+		PLAY_ASSERT_MSG( snapshot.size() >= sizeof( SnapshotHeader ), "Invalid snapshot" );
+
+		SnapshotHeader header;
+		memcpy( &header, snapshot.data(), sizeof( header ) );
+
+		const uint8_t* pIds = snapshot.data() + sizeof( header );
+		const uint8_t* pObjects = pIds + header.objectCount * sizeof( int );
+
+		// Both the map and the snapshot are in id order, so they can be walked side by side
+		std::map<int, GameObject&>::iterator i = GetContextState().objectMap.begin();
+
+		auto DestroyCurrent = [&i]()
+		{
+			GameObject* pObj = &i->second;
+			RemoveFromSpatialIndex( i->first );
+			i = GetContextState().objectMap.erase( i );
+			delete pObj;
+		};
+
+		for( uint32_t n = 0; n < header.objectCount; n++, pIds += sizeof( int ), pObjects += SNAPSHOT_OBJECT_SIZE )
+		{
+			int id = 0;
+			memcpy( &id, pIds, sizeof( id ) );
+
+			// Objects created since the snapshot was taken
+			while( i != GetContextState().objectMap.end() && i->first < id )
+				DestroyCurrent();
+
+			GameObject* pObj = nullptr;
+			if( i != GetContextState().objectMap.end() && i->first == id )
+			{
+				pObj = &i->second;
+				i++;
+			}
+			else
+			{
+				// Objects destroyed since the snapshot was taken (the copy below restores the id along with everything else)
+				pObj = new GameObject( -1, { 0.0f, 0.0f }, 0, -1 );
+				GetContextState().objectMap.emplace_hint( i, id, *pObj );
+			}
+
+			GameObjectData data;
+			GameObjectHotData hot;
+			memcpy( &data, pObjects, sizeof( data ) );
+			memcpy( &hot, pObjects + sizeof( data ), sizeof( hot ) );
+			static_cast<GameObjectData&>( *pObj ) = data;
+			SetGameObjectHotData( *pObj, hot );
+			UpdateSpatialIndex( *pObj );
+		}
+
+		while( i != GetContextState().objectMap.end() )
+			DestroyCurrent();
+
+		GetContextState().nextGameObjectId = header.nextId;
+		GetRandomStream() = header.random;
+		GetContextState().cameraPos = header.cameraPos;
+
+		const Contact* pContacts = reinterpret_cast<const Contact*>( pObjects );
+		GetContextState().contactList.touching.assign( pContacts, pContacts + header.touchingCount );
+		pContacts += header.touchingCount;
+		GetContextState().contactList.sweptHits.assign( pContacts, pContacts + header.sweptHitCount );
+		pContacts += header.sweptHitCount;
+
+		const uint8_t* pState = reinterpret_cast<const uint8_t*>( pContacts );
+		for( SnapshotState& state : GetContextState().snapshotStates )
+			pState += state.load( pState );
+
+		PLAY_ASSERT_MSG( pState == snapshot.data() + snapshot.size(), "The snapshot doesn't match the registered state" );
+	}
+
+	// Not exposed externally
+	// > Reads a byte from the snapshot as if it carried on with zeroes after its end
+	inline uint8_t SnapshotByte( const std::vector<uint8_t>& snapshot, size_t i )
+	{
+		return i < snapshot.size() ? snapshot[i] : 0;
+	}
+
+	// Not exposed externally
+	// > Records the bytes of the older snapshot which differ from the newer one, as runs of the two XORed together
+	// > The delta is the older snapshot's size followed by (gap, length, bytes) for each run
+	void EncodeSnapshotDelta( const std::vector<uint8_t>& older, const std::vector<uint8_t>& newer, std::vector<uint8_t>& delta )
+	{
+		// Runs this close together are joined, as the gap costs less than the extra header
+		constexpr size_t MIN_GAP = 8;
+
+		delta.clear();
+		uint32_t size = static_cast<uint32_t>( older.size() );
+		AppendSnapshotBytes( delta, &size, sizeof( size ) );
+
+		size_t shared = std::min( older.size(), newer.size() );
+		size_t runEnd = 0;
+		size_t i = 0;
+
+		while( i < older.size() )
+		{
+			// Most of a snapshot is unchanged from one frame to the next, so skip over it eight bytes at a time
+			while( i + 8 <= shared && memcmp( &older[i], &newer[i], 8 ) == 0 )
+				i += 8;
+			while( i < older.size() && older[i] == SnapshotByte( newer, i ) )
+				i++;
+			if( i == older.size() )
+				break;
+
+			size_t runStart = i;
+			size_t lastDiff = i;
+			while( i < older.size() && i - lastDiff <= MIN_GAP )
+			{
+				if( older[i] != SnapshotByte( newer, i ) )
+					lastDiff = i;
+				i++;
+			}
+
+			uint32_t gap = static_cast<uint32_t>( runStart - runEnd );
+			uint32_t length = static_cast<uint32_t>( lastDiff + 1 - runStart );
+			AppendSnapshotBytes( delta, &gap, sizeof( gap ) );
+			AppendSnapshotBytes( delta, &length, sizeof( length ) );
+
+			size_t offset = delta.size();
+			delta.resize( offset + length );
+			for( size_t b = 0; b < length; b++ )
+				delta[offset + b] = older[runStart + b] ^ SnapshotByte( newer, runStart + b );
+
+			runEnd = runStart + length;
+			i = runEnd;
+		}
+	}
+
+	// Not exposed externally
+	// > Turns the newer snapshot back into the older one it was encoded against
+	void ApplySnapshotDelta( const std::vector<uint8_t>& delta, std::vector<uint8_t>& snapshot )
+	{
+		uint32_t size = 0;
+		memcpy( &size, delta.data(), sizeof( size ) );
+		snapshot.resize( size ); // Any new bytes are zero, just as EncodeSnapshotDelta assumed
+
+		size_t pos = 0;
+		for( size_t d = sizeof( size ); d < delta.size(); )
+		{
+			uint32_t gap = 0, length = 0;
+			memcpy( &gap, &delta[d], sizeof( gap ) );
+			memcpy( &length, &delta[d + sizeof( gap )], sizeof( length ) );
+			d += sizeof( gap ) + sizeof( length );
+
+			pos += gap;
+			for( size_t b = 0; b < length; b++ )
+				snapshot[pos + b] ^= delta[d + b];
+			pos += length;
+			d += length;
+		}
+	}
+
+	RewindHistory::RewindHistory( size_t capacity )
+	{
+		PLAY_ASSERT_MSG( capacity > 0, "A rewind history must hold at least one snapshot" );
+		m_deltas.resize( capacity - 1 );
+	}
+
+	void RewindHistory::Push( const std::vector<uint8_t>& snapshot )
+	{
+		if( m_bHasLatest && !m_deltas.empty() )
+		{
+			// Drop the oldest snapshot if the ring is full
+			if( m_count == m_deltas.size() )
+			{
+				m_first = ( m_first + 1 ) % m_deltas.size();
+				m_count--;
+			}
+
+			EncodeSnapshotDelta( m_latest, snapshot, m_deltas[( m_first + m_count ) % m_deltas.size()] );
+			m_count++;
+		}
+
+		m_latest = snapshot;
+		m_bHasLatest = true;
+	}
+
+	bool RewindHistory::Rewind( int frames, std::vector<uint8_t>& snapshot )
+	{
+		if( !m_bHasLatest )
+			return false;
+
+		for( ; frames > 0 && m_count > 0; frames-- )
+		{
+			m_count--;
+			ApplySnapshotDelta( m_deltas[( m_first + m_count ) % m_deltas.size()], m_latest );
+		}
+
+		snapshot = m_latest;
+		return true;
+	}
+
+	void RewindHistory::Clear()
+	{
+		m_bHasLatest = false;
+		m_first = 0;
+		m_count = 0;
+	}
+
+	size_t RewindHistory::GetCount() const
+	{
+		return m_bHasLatest ? m_count + 1 : 0;
+	}
+
+	size_t RewindHistory::GetMemoryUsed() const
+	{
+		size_t bytes = m_bHasLatest ? m_latest.size() : 0;
+		for( size_t d = 0; d < m_count; d++ )
+			bytes += m_deltas[( m_first + d ) % m_deltas.size()].size();
+		return bytes;
+	}
+
+#endif
+
+	//**************************************************************************************************
+	// RenderSnapshot functions
+	//**************************************************************************************************
+
+	void RenderSnapshot::ClearDrawingBuffer( Colour col )
+	{
+		Command command;
+		command.type = COMMAND_CLEAR;
+		command.colour = col;
+		m_commands.push_back( command );
+	}
+
+	void RenderSnapshot::DrawBackground( int background )
+	{
+		Command command;
+		command.type = COMMAND_BACKGROUND;
+		command.id = background;
+		m_commands.push_back( command );
+	}
+
+	void RenderSnapshot::DrawSprite( int spriteID, Point2D pos, int frame )
+	{
+		Command command;
+		command.type = COMMAND_SPRITE;
+		command.id = spriteID;
+		command.pos = pos;
+		command.frame = frame;
+		m_commands.push_back( command );
+	}
+
+	void RenderSnapshot::DrawSpriteRotated( int spriteID, Point2D pos, int frame, float angle, float scale, float opacity )
+	{
+		Command command;
+		command.type = COMMAND_SPRITE_ROTATED;
+		command.id = spriteID;
+		command.pos = pos;
+		command.frame = frame;
+		command.angle = angle;
+		command.scale = scale;
+		command.opacity = opacity;
+		m_commands.push_back( command );
+	}
+
+	void RenderSnapshot::DrawRect( Point2D topLeft, Point2D bottomRight, Colour col, bool fill )
+	{
+		Command command;
+		command.type = COMMAND_RECT;
+		command.pos = topLeft;
+		command.pos2 = bottomRight;
+		command.colour = col;
+		command.id = fill ? 1 : 0;
+		m_commands.push_back( command );
+	}
+
+	void RenderSnapshot::DrawFontText( const char* fontId, const std::string& text, Point2D pos, Align justify )
+	{
+		Command command;
+		command.type = COMMAND_FONT_TEXT;
+		command.font = fontId;
+		command.text = text;
+		command.pos = pos;
+		command.id = justify;
+		m_commands.push_back( std::move( command ) );
+	}
+
+	void RenderSnapshot::DrawDebugText( Point2D pos, const char* text, Colour col, bool centred )
+	{
+		Command command;
+		command.type = COMMAND_DEBUG_TEXT;
+		command.text = text;
+		command.pos = pos;
+		command.colour = col;
+		command.id = centred ? 1 : 0;
+		m_commands.push_back( std::move( command ) );
+	}
+
+	void RenderSnapshot::SetCameraPosition( Point2f pos )
+	{
+		Command command;
+		command.type = COMMAND_CAMERA;
+		command.pos = pos;
+		m_commands.push_back( command );
+	}
+
+#ifdef PLAY_USING_GAMEOBJECT_MANAGER
+
+	void RenderSnapshot::DrawObject( GameObject& obj )
+	{
+		if( obj.type == -1 ) return; // Don't draw noObject
+		DrawSprite( obj.spriteId, DrawPosition( obj ), obj.frame );
+	}
+
+	void RenderSnapshot::DrawObjectRotated( GameObject& obj, float opacity )
 	{
 		if( obj.type == -1 ) return; // Don't draw noObject
-		PlayGraphics::Instance().DrawRotated( obj.spriteId, TRANSFORM_SPACE( obj.pos ), obj.frame, obj.rotation, obj.scale, opacity );
+		DrawSpriteRotated( obj.spriteId, DrawPosition( obj ), obj.frame, DrawRotation( obj ), obj.scale, opacity );
 	}
 
 #endif
 
+	bool RenderSnapshot::IsSameAs( const RenderSnapshot& other ) const
+	{
+		if( m_commands.size() != other.m_commands.size() )
+			return false;
+
+		for( size_t i = 0; i < m_commands.size(); i++ )
+		{
+			const Command& a = m_commands[i];
+			const Command& b = other.m_commands[i];
+
+			if( a.type != b.type || a.id != b.id || a.frame != b.frame || a.pos.x != b.pos.x || a.pos.y != b.pos.y || a.pos2.x != b.pos2.x || a.pos2.y != b.pos2.y
+				|| a.angle != b.angle || a.scale != b.scale || a.opacity != b.opacity || a.colour.red != b.colour.red || a.colour.green != b.colour.green
+				|| a.colour.blue != b.colour.blue || a.font != b.font || a.text != b.text )
+				return false;
+		}
+
+		return true;
+	}
+
+	void RenderSnapshot::Render() const
+	{
+		Point2f originalCameraPos = GetContextState().cameraPos;
+
+		for( const Command& command : m_commands )
+		{
+			switch( command.type )
+			{
+				case COMMAND_CLEAR:
+					Play::ClearDrawingBuffer( command.colour );
+					break;
+				case COMMAND_BACKGROUND:
+					Play::DrawBackground( command.id );
+					break;
+				case COMMAND_SPRITE:
+					Play::DrawSprite( command.id, command.pos, command.frame );
+					break;
+				case COMMAND_SPRITE_ROTATED:
+					Play::DrawSpriteRotated( command.id, command.pos, command.frame, command.angle, command.scale, command.opacity );
+					break;
+				case COMMAND_RECT:
+					Play::DrawRect( command.pos, command.pos2, command.colour, command.id != 0 );
+					break;
+				case COMMAND_FONT_TEXT:
+					Play::DrawFontText( command.font.c_str(), command.text, command.pos, static_cast<Align>( command.id ) );
+					break;
+				case COMMAND_DEBUG_TEXT:
+					Play::DrawDebugText( command.pos, command.text.c_str(), command.colour, command.id != 0 );
+					break;
+				case COMMAND_CAMERA:
+					GetContextState().cameraPos = command.pos;
+					break;
+			}
+		}
+
+		GetContextState().cameraPos = originalCameraPos;
+	}
+
 	//**************************************************************************************************
 	// Miscellaneous functions
 	//**************************************************************************************************
 
 	bool KeyPressed( int vKey )
 	{
-		return PlayInput::Instance().KeyPressed( vKey, frameCount );
+		return PlayInput::Instance().KeyPressed( vKey, GetContextState().frameCount );
 	}
 
 	bool KeyDown( int vKey )
@@ -4763,20 +8963,86 @@ namespace Play
 		return PlayInput::Instance().KeyDown( vKey );
 	}
 
-	int RandomRoll( int sides )
+	void SetKeyState( int vKey, bool down )
 	{
-		return ( rand() % sides ) + 1;
+		PlayInput::Instance().SetKeyState( vKey, down );
 	}
 
-	int RandomRollRange( int begin, int end )
+	void SetScriptedInput( bool scripted )
+	{
+		PlayInput::Instance().SetScriptedInput( scripted );
+	}
+
+	bool IsScriptedInput()
 	{
-		int range = abs( end - begin );
-		int rnd = ( rand() % ( range + 1 ) );
+		return PlayInput::Instance().IsScriptedInput();
+	}
+
+	void SetHeadlessInput( std::function<void( int frame )> input )
+	{
+		PlayWindow::Instance().SetHeadlessInput( input );
+	}
+
+	void SetInputScript( std::function<void( int frame )> script )
+	{
+		PlayWindow::Instance().SetInputScript( script );
+	}
+
+	void RandomStream::Seed( uint64_t seed, uint64_t stream )
+	{
+		// The standard PCG32 seeding sequence
+		m_increment = ( stream << 1u ) | 1u;
+		m_state = 0;
+		Next();
+		m_state += seed;
+		Next();
+	}
+
+	uint32_t RandomStream::Next()
+	{
+		uint64_t old = m_state;
+		m_state = old * 6364136223846793005ULL + m_increment;
+		uint32_t xorShifted = static_cast<uint32_t>( ( ( old >> 18u ) ^ old ) >> 27u );
+		uint32_t rot = static_cast<uint32_t>( old >> 59u );
+		return ( xorShifted >> rot ) | ( xorShifted << ( ( 0u - rot ) & 31u ) );
+	}
+
+	int RandomStream::Roll( int sides )
+	{
+		PLAY_ASSERT_MSG( sides > 0, "A die must have at least one side" );
+		// Scales the 32 bits into the range with a multiply rather than a (much slower) divide
+		return static_cast<int>( ( static_cast<uint64_t>( Next() ) * static_cast<uint32_t>( sides ) ) >> 32 ) + 1;
+	}
+
+	int RandomStream::RollRange( int begin, int end )
+	{
+		uint64_t range = static_cast<uint64_t>( abs( end - begin ) ) + 1;
+		int rnd = static_cast<int>( ( static_cast<uint64_t>( Next() ) * range ) >> 32 );
 		if( end > begin )
 			return begin + rnd;
 		else
 			return end + rnd;
 	}
+
+	RandomStream& GetRandomStream()
+	{
+		return GetContextState().randomStream;
+	}
+
+	void SeedRandom( uint64_t seed, uint64_t stream )
+	{
+		GetContextState().randomStream.Seed( seed, stream );
+	}
+
+	int RandomRoll( int sides )
+	{
+		return GetContextState().randomStream.Roll( sides );
+	}
+
+	int RandomRollRange( int begin, int end )
+	{
+		return GetContextState().randomStream.RollRange( begin, end );
+	}
 }
 #endif // PLAY_IMPLEMENTATION
 
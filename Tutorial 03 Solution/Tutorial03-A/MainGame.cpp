@@ -6,6 +6,8 @@ constexpr float DISPLAY_WIDTH{ 1280 };
 constexpr float DISPLAY_HEIGHT{ 720 };
 constexpr int DISPLAY_SCALE{ 1 };
 constexpr int BALL_RADIUS{ 48 };
+// The ball's collisions are swept, so this is only to keep the game playable
+constexpr float BALL_MAX_SPEED{ 16.f };
 
 // Define a value for our ball's default velocity
 const Vector2D BALL_VELOCITY_DEFAULT(6.0f, 0.f);
@@ -16,14 +18,45 @@ const Vector2D BALL_ACCELERATION(0.f, 0.2f);
 const Vector2D PADDLE_AABB{100.f, 20.f};
 const Vector2D BALL_AABB{ 48.f, 48.f };
 const Vector2D CHEST_AABB{ 50.f, 50.f };
-
-float minY = 0.f;
-float maxY = 0.f;
-
-float minX = 0.f;
-float maxX = 0.f;
+// Coins are collected from further away than their sprite, so their box is bigger
+const Vector2D COIN_AABB{ BALL_AABB * 2.f };
 
 const int CHEST_SPACING{ 90 };
+// How many times a chest has to be hit before it opens
+const int CHEST_HITS{ 1 };
+// The most chests a ball can hit in one update (it stops dead rather than go any further)
+const int MAX_CHEST_HITS{ 4 };
+// How fast the endless mode scrolls up the screen (in pixels per update)
+const float ENDLESS_SCROLL_SPEED{ 0.5f };
+// The chance of each new chest being there when the endless mode makes a row
+const int ENDLESS_CHEST_PERCENT{ 40 };
+// How often the stress mode reports its frame time breakdown (in updates)
+const int TIMING_REPORT_INTERVAL{ 60 };
+// How often the soak test checks for drift (one minute of updates)
+const int SOAK_REPORT_INTERVAL{ 60 * 60 };
+// How far a ball can be from the middle of the paddle before the autopilot moves it
+const float AUTOPILOT_DEADZONE{ 20.f };
+// How many updates can be rewound by holding backspace (ten seconds)
+const int REWIND_FRAMES{ 60 * 10 };
+// How many updates are rewound each update while backspace is held
+const int REWIND_SPEED{ 2 };
+// How many pixels across and down each pixel of an environment's downsampled frame covers
+const int ENVIRONMENT_FRAME_SCALE{ 8 };
+// How many updates the versus mode can roll back, which is as far as a game can get ahead of the other player's inputs
+const int VERSUS_MAX_ROLLBACK{ 8 };
+// How many updates of inputs and snapshots the versus mode keeps (more than it can roll back)
+const int VERSUS_HISTORY{ 32 };
+// How many of the latest inputs each versus message repeats, so losing a message doesn't lose any inputs
+const int VERSUS_REDUNDANCY{ 16 };
+// The first player's game receives on this port and the second player's on the next one
+const int VERSUS_PORT{ 27960 };
+// Both versus games have to make the same random choices
+const uint32_t VERSUS_SEED{ 20221010 };
+// How many updates late the stand-in sends its inputs, so the versus mode rolls back like it would over a network
+const int VERSUS_STAND_IN_DELAY{ 4 };
+// The keys the versus mode presses for the second player's paddle
+const int RIVAL_KEY_LEFT{ 'A' };
+const int RIVAL_KEY_RIGHT{ 'D' };
 
 enum GameObjectType
 {
@@ -32,6 +65,7 @@ enum GameObjectType
 	TYPE_CHEST = 2,
 	TYPE_COIN = 3,
 	TYPE_DESTROYED = 4,
+	TYPE_RIVAL_PADDLE = 5, // The second player's paddle in the versus mode
 };
 
 enum GameFlow
@@ -43,413 +77,1854 @@ enum GameFlow
 	STATE_WON = 3,
 };
 
+// The parts of each frame the stress mode times
+enum TimingSection
+{
+	TIMING_BALLS = 0,
+	TIMING_PADDLE,
+	TIMING_COINS,
+	TIMING_COLLISIONS,
+	TIMING_SNAPSHOT,
+	TIMING_DRAW,
+	TIMING_COUNT,
+};
+
+const char* TIMING_NAMES[TIMING_COUNT] = { "balls", "paddle", "coins", "collisions", "snapshot", "draw" };
+
+// Run with -stress <balls> <chest rows> <chest columns> <coin drop %> to see how the game copes with lots of objects
+struct StressConfig
+{
+	bool enabled{ false };
+	int ballCount{ 1 };
+	int chestRows{ 2 };
+	int chestColumns{ 7 };
+	int coinDropPercent{ 100 };
+};
+
+struct FrameTimings
+{
+	double sectionMs[TIMING_COUNT]{};
+	double totalMs[TIMING_COUNT]{};
+	int updates{ 0 };
+	int totalUpdates{ 0 };
+	std::string report;
+};
+
+// Run with -autopilot to let the game play itself, or -soak <minutes> to also check it keeps running the same way for that long
+struct SoakTest
+{
+	bool autopilot{ false };
+	bool enabled{ false };
+	int minutes{ 0 };
+	int updates{ 0 };
+	int autopilotFrame{ 0 };
+	int sessions{ 0 };
+	int drifts{ 0 };
+	bool checkSession{ false };
+	std::vector<float> frameMs;
+	// Measured at the start of the first session and over the first minute, for the rest of the test to be compared against
+	int baselineObjects{ -1 };
+	size_t baselineBytes{ 0 };
+	float baselineP95{ 0.f };
+};
+
+// Run with -headless <frames> -batch <games> <frames> to also play that many games by themselves at the same time (each on its own thread)
+struct BatchRun
+{
+	int games{ 0 };
+	int frames{ 0 };
+	std::vector<std::thread> threads;
+};
+
+// The actions a bot can take in each step of a training environment
+enum EnvironmentAction
+{
+	ACTION_NONE = 0,
+	ACTION_LEFT,
+	ACTION_RIGHT,
+};
+
+// The buttons each player's input is packed into for the versus mode
+enum VersusInput
+{
+	INPUT_LEFT = 1,
+	INPUT_RIGHT = 2,
+	INPUT_START = 4,
+};
+
+// How many balls an Observation has room for (OBS_BALL_COUNT still counts every ball)
+constexpr int OBS_MAX_BALLS{ 4 };
+
+// The packed state vector in each Observation
+enum ObservationValue
+{
+	OBS_PADDLE_X = 0,
+	OBS_PADDLE_Y,
+	OBS_PADDLE_VELOCITY_X, // How far the paddle moved in the last step (the controls move it directly rather than through its velocity)
+	OBS_PADDLE_VELOCITY_Y,
+	OBS_SCORE,
+	OBS_LIVES,
+	OBS_BALL_COUNT,
+	OBS_BALL_X, // The values for each ball follow on, OBS_BALL_STRIDE apart (and are zero for the balls which aren't there)
+	OBS_BALL_Y,
+	OBS_BALL_VELOCITY_X,
+	OBS_BALL_VELOCITY_Y,
+	OBS_BALL_STRIDE = OBS_BALL_VELOCITY_Y - OBS_BALL_X + 1,
+	OBS_SIZE = OBS_BALL_X + OBS_BALL_STRIDE * OBS_MAX_BALLS,
+};
+
+// What a training environment returns after each step
+struct Observation
+{
+	float state[OBS_SIZE]{};
+	std::vector<uint64_t> chests; // A copy of the chest grid's bitset
+	std::vector<uint8_t> frame; // A greyscale picture of the game shrunk by ENVIRONMENT_FRAME_SCALE (only filled in if asked for)
+	bool done{ false }; // The game has been won or lost, and the next step starts a new one
+};
+
 struct GameState
 {
-	int yCount{ 0 };
-	int xCount{ 0 };
-	int x{ 0 };
-	int y{ 0 };
 	int offsetX{ 80 };
 	int offsetY{ 70 };
 	int collisionCount{ 0 };
 	int ballRotation{ 0 };
 	int lives{ 3 };
 	int score{ 0 };
+	int rivalScore{ 0 }; // The second player's score in the versus mode
+	int lastPaddle{ TYPE_PADDLE }; // The paddle the ball last bounced off, which gets the points for the chests it opens
 	GameFlow state = STATE_HELLO;
+	bool fromPaddle{ false };
+	// Run with -endless to keep making new rows of chests as the screen scrolls up
+	bool endless{ false };
+	float cameraY{ 0.f };
+	float previousCameraY{ 0.f };
+};
+
+// The player's sound and music choices (F2 and F3), which are kept out of GameState so rewinding and rolling back don't change them
+struct AudioSettings
+{
 	bool sound{ false };
 	bool music{ false };
-	bool fromPaddle{ false };
 };
 
-GameState gameState;
+// The chests are a grid rather than GameObjects, so a ball only has to check the few cells it overlaps
+// > Each row is a bitset of the chests still closed, and every cell has a count of the hits it has left
+// > The rows are stored in a ring, so the endless mode can reuse a row once it has scrolled off the screen
+// The chest grid's sizes and position, kept apart from its vectors so snapshots can copy them as one block
+struct ChestGridLayout
+{
+	int rows{ 0 };
+	int firstRow{ 0 };
+	int columns{ 0 };
+	int wordsPerRow{ 0 };
+	int remaining{ 0 };
+	Point2D origin{ 0.f, 0.f };
+	Vector2D spacing{ 0.f, 0.f };
+};
+static_assert(std::is_trivially_copyable_v<ChestGridLayout>, "The chest grid layout is saved in snapshots by copying its bytes");
+
+struct ChestGrid
+{
+	ChestGridLayout layout;
+	std::vector<uint64_t> closed;
+	std::vector<uint8_t> hitsLeft;
+};
+
+// Run with -versus <1|2> in two copies of the game to play against each other, or -versus local to play against a stand-in on the autopilot
+// > Only the inputs are sent between the games, and each one predicts the other player's input until it arrives
+// > A wrong prediction rolls the game back to the snapshot from that update and runs it forward again with the real input
+// > Both games have to be run with the same settings (-endless, -stress etc.) to stay the same
+struct VersusMatch
+{
+	bool enabled{ false };
+	bool standIn{ false };
+	int player{ 0 }; // 0 controls TYPE_PADDLE and 1 controls TYPE_RIVAL_PADDLE
+	int sendDelay{ 0 };
+	std::unique_ptr<PlaySocket> pSocket;
+	// The local player's keys for this frame
+	uint8_t input{ 0 };
+	bool keyboard{ true };
+	bool quit{ false };
+	int frame{ 0 }; // The next update to run
+	int confirmedFrame{ 0 }; // The first update whose input hasn't arrived from the other game
+	int rollbackFrame{ -1 }; // The first update which ran with a wrong prediction (or -1)
+	uint8_t localInputs[VERSUS_HISTORY]{};
+	uint8_t remoteInputs[VERSUS_HISTORY]{};
+	int remoteFrames[VERSUS_HISTORY]{}; // Which update each remote input is for
+	uint8_t predictedInputs[VERSUS_HISTORY]{}; // The remote input each update actually ran with
+	std::vector<uint8_t> snapshots[VERSUS_HISTORY]; // The state at the start of each update
+	uint32_t checksums[VERSUS_HISTORY]{}; // A checksum of the game at the start of each update, which both games should agree on once its inputs are confirmed
+	// The other game's latest checksum, kept until this game has confirmed the same update
+	int remoteChecksumFrame{ -1 };
+	uint32_t remoteChecksum{ 0 };
+	int checkedFrame{ -1 }; // The last update whose checksums were compared
+	bool rollingBack{ false }; // Updates being run again don't play any sounds
+	// Statistics reported on exit
+	int rollbacks{ 0 };
+	int rerunFrames{ 0 };
+	int longestRollback{ 0 };
+	double totalRollbackMs{ 0.0 };
+	double worstRollbackMs{ 0.0 };
+	int stalls{ 0 };
+	int desyncs{ 0 };
+};
+
+// What each versus game sends the other every update: its latest inputs, ending with the one for lastFrame
+// > Also the checksum of its latest update whose inputs are all confirmed, so the games can tell if they have gone out of sync
+struct VersusMessage
+{
+	int32_t lastFrame{ 0 };
+	int32_t checksumFrame{ -1 };
+	uint32_t checksum{ 0 };
+	uint8_t count{ 0 };
+	uint8_t inputs[VERSUS_REDUNDANCY]{};
+};
+
+// The thread running the stand-in for -versus local
+struct VersusStandIn
+{
+	std::thread thread;
+	std::atomic<bool> quit{ false };
+};
+
+// The state of a game is thread_local, so each batch game has its own copy (the settings are shared)
+thread_local GameState gameState;
+thread_local AudioSettings audioSettings;
+StressConfig stressConfig;
+BatchRun batchRun;
+thread_local FrameTimings frameTimings;
+thread_local ChestGrid chestGrid;
+thread_local SoakTest soakTest;
+thread_local VersusMatch versus;
+VersusStandIn versusStandIn;
+thread_local Play::RewindHistory rewindHistory{ REWIND_FRAMES };
+thread_local std::vector<uint8_t> rewindSnapshot;
+// Whether the game on this thread records its rewind history (the versus mode and the training environments turn it off)
+thread_local bool rewindEnabled{ true };
+
+// One copy of the game used for training bots, with its own context and game state
+// > The game's functions work on the thread_local globals, so an environment's state is swapped into them for each step on whichever thread runs it
+struct Environment
+{
+	Play::Context context;
+	GameState gameState;
+	ChestGrid chestGrid;
+	FrameTimings frameTimings;
+	SoakTest soakTest;
+	Play::RewindHistory rewindHistory{ REWIND_FRAMES };
+	// Training environments don't need to be rewound, and skipping the snapshots makes each step much quicker
+	bool rewindEnabled{ false };
+	Observation observation;
+};
+
+// A batch of training environments which are all stepped together across a thread pool
+// > Run with -headless <frames> -train <games> <steps> to measure how many steps per second it manages
+struct EnvironmentBatch
+{
+	std::vector<std::unique_ptr<Environment>> games;
+	PlayThreadPool* pThreadPool{ nullptr };
+	bool frames{ false };
+	int benchmarkGames{ 0 };
+	int benchmarkSteps{ 0 };
+};
+
+EnvironmentBatch environments;
+// Run with -exportframes <name> to let a recorder or analysis tool read each frame from shared memory
+std::string frameExportName;
+// Run with -capture <path> to save every frame as a PNG file, or -capturevideo <file> to save them all in one delta compressed file
+std::string frameCapturePath;
+PlayFrameCapture::Format frameCaptureFormat{ PlayFrameCapture::CAPTURE_PNG };
+// Run with -dynamicres <ms> to draw at a lower resolution whenever drawing a frame takes longer than that
+float dynamicResolutionBudget{ 0.f };
+
+void SetupGame();
+void RunBatchGame(int game, bool endless);
+void CreateEnvironments(int count, bool frames);
+const std::vector<std::unique_ptr<Environment>>& StepEnvironments(const std::vector<int>& actions);
+void DestroyEnvironments();
+void RunInEnvironment(Environment& environment, const std::function<void()>& work);
+void SwapEnvironment(Environment& environment);
+void Observe(Observation& observation, bool frame);
+void DrawObservationBox(Observation& observation, Point2D pos, Vector2D halfSize, uint8_t shade);
+void BenchmarkEnvironments();
+bool StartVersus();
+void RunVersusStandIn(bool endless);
+void ReadVersusInput();
+bool UpdateVersus();
+void ReceiveVersusInputs();
+void SendVersusInputs();
+void SimulateVersusFrame();
+void RollBackVersus();
+uint32_t VersusChecksum();
+void CheckVersusSync();
+std::string GetVersusResult();
+bool UpdateGame();
+void DrawGame(Play::RenderSnapshot& frame, float interpolation);
+void HeadlessInput(int frame);
+void RunAutopilot();
+void AutopilotInput(int frame);
+bool UpdateSoakTest();
+void CheckSoakSession();
+void ReportSoakInterval();
+void FlagDrift(const std::string& message);
+float Percentile(std::vector<float>& values, float fraction);
+void SoundControl();
+
+void DrawHello(Play::RenderSnapshot& frame);
+void DrawGameOver(Play::RenderSnapshot& frame);
+void DrawGamePlay(Play::RenderSnapshot& frame, float interpolation);
+void DrawGamePaused(Play::RenderSnapshot& frame);
+void DrawGameWon(Play::RenderSnapshot& frame);
+void DrawSoundControl(Play::RenderSnapshot& frame);
+
+void StartGame();
+void RestartAndRestore();
+void RecordRewindFrame();
+bool RewindGame();
+void CreateChestGrid(int rows, int columns);
+void FillChestRow(int row);
+void ScrollChestGrid();
+int GetChestSlot(int row);
+int GetChestColumns(int row);
+bool IsChestClosed(int row, int column);
+Point2D GetChestPos(int row, int column);
+int GetChestRow(float y);
+int GetChestColumn(int row, float x);
+void CollideWithChests(GameObject& ballObj, Point2D start);
+void DrawChests(Play::RenderSnapshot& frame);
+void ParseCommandLine(int argc, char* argv[]);
+void RecordTiming(TimingSection section, std::chrono::steady_clock::time_point& start);
+void ReportTimings();
+void DrawTimings(Play::RenderSnapshot& frame);
+
+void UpdateCoins();
+void UpdateBalls();
+void UpdatePaddle();
+void UpdatePlayerControls();
+void UpdateDestroyed();
+
+void RestartGame();
+void DestroyObjects();
+
+bool IsWinning();
+void HandleCollisions();
+void ChestCollision(int row, int column);
+void PaddleCollision(GameObject& ballObj, const GameObject& paddleObj, Vector2D normal);
+void CoinCollision(GameObject& coinObj, const GameObject& paddleObj);
+
+void RedirectBall(GameObject& ballObj, int objectType, Vector2D normal);
+void AdjustBallAndPaddle(GameObject& ballObj, int paddleType);
+
+// The entry point for a PlayBuffer program
+void MainGameEntry(int argc, char* argv[])
+{
+	ParseCommandLine(argc, argv);
+	SetupGame();
+
+	// Every screen starts by clearing the whole drawing buffer, so the frames can be shown on another thread
+	Play::SetPresentThread(true);
+
+	if (dynamicResolutionBudget > 0.f)
+		Play::SetDynamicResolution(dynamicResolutionBudget);
+
+	if (!frameExportName.empty() && !Play::StartFrameExport(frameExportName.c_str()))
+		DebugOutput("Couldn't create the shared memory for -exportframes\n");
+
+	if (!frameCapturePath.empty())
+		Play::StartFrameCapture(frameCapturePath.c_str(), frameCaptureFormat);
+
+	// The keys "pressed" when running with -headless <frames>
+	Play::SetHeadlessInput(HeadlessInput);
+
+	// The autopilot presses the keys before each frame's input is read, so -record records them
+	// > ESC still comes from the keyboard, so a game on the autopilot in the window can be quit
+	if (soakTest.autopilot)
+	{
+		Play::SetInputScript([](int)
+		{
+			RunAutopilot();
+			if (!PlayWindow::IsHeadless())
+				Play::SetKeyState(VK_ESCAPE, GetAsyncKeyState(VK_ESCAPE) & 0x8000);
+		});
+	}
+
+	// The batch games are headless too, as only one game can have the window
+	if (batchRun.games > 0 && !PlayWindow::IsHeadless())
+		DebugOutput("-batch only works with -headless\n");
+	else
+	{
+		for (int game = 1; game <= batchRun.games; game++)
+			batchRun.threads.emplace_back(RunBatchGame, game, gameState.endless);
+	}
+
+	if (environments.benchmarkGames > 0 && PlayWindow::IsHeadless())
+		BenchmarkEnvironments();
+
+	if (versus.enabled && StartVersus() && versus.standIn)
+		versusStandIn.thread = std::thread(RunVersusStandIn, gameState.endless);
+}
+
+// Creates the managers for the current context and sets up the game
+void SetupGame()
+{
+	// Setup PlayBuffer
+	Play::CreateManager(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE);
+	Play::LoadBackground("Data\\Backgrounds\\background.png");
+	Play::CentreAllSpriteOrigins(); // this function makes it so that obj.pos values represent the center of a sprite instead of its top-left corner
+	Play::SetFixedPointPhysics(true); // so recordings replay exactly the same whichever build plays them back
+
+	// The pairs of object types HandleCollisions is told about
+	// > Chests aren't GameObjects, so the balls check them against the chest grid in UpdateBalls
+	Play::RegisterCollisionPair(TYPE_BALL, TYPE_PADDLE);
+	Play::RegisterCollisionPair(TYPE_BALL, TYPE_RIVAL_PADDLE);
+	Play::RegisterCollisionPair(TYPE_COIN, TYPE_PADDLE);
+	Play::RegisterCollisionPair(TYPE_COIN, TYPE_RIVAL_PADDLE);
+
+	// The versus mode rolls back to snapshots too
+	if (!rewindEnabled && !versus.enabled)
+		return;
+
+	// The game's own state which is saved along with the GameObjects for rewinding
+	Play::RegisterSnapshotState(&gameState, sizeof(gameState));
+	Play::RegisterSnapshotState(&chestGrid.layout, sizeof(chestGrid.layout));
+	Play::RegisterSnapshotState(chestGrid.closed);
+	Play::RegisterSnapshotState(chestGrid.hitsLeft);
+}
+
+// Plays a whole game on the autopilot in its own context, alongside the main game
+void RunBatchGame(int game, bool endless)
+{
+	Play::Context context;
+	Play::SetCurrentContext(&context);
+
+	gameState.endless = endless;
+	soakTest.autopilot = true;
+	SetupGame();
+
+	// Every game would have the same random numbers otherwise, so each one uses its own stream
+	Play::SeedRandom(PlayInput::Instance().GetRandomSeed(), game);
+
+	int frame = 0;
+	while (frame < batchRun.frames)
+	{
+		RunAutopilot();
+		if (MainGameUpdate(1.f / FRAMES_PER_SECOND))
+			break;
+		frame++;
+	}
+
+	char report[128];
+	sprintf_s(report, "Batch game %d: %d frames, score %d, %d lives left\n", game, frame, gameState.score, gameState.lives);
+	DebugOutput(report);
+	printf("%s", report);
+
+	Play::DestroyManager();
+	Play::SetCurrentContext(nullptr);
+}
+
+// Creates the training environments, each with a game already started (frames asks for the downsampled frame in each observation)
+void CreateEnvironments(int count, bool frames)
+{
+	environments.frames = frames;
+	environments.pThreadPool = new PlayThreadPool(std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0)); // The calling thread makes up the rest
+
+	bool endless = gameState.endless;
+	for (int i = 0; i < count; i++)
+	{
+		environments.games.push_back(std::make_unique<Environment>());
+		environments.games.back()->gameState.endless = endless;
+	}
+
+	// Loading the sprites for every environment takes a while, so that is spread across the threads too
+	environments.pThreadPool->ParallelFor(environments.games.size(), 1, [](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Environment& environment = *environments.games[i];
+			RunInEnvironment(environment, [&environment]()
+			{
+				SetupGame();
+				Play::SetScriptedInput(true);
+				StartGame();
+				gameState.state = STATE_PLAY;
+				Observe(environment.observation, environments.frames);
+			});
+		}
+	});
+}
+
+// Applies one action to each environment and runs one update of each game
+// > A game which has finished starts again on the next step
+const std::vector<std::unique_ptr<Environment>>& StepEnvironments(const std::vector<int>& actions)
+{
+	PLAY_ASSERT_MSG(actions.size() == environments.games.size(), "There must be one action for each environment");
+
+	environments.pThreadPool->ParallelFor(environments.games.size(), 1, [&actions](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Environment& environment = *environments.games[i];
+			RunInEnvironment(environment, [&environment, action = actions[i]]()
+			{
+				Play::SetKeyState(VK_LEFT, action == ACTION_LEFT);
+				Play::SetKeyState(VK_RIGHT, action == ACTION_RIGHT);
+				Play::SetKeyState(VK_SPACE, environment.observation.done);
+
+				// The same single update RunPipelined would run for one frame at 60 frames a second
+				Play::RunFixedTimestep(1.f / FRAMES_PER_SECOND, UpdateGame, [](float) {});
+				Observe(environment.observation, environments.frames);
+			});
+		}
+	});
+
+	return environments.games;
+}
+
+void DestroyEnvironments()
+{
+	for (std::unique_ptr<Environment>& environment : environments.games)
+		RunInEnvironment(*environment, []() { Play::DestroyManager(); });
+
+	environments.games.clear();
+	delete environments.pThreadPool;
+	environments.pThreadPool = nullptr;
+}
+
+// Does some work on the environment's game from the calling thread
+void RunInEnvironment(Environment& environment, const std::function<void()>& work)
+{
+	Play::Context& previous{ Play::GetCurrentContext() };
+	Play::SetCurrentContext(&environment.context);
+	SwapEnvironment(environment);
+
+	work();
+
+	SwapEnvironment(environment);
+	Play::SetCurrentContext(&previous);
+}
+
+// Exchanges the environment's game state with the calling thread's thread_local globals
+void SwapEnvironment(Environment& environment)
+{
+	std::swap(gameState, environment.gameState);
+	std::swap(chestGrid, environment.chestGrid);
+	std::swap(frameTimings, environment.frameTimings);
+	std::swap(soakTest, environment.soakTest);
+	std::swap(rewindHistory, environment.rewindHistory);
+	std::swap(rewindEnabled, environment.rewindEnabled);
+}
+
+// Fills in the observation from the current game
+void Observe(Observation& observation, bool frame)
+{
+	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
+	std::vector<int> ballIds{ Play::CollectGameObjectIDsByType(TYPE_BALL) };
+
+	// Positions are relative to the camera, so the endless mode looks the same as the normal one
+	observation.state[OBS_PADDLE_X] = paddleObj.pos.x;
+	observation.state[OBS_PADDLE_Y] = paddleObj.pos.y - gameState.cameraY;
+	observation.state[OBS_PADDLE_VELOCITY_X] = paddleObj.pos.x - paddleObj.oldPos.x;
+	observation.state[OBS_PADDLE_VELOCITY_Y] = paddleObj.pos.y - paddleObj.oldPos.y;
+	observation.state[OBS_SCORE] = static_cast<float>(gameState.score);
+	observation.state[OBS_LIVES] = static_cast<float>(gameState.lives);
+	observation.state[OBS_BALL_COUNT] = static_cast<float>(ballIds.size());
+
+	// The balls are in the order they were made, so each one keeps its place while it is in play
+	for (int ball = 0; ball < OBS_MAX_BALLS; ball++)
+	{
+		float* pBall{ observation.state + OBS_BALL_X + OBS_BALL_STRIDE * ball };
+		if (ball >= static_cast<int>(ballIds.size()))
+		{
+			std::fill(pBall, pBall + OBS_BALL_STRIDE, 0.f);
+			continue;
+		}
+
+		const GameObject& ballObj{ Play::GetGameObject(ballIds[ball]) };
+		pBall[OBS_BALL_X - OBS_BALL_X] = ballObj.pos.x;
+		pBall[OBS_BALL_Y - OBS_BALL_X] = ballObj.pos.y - gameState.cameraY;
+		pBall[OBS_BALL_VELOCITY_X - OBS_BALL_X] = ballObj.velocity.x;
+		pBall[OBS_BALL_VELOCITY_Y - OBS_BALL_X] = ballObj.velocity.y;
+	}
+	observation.chests = chestGrid.closed;
+	observation.done = gameState.state == STATE_GAMEOVER || gameState.state == STATE_WON;
+
+	if (!frame)
+		return;
+
+	// Headless games don't draw anything, so the frame is made by filling in the collision boxes
+	observation.frame.assign((static_cast<int>(DISPLAY_WIDTH) / ENVIRONMENT_FRAME_SCALE) * (static_cast<int>(DISPLAY_HEIGHT) / ENVIRONMENT_FRAME_SCALE), 0);
+
+	for (int row = chestGrid.layout.firstRow; row < chestGrid.layout.firstRow + chestGrid.layout.rows; row++)
+	{
+		for (int column = 0; column < GetChestColumns(row); column++)
+		{
+			if (IsChestClosed(row, column))
+				DrawObservationBox(observation, GetChestPos(row, column), CHEST_AABB, 128);
+		}
+	}
+
+	DrawObservationBox(observation, paddleObj.pos, PADDLE_AABB, 255);
+	for (int ball : ballIds)
+		DrawObservationBox(observation, Play::GetGameObject(ball).pos, BALL_AABB, 192);
+}
+
+// Fills a box (in world co-ordinates) in the observation's frame
+void DrawObservationBox(Observation& observation, Point2D pos, Vector2D halfSize, uint8_t shade)
+{
+	int width = static_cast<int>(DISPLAY_WIDTH) / ENVIRONMENT_FRAME_SCALE;
+	int height = static_cast<int>(DISPLAY_HEIGHT) / ENVIRONMENT_FRAME_SCALE;
+	pos.y -= gameState.cameraY;
+
+	int left = std::max(static_cast<int>(pos.x - halfSize.x) / ENVIRONMENT_FRAME_SCALE, 0);
+	int right = std::min(static_cast<int>(pos.x + halfSize.x) / ENVIRONMENT_FRAME_SCALE, width - 1);
+	int top = std::max(static_cast<int>(pos.y - halfSize.y) / ENVIRONMENT_FRAME_SCALE, 0);
+	int bottom = std::min(static_cast<int>(pos.y + halfSize.y) / ENVIRONMENT_FRAME_SCALE, height - 1);
+
+	for (int y = top; y <= bottom; y++)
+	{
+		for (int x = left; x <= right; x++)
+			observation.frame[y * width + x] = shade;
+	}
+}
+
+// Steps a batch of environments with random actions and reports the total steps per second
+void BenchmarkEnvironments()
+{
+	CreateEnvironments(environments.benchmarkGames, environments.frames);
+
+	std::vector<int> actions(environments.games.size());
+	std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+	for (int step = 0; step < environments.benchmarkSteps; step++)
+	{
+		for (int& action : actions)
+			action = Play::RandomRoll(3) - 1;
+		StepEnvironments(actions);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double steps = static_cast<double>(environments.benchmarkSteps) * environments.games.size();
+
+	char report[256];
+	sprintf_s(report, "Training: %zu environments stepped %d times in %.3f seconds (%.0f steps per second)\n", environments.games.size(), environments.benchmarkSteps, seconds, seconds > 0.0 ? steps / seconds : 0.0);
+	DebugOutput(report);
+	printf("%s", report);
+
+	DestroyEnvironments();
+}
+
+// Connects to the other versus game and starts the match (after SetupGame, so both games start from the same state)
+bool StartVersus()
+{
+	versus.pSocket = std::make_unique<PlaySocket>();
+	if (!versus.pSocket->Open(VERSUS_PORT + versus.player, VERSUS_PORT + 1 - versus.player))
+	{
+		DebugOutput("Versus: port " + std::to_string(VERSUS_PORT + versus.player) + " is already in use\n");
+		versus.pSocket.reset();
+		versus.enabled = false;
+		return false;
+	}
+
+	std::fill(std::begin(versus.remoteFrames), std::end(versus.remoteFrames), -1);
+
+	Play::SeedRandom(VERSUS_SEED);
+	StartGame();
+	gameState.state = STATE_PLAY;
+	return true;
+}
+
+// Plays the second player on the autopilot in its own context, sending its inputs a little late like a game on the other end of a network would
+void RunVersusStandIn(bool endless)
+{
+	Play::Context context;
+	Play::SetCurrentContext(&context);
+
+	gameState.endless = endless;
+	soakTest.autopilot = true;
+	versus.enabled = true;
+	versus.player = 1;
+	versus.sendDelay = VERSUS_STAND_IN_DELAY;
+	rewindEnabled = false;
+	SetupGame();
+
+	if (StartVersus())
+	{
+		// The stand-in doesn't draw anything, it just runs its updates at the normal rate
+		std::chrono::steady_clock::time_point next{ std::chrono::steady_clock::now() };
+		while (!versusStandIn.quit)
+		{
+			RunAutopilot();
+			ReadVersusInput();
+			UpdateVersus();
+
+			next += std::chrono::microseconds(1000000 / FRAMES_PER_SECOND);
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	Play::DestroyManager();
+	Play::SetCurrentContext(nullptr);
+}
+
+// Packs the local player's keys into this frame's input (from the keyboard, or whatever the autopilot or headless input pressed)
+void ReadVersusInput()
+{
+	versus.keyboard = !Play::IsScriptedInput();
+	versus.input = (Play::KeyDown(VK_LEFT) ? INPUT_LEFT : 0) | (Play::KeyDown(VK_RIGHT) ? INPUT_RIGHT : 0) | (Play::KeyDown(VK_SPACE) ? INPUT_START : 0);
+	versus.quit = Play::KeyDown(VK_ESCAPE);
+}
+
+// Called instead of UpdateGame in the versus mode: swaps inputs with the other game, rolls back if a prediction was wrong, then runs the next update
+bool UpdateVersus()
+{
+	ReceiveVersusInputs();
+
+	if (versus.rollbackFrame >= 0)
+		RollBackVersus();
+
+	// Wait for the other game rather than getting further ahead than a rollback can fix
+	if (versus.frame - versus.confirmedFrame >= VERSUS_MAX_ROLLBACK)
+	{
+		versus.stalls++;
+		SendVersusInputs();
+		return versus.quit;
+	}
+
+	versus.localInputs[versus.frame % VERSUS_HISTORY] = versus.input;
+	SimulateVersusFrame();
+	SendVersusInputs();
+	return versus.quit;
+}
+
+// Stores the inputs which have arrived from the other game, and notes the earliest update which ran with a wrong prediction
+void ReceiveVersusInputs()
+{
+	VersusMessage message;
+
+	while (versus.pSocket->Receive(&message, sizeof(message)) == sizeof(message))
+	{
+		for (int i = 0; i < std::min(static_cast<int>(message.count), VERSUS_REDUNDANCY); i++)
+		{
+			int frame = message.lastFrame - message.count + 1 + i;
+			int slot = frame % VERSUS_HISTORY;
+
+			// Skip inputs which are already known, or too far ahead to have a slot yet
+			if (frame < versus.confirmedFrame || frame >= versus.confirmedFrame + VERSUS_HISTORY - 1 || versus.remoteFrames[slot] == frame)
+				continue;
+
+			versus.remoteInputs[slot] = message.inputs[i];
+			versus.remoteFrames[slot] = frame;
+
+			if (frame < versus.frame && message.inputs[i] != versus.predictedInputs[slot] && (versus.rollbackFrame < 0 || frame < versus.rollbackFrame))
+				versus.rollbackFrame = frame;
+		}
+
+		if (message.checksumFrame > versus.remoteChecksumFrame)
+		{
+			versus.remoteChecksumFrame = message.checksumFrame;
+			versus.remoteChecksum = message.checksum;
+		}
+	}
+
+	while (versus.remoteFrames[versus.confirmedFrame % VERSUS_HISTORY] == versus.confirmedFrame)
+		versus.confirmedFrame++;
+}
+
+// Sends the latest local inputs, including ones already sent in case those messages were lost
+void SendVersusInputs()
+{
+	VersusMessage message;
+	message.lastFrame = versus.frame - 1 - versus.sendDelay;
+	if (message.lastFrame < 0)
+		return;
+
+	message.count = static_cast<uint8_t>(std::min(message.lastFrame + 1, VERSUS_REDUNDANCY));
+	for (int i = 0; i < message.count; i++)
+		message.inputs[i] = versus.localInputs[(message.lastFrame - message.count + 1 + i) % VERSUS_HISTORY];
+
+	// Any rollback has already been run by now, so the start of the latest update after the confirmed inputs is final
+	message.checksumFrame = std::min(versus.confirmedFrame, versus.frame - 1);
+	message.checksum = versus.checksums[message.checksumFrame % VERSUS_HISTORY];
+
+	versus.pSocket->Send(&message, sizeof(message));
+	CheckVersusSync();
+}
+
+// Compares the other game's checksum with this game's for the same update, once this game has confirmed it too
+void CheckVersusSync()
+{
+	int frame = versus.remoteChecksumFrame;
+	if (frame <= versus.checkedFrame || frame > std::min(versus.confirmedFrame, versus.frame - 1) || frame < versus.frame - VERSUS_HISTORY + 1)
+		return;
+
+	versus.checkedFrame = frame;
+	if (versus.remoteChecksum == versus.checksums[frame % VERSUS_HISTORY])
+		return;
+
+	// The games can't be brought back together, but at least it's reported
+	if (versus.desyncs++ == 0)
+		DebugOutput("Versus: the games went out of sync by update " + std::to_string(frame) + "\n");
+}
+
+// Hashes the state both versus games should have at the start of an update (FNV-1a)
+// > Only the game's own state is used, as the GameObjects also hold things like the frame they were drawn on which differ between the games
+uint32_t VersusChecksum()
+{
+	uint32_t hash = 2166136261u;
+	auto Add = [&hash](const void* pData, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ static_cast<const uint8_t*>(pData)[i]) * 16777619u;
+	};
+
+	int values[] = { gameState.state, gameState.lives, gameState.score, gameState.rivalScore, chestGrid.layout.firstRow, chestGrid.layout.remaining };
+	Add(values, sizeof(values));
+	Add(&gameState.cameraY, sizeof(gameState.cameraY));
+	Add(chestGrid.closed.data(), chestGrid.closed.size() * sizeof(uint64_t));
+
+	for (int type : { TYPE_PADDLE, TYPE_RIVAL_PADDLE, TYPE_BALL, TYPE_COIN })
+	{
+		for (int id : Play::CollectGameObjectIDsByType(type))
+		{
+			GameObject& obj{ Play::GetGameObject(id) };
+			Add(&id, sizeof(id));
+			Add(&obj.pos, sizeof(obj.pos));
+			Add(&obj.velocity, sizeof(obj.velocity));
+		}
+	}
+
+	return hash;
+}
+
+// Runs the next update with both players' inputs, predicting the other player's if it hasn't arrived yet
+void SimulateVersusFrame()
+{
+	int slot = versus.frame % VERSUS_HISTORY;
+	Play::TakeSnapshot(versus.snapshots[slot]);
+	versus.checksums[slot] = VersusChecksum();
+
+	// The prediction is that the other player is still pressing whatever they were in their last known input
+	uint8_t remote = 0;
+	if (versus.remoteFrames[slot] == versus.frame)
+		remote = versus.remoteInputs[slot];
+	else if (versus.confirmedFrame > 0)
+		remote = versus.remoteInputs[(versus.confirmedFrame - 1) % VERSUS_HISTORY];
+	versus.predictedInputs[slot] = remote;
+
+	uint8_t inputs[2];
+	inputs[versus.player] = versus.localInputs[slot];
+	inputs[1 - versus.player] = remote;
+
+	// The game reads both players' inputs as keys, so both games run exactly the same update
+	Play::SetScriptedInput(true);
+	Play::SetKeyState(VK_SPACE, (inputs[0] | inputs[1]) & INPUT_START);
+	Play::SetKeyState(VK_LEFT, inputs[0] & INPUT_LEFT);
+	Play::SetKeyState(VK_RIGHT, inputs[0] & INPUT_RIGHT);
+	Play::SetKeyState(RIVAL_KEY_LEFT, inputs[1] & INPUT_LEFT);
+	Play::SetKeyState(RIVAL_KEY_RIGHT, inputs[1] & INPUT_RIGHT);
+
+	// Each update (including the ones run again after a rollback) is a new frame as far as the GameObjects are concerned
+	Play::NextFrame();
+	UpdateGame();
+
+	Play::SetScriptedInput(!versus.keyboard);
+	versus.frame++;
+}
+
+// Goes back to the first update which ran with a wrong prediction, and runs every update since then again with the inputs now known
+void RollBackVersus()
+{
+	std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+	int target = versus.frame;
+	int frames = target - versus.rollbackFrame;
+
+	versus.frame = versus.rollbackFrame;
+	Play::RestoreSnapshot(versus.snapshots[versus.frame % VERSUS_HISTORY]);
+
+	versus.rollingBack = true;
+	while (versus.frame < target)
+		SimulateVersusFrame();
+	versus.rollingBack = false;
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	versus.rollbacks++;
+	versus.rerunFrames += frames;
+	versus.longestRollback = std::max(versus.longestRollback, frames);
+	versus.totalRollbackMs += ms;
+	versus.worstRollbackMs = std::max(versus.worstRollbackMs, ms);
+	versus.rollbackFrame = -1;
+}
+
+std::string GetVersusResult()
+{
+	if (gameState.score == gameState.rivalScore)
+		return "It's a draw";
+
+	return (gameState.score > gameState.rivalScore) ? "Player 1 wins" : "Player 2 wins";
+}
+
+// Called by PlayBuffer every frame (60 times a second!)
+bool MainGameUpdate(float elapsedTime)
+{
+	if (versus.enabled)
+		ReadVersusInput();
+
+	std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+
+	// The game logic runs at a fixed rate, so the game plays at the same speed however long each frame takes to draw
+	// > Each frame is drawn on another thread while the next frame's updates run
+	bool quit = Play::RunPipelined(elapsedTime, versus.enabled ? UpdateVersus : UpdateGame, DrawGame);
+
+	if (soakTest.enabled)
+		soakTest.frameMs.push_back(static_cast<float>(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()));
+
+	return quit;
+}
+
+// Called 60 times a second by RunFixedTimestep (several times in a row if drawing is falling behind)
+bool UpdateGame()
+{
+	switch (gameState.state)
+	{
+		case STATE_HELLO:
+		{
+			if (Play::KeyDown(VK_SPACE))
+			{
+				StartGame();
+				gameState.state = STATE_PLAY;
+				soakTest.checkSession = true;
+			}
+			break;
+		}
+		case STATE_PLAY:
+		{
+			if (RewindGame())
+				break;
+
+			std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+			if (gameState.endless)
+				ScrollChestGrid();
+			UpdateBalls();
+			RecordTiming(TIMING_BALLS, start);
+			UpdatePaddle();
+			RecordTiming(TIMING_PADDLE, start);
+			UpdateCoins();
+			RecordTiming(TIMING_COINS, start);
+			HandleCollisions();
+			RecordTiming(TIMING_COLLISIONS, start);
+			RecordRewindFrame();
+			RecordTiming(TIMING_SNAPSHOT, start);
+			UpdatePlayerControls();
+			ReportTimings();
+			break;
+		}
+		case STATE_GAMEOVER:
+		case STATE_WON:
+		{
+			if (Play::KeyDown(VK_SPACE))
+				RestartAndRestore();
+			else
+				RewindGame();
+			break;
+		}
+		case STATE_PAUSED:
+		{
+			if (Play::KeyDown(VK_SPACE))	
+				gameState.state = STATE_PLAY;
+			if (Play::KeyDown(VK_TAB))
+				RestartAndRestore();
+			break;
+		}
+	}
+	
+	UpdateDestroyed();
+	SoundControl();
+
+	if (soakTest.enabled && UpdateSoakTest())
+		return true;
+
+	return Play::KeyDown(VK_ESCAPE);
+}
+
+// Called once per frame after the updates to record what to draw (the interpolation is used by DrawObject to smooth out movement between updates)
+void DrawGame(Play::RenderSnapshot& frame, float interpolation)
+{
+	switch (gameState.state)
+	{
+		case STATE_HELLO:
+		{
+			DrawHello(frame);
+			break;
+		}
+		case STATE_PLAY:
+		{
+			std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+			DrawGamePlay(frame, interpolation);
+			RecordTiming(TIMING_DRAW, start);
+			break;
+		}
+		case STATE_GAMEOVER:
+		{
+			DrawGameOver(frame);
+			break;
+		}
+		case STATE_WON:
+		{
+			DrawGameWon(frame);
+			break;
+		}
+		case STATE_PAUSED:
+		{
+			DrawGamePaused(frame);
+			break;
+		}
+	}
+}
+
+// Sets the keys for each frame of a headless run (there is no keyboard or drawing, so this is just the game logic)
+void HeadlessInput(int frame)
+{
+	// Start (or restart) a game every 10 seconds and sweep the paddle from side to side in between
+	Play::SetKeyState(VK_SPACE, frame % 600 == 0);
+	Play::SetKeyState(VK_LEFT, (frame / 45) % 2 == 0);
+	Play::SetKeyState(VK_RIGHT, (frame / 45) % 2 == 1);
+}
+
+// Switches to scripted input and presses the keys for this frame's autopilot input
+void RunAutopilot()
+{
+	Play::SetScriptedInput(true);
+	AutopilotInput(soakTest.autopilotFrame++);
+}
+
+// Presses the arrow keys to keep the paddle under the balls, and space to start the next game after each one ends
+void AutopilotInput(int frame)
+{
+	bool playing = gameState.state == STATE_PLAY;
+	Play::SetKeyState(VK_SPACE, !playing && frame % 60 == 0);
+	Play::SetKeyState(VK_LEFT, false);
+	Play::SetKeyState(VK_RIGHT, false);
+
+	if (!playing)
+		return;
+
+	GameObject& paddleObj{ Play::GetGameObjectByType(versus.player == 1 ? TYPE_RIVAL_PADDLE : TYPE_PADDLE) };
+	std::vector<int> ballIds{ Play::CollectGameObjectIDsByType(TYPE_BALL) };
+
+	// Follow whichever falling ball will reach the paddle first (or the lowest ball if none are falling)
+	float targetX = paddleObj.pos.x;
+	float nearest = FLT_MAX;
+	float lowest = -FLT_MAX;
+
+	for (int ball : ballIds)
+	{
+		GameObject& ballObj{ Play::GetGameObject(ball) };
+		float distance = paddleObj.pos.y - ballObj.pos.y;
+
+		if (ballObj.velocity.y > 0.f && distance >= 0.f && distance < nearest)
+		{
+			nearest = distance;
+			targetX = ballObj.pos.x;
+		}
+		else if (nearest == FLT_MAX && ballObj.pos.y > lowest)
+		{
+			lowest = ballObj.pos.y;
+			targetX = ballObj.pos.x;
+		}
+	}
+
+	Play::SetKeyState(VK_LEFT, targetX < paddleObj.pos.x - AUTOPILOT_DEADZONE);
+	Play::SetKeyState(VK_RIGHT, targetX > paddleObj.pos.x + AUTOPILOT_DEADZONE);
+}
+
+// Called after every soak test update, and returns true once the test has run for long enough
+bool UpdateSoakTest()
+{
+	soakTest.updates++;
+
+	if (soakTest.checkSession)
+	{
+		CheckSoakSession();
+		soakTest.checkSession = false;
+	}
+
+	if (soakTest.updates % SOAK_REPORT_INTERVAL == 0)
+		ReportSoakInterval();
+
+	return soakTest.updates >= soakTest.minutes * SOAK_REPORT_INTERVAL;
+}
+
+// Every game starts with the same objects, so anything extra at the start of a session has leaked from an earlier one
+// > Coins from the last game may still be falling, so they aren't counted
+void CheckSoakSession()
+{
+	soakTest.sessions++;
+
+	int objects = static_cast<int>(Play::CollectAllGameObjectIDs().size() - Play::CollectGameObjectIDsByType(TYPE_COIN).size());
+	size_t bytes = GetAllocatedBytes();
+
+	if (soakTest.baselineObjects < 0)
+	{
+		soakTest.baselineObjects = objects;
+		soakTest.baselineBytes = bytes;
+		return;
+	}
+
+	if (objects > soakTest.baselineObjects)
+		FlagDrift(std::to_string(objects - soakTest.baselineObjects) + " GameObjects have leaked by session " + std::to_string(soakTest.sessions));
+
+	// The heap is only tracked in debug builds (GetAllocatedBytes is always 0 in release)
+	if (bytes > soakTest.baselineBytes + soakTest.baselineBytes / 4 + 65536)
+		FlagDrift("the heap has grown from " + std::to_string(soakTest.baselineBytes) + " to " + std::to_string(bytes) + " bytes by session " + std::to_string(soakTest.sessions));
+}
+
+// Reports the frame time percentiles, object count and heap usage for the last minute, and compares them with the first minute
+void ReportSoakInterval()
+{
+	if (soakTest.frameMs.empty())
+		return;
+
+	int minute = soakTest.updates / SOAK_REPORT_INTERVAL;
+	float p50 = Percentile(soakTest.frameMs, 0.5f);
+	float p95 = Percentile(soakTest.frameMs, 0.95f);
+	float p99 = Percentile(soakTest.frameMs, 0.99f);
+	float max = Percentile(soakTest.frameMs, 1.f);
+	soakTest.frameMs.clear();
+
+	char report[256];
+	sprintf_s(report, "Soak %d min: %d sessions, frame ms p50 %.3f p95 %.3f p99 %.3f max %.3f, %d objects, %u allocations (%zu bytes)\n",
+		minute, soakTest.sessions, p50, p95, p99, max, static_cast<int>(Play::CollectAllGameObjectIDs().size()), GetAllocationCount(), GetAllocatedBytes());
+	DebugOutput(report);
+
+	if (minute == 1)
+		soakTest.baselineP95 = p95;
+	else if (p95 > soakTest.baselineP95 * 1.5f + 0.25f)
+		FlagDrift("frame times have crept up (p95 " + std::to_string(p95) + "ms, was " + std::to_string(soakTest.baselineP95) + "ms)");
+}
+
+void FlagDrift(const std::string& message)
+{
+	soakTest.drifts++;
+	std::string warning{ "SOAK DRIFT: " + message + "\n" };
+	DebugOutput(warning);
+	printf("%s", warning.c_str());
+}
+
+// Gets the value a fraction of the way through the sorted values (which are reordered)
+float Percentile(std::vector<float>& values, float fraction)
+{
+	size_t index = std::min(static_cast<size_t>(fraction * values.size()), values.size() - 1);
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+// Gets called once when the player quits the game 
+int MainGameExit(void)
+{
+	for (std::thread& thread : batchRun.threads)
+		thread.join();
+
+	if (versusStandIn.thread.joinable())
+	{
+		versusStandIn.quit = true;
+		versusStandIn.thread.join();
+	}
+
+	if (versus.enabled)
+	{
+		char summary[256];
+		sprintf_s(summary, "Versus summary: %d updates, %d rollbacks re-ran %d updates (longest %d), %.3fms average and %.3fms worst per rollback, %d stalls, %d desyncs\n",
+			versus.frame, versus.rollbacks, versus.rerunFrames, versus.longestRollback, versus.rollbacks > 0 ? versus.totalRollbackMs / versus.rollbacks : 0.0, versus.worstRollbackMs, versus.stalls, versus.desyncs);
+		DebugOutput(summary);
+		printf("%s", summary);
+	}
+
+	if (soakTest.enabled)
+	{
+		std::string summary{ "Soak summary: " + std::to_string(soakTest.updates / SOAK_REPORT_INTERVAL) + " minutes, " + std::to_string(soakTest.sessions) + " sessions, " + std::to_string(soakTest.drifts) + " drift warnings\n" };
+		DebugOutput(summary);
+		printf("%s", summary.c_str());
+	}
+
+	if (stressConfig.enabled && frameTimings.totalUpdates > 0)
+	{
+		// Print the average for the whole run (headless runs print this to the console)
+		std::string summary{ "Stress summary (" + std::to_string(frameTimings.totalUpdates) + " updates):" };
+
+		for (int i = 0; i < TIMING_COUNT; i++)
+			summary += " " + std::string(TIMING_NAMES[i]) + " " + std::to_string(frameTimings.totalMs[i] / frameTimings.totalUpdates) + "ms";
+
+		summary += "\n";
+		DebugOutput(summary);
+		printf("%s", summary.c_str());
+	}
+
+	if (!frameCapturePath.empty())
+	{
+		PlayFrameCapture::Stats capture{ Play::StopFrameCapture() };
+		char summary[128];
+		sprintf_s(summary, "Capture summary: %d frames captured, %d written, %d dropped, %d failed to write\n", capture.captured, capture.written, capture.dropped, capture.failed);
+		DebugOutput(summary);
+		printf("%s", summary);
+	}
+
+	Play::DestroyManager();
+	return PLAY_OK; 
+}
+
+void ParseCommandLine(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-endless") == 0)
+			gameState.endless = true;
+		if (strcmp(argv[i], "-autopilot") == 0)
+			soakTest.autopilot = true;
+		if (strcmp(argv[i], "-soak") == 0 && i < argc - 1)
+		{
+			soakTest.enabled = true;
+			soakTest.autopilot = true;
+			soakTest.minutes = std::max(atoi(argv[i + 1]), 1);
+			soakTest.frameMs.reserve(SOAK_REPORT_INTERVAL);
+		}
+		if (strcmp(argv[i], "-batch") == 0 && i < argc - 2)
+		{
+			batchRun.games = std::max(atoi(argv[i + 1]), 0);
+			batchRun.frames = std::max(atoi(argv[i + 2]), 1);
+		}
+		if (strcmp(argv[i], "-train") == 0 && i < argc - 2)
+		{
+			environments.benchmarkGames = std::max(atoi(argv[i + 1]), 1);
+			environments.benchmarkSteps = std::max(atoi(argv[i + 2]), 1);
+		}
+		if (strcmp(argv[i], "-trainframes") == 0)
+			environments.frames = true;
+		if (strcmp(argv[i], "-exportframes") == 0 && i < argc - 1)
+			frameExportName = argv[i + 1];
+		if ((strcmp(argv[i], "-capture") == 0 || strcmp(argv[i], "-capturevideo") == 0) && i < argc - 1)
+		{
+			frameCapturePath = argv[i + 1];
+			frameCaptureFormat = (strcmp(argv[i], "-capturevideo") == 0) ? PlayFrameCapture::CAPTURE_VIDEO : PlayFrameCapture::CAPTURE_PNG;
+		}
+		if (strcmp(argv[i], "-dynamicres") == 0 && i < argc - 1)
+			dynamicResolutionBudget = std::max(static_cast<float>(atof(argv[i + 1])), 0.f);
+		if (strcmp(argv[i], "-versus") == 0 && i < argc - 1)
+		{
+			versus.enabled = true;
+			versus.standIn = strcmp(argv[i + 1], "local") == 0;
+			versus.player = versus.standIn ? 0 : std::clamp(atoi(argv[i + 1]), 1, 2) - 1;
+			// Rolling back only needs the last few snapshots, not the rewind history
+			rewindEnabled = false;
+		}
+	}
+
+	for (int i = 1; i < argc - 4; i++)
+	{
+		if (strcmp(argv[i], "-stress") == 0)
+		{
+			stressConfig.enabled = true;
+			stressConfig.ballCount = std::max(atoi(argv[i + 1]), 1);
+			stressConfig.chestRows = std::max(atoi(argv[i + 2]), 1);
+			stressConfig.chestColumns = std::max(atoi(argv[i + 3]), 2);
+			stressConfig.coinDropPercent = std::clamp(atoi(argv[i + 4]), 0, 100);
+		}
+	}
+}
+
+// Adds the time since start to a section of the frame, and restarts the clock for the next one
+void RecordTiming(TimingSection section, std::chrono::steady_clock::time_point& start)
+{
+	std::chrono::steady_clock::time_point end{ std::chrono::steady_clock::now() };
+	frameTimings.sectionMs[section] += std::chrono::duration<double, std::milli>(end - start).count();
+	start = end;
+}
+
+// Averages the section timings over the last second of updates and reports them
+void ReportTimings()
+{
+	if (!stressConfig.enabled)
+		return;
+
+	frameTimings.updates++;
+	frameTimings.totalUpdates++;
+
+	if (frameTimings.updates < TIMING_REPORT_INTERVAL)
+		return;
+
+	frameTimings.report = std::to_string(Play::CollectGameObjectIDsByType(TYPE_BALL).size()) + " balls, "
+		+ std::to_string(chestGrid.layout.remaining) + " chests, "
+		+ std::to_string(Play::CollectGameObjectIDsByType(TYPE_COIN).size()) + " coins:";
+
+	for (int i = 0; i < TIMING_COUNT; i++)
+	{
+		char section[64];
+		sprintf_s(section, " %s %.3fms", TIMING_NAMES[i], frameTimings.sectionMs[i] / frameTimings.updates);
+		frameTimings.report += section;
+
+		frameTimings.totalMs[i] += frameTimings.sectionMs[i];
+		frameTimings.sectionMs[i] = 0;
+	}
+
+	if (!PlayWindow::IsHeadless() && Play::GetResolutionDivisor() > 1)
+		frameTimings.report += " at 1/" + std::to_string(Play::GetResolutionDivisor()) + " resolution";
+
+	frameTimings.updates = 0;
+	DebugOutput("Stress: " + frameTimings.report + "\n");
+}
+
+void SoundControl()
+{
+	if (Play::KeyPressed(VK_F2))
+		audioSettings.sound = !audioSettings.sound;
+
+	if (Play::KeyPressed(VK_F3))
+	{
+		audioSettings.music = !audioSettings.music;
+
+		(audioSettings.music) ? Play::StartAudioLoop("music") : Play::StopAudioLoop("music");
+	}	
+}
+
+void StartGame()
+{
+	// Create the balls and a paddle object
+	for (int i = 0; i < stressConfig.ballCount; i++)
+	{
+		GameObject& ballObj{ Play::GetGameObject(Play::CreateGameObject(TYPE_BALL, { (DISPLAY_WIDTH / 2) - 200, DISPLAY_HEIGHT / 2 }, BALL_RADIUS, "ball")) };
+		// ... "ball", "spanner" etc. are the filenames of sprites stored in the Data folder alongside this solution, you can put any .PNGs in there if you feel creative :)
+
+		// Set initial velocity for ball
+		ballObj.velocity = BALL_VELOCITY_DEFAULT;
+		ballObj.acceleration = BALL_ACCELERATION;
+		ballObj.aabb = BALL_AABB;
 
-void SoundControl();
+		// Scatter any extra balls below the chests, heading off in different directions
+		if (i > 0)
+		{
+			ballObj.pos = Point2D(Play::RandomRollRange(BALL_RADIUS, static_cast<int>(DISPLAY_WIDTH) - BALL_RADIUS), Play::RandomRollRange(static_cast<int>(DISPLAY_HEIGHT / 2), static_cast<int>(DISPLAY_HEIGHT / 2) + 100));
+			ballObj.velocity.x *= (Play::RandomRoll(2) == 1) ? -1.f : 1.f;
+			ballObj.velocity.y = Play::RandomRollRange(-3, 3);
+			Play::UpdateSpatialIndex(ballObj);
+		}
+	}
 
-void DrawHello();
-void DrawGameOver();
-void DrawGamePlay();
-void DrawGamePaused();
-void DrawGameWon();
-void DrawSoundControl();
+	// The versus mode's paddles start a third of the way in from each side
+	GameObject& paddleObj{ Play::GetGameObject(Play::CreateGameObject(TYPE_PADDLE, { versus.enabled ? DISPLAY_WIDTH / 3 : DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 100 }, BALL_RADIUS, "spanner")) };
+	paddleObj.aabb = PADDLE_AABB;
 
-void StartGame();
-void RestartAndRestore();
+	if (versus.enabled)
+	{
+		GameObject& rivalObj{ Play::GetGameObject(Play::CreateGameObject(TYPE_RIVAL_PADDLE, { DISPLAY_WIDTH * 2 / 3, DISPLAY_HEIGHT - 100 }, BALL_RADIUS, "spanner")) };
+		rivalObj.aabb = PADDLE_AABB;
+	}
 
-void UpdateCoins();
-void UpdateBall();
-void UpdatePaddle();
-void ResetBall();
-void UpdatePlayerControls();
-void UpdateDestroyed();
+	gameState.cameraY = 0.f;
+	gameState.previousCameraY = 0.f;
+	CreateChestGrid(stressConfig.chestRows, stressConfig.chestColumns);
+}
 
-void RestartGame();
-void DestroyObjects();
+// Adds the state at the end of this update to the rewind history
+void RecordRewindFrame()
+{
+	if (!rewindEnabled)
+		return;
 
-bool IsWinning();
-bool isPaddleColliding(const GameObject& object);
-bool IsBallColliding(const GameObject& object);
-void ChestCollision();
-void PaddleCollision();
+	Play::TakeSnapshot(rewindSnapshot);
+	rewindHistory.Push(rewindSnapshot);
+}
 
-void CalculateMinMax(const GameObject& object, float& minX, float& maxX, float& minY, float& maxY);
-void RedirectBall(const GameObject& object);
-void AdjustBallAndPaddle();
+// Steps the game back through the rewind history while backspace is held (which also works after losing the last life)
+// > Returns true if the game was rewound instead of updated
+bool RewindGame()
+{
+	if (!Play::KeyDown(VK_BACK) || !rewindHistory.Rewind(REWIND_SPEED, rewindSnapshot))
+		return false;
 
-// The entry point for a PlayBuffer program
-void MainGameEntry(PLAY_IGNORE_COMMAND_LINE)
+	Play::RestoreSnapshot(rewindSnapshot);
+	return true;
+}
+
+// The chests are laid out like bricks, with every other row shifted by half a chest and one chest shorter
+void CreateChestGrid(int rows, int columns)
 {
-	// Setup PlayBuffer
-	Play::CreateManager(DISPLAY_WIDTH, DISPLAY_HEIGHT, DISPLAY_SCALE);
-	Play::LoadBackground("Data\\Backgrounds\\background.png");
-	Play::CentreAllSpriteOrigins(); // this function makes it so that obj.pos values represent the center of a sprite instead of its top-left corner
+	chestGrid.layout.columns = columns;
+	chestGrid.layout.wordsPerRow = (columns + 63) / 64;
+	chestGrid.layout.origin = Point2D(gameState.offsetX, gameState.offsetY);
+
+	// The spacing shrinks to fit the stress mode's bigger grids on the top half of the screen
+	chestGrid.layout.spacing.x = std::min(CHEST_SPACING * 2.f + 1.f, (DISPLAY_WIDTH - gameState.offsetX * 2.f) / (columns - 1));
+	chestGrid.layout.spacing.y = std::min(static_cast<float>(CHEST_SPACING), (DISPLAY_HEIGHT / 2 - gameState.offsetY) / rows);
+
+	// The endless mode only keeps enough rows to cover the screen, with the ones above it waiting to scroll into view
+	// > A new row is made as soon as the top row is within a row of the screen, so the row it replaces can be as little as rows - 2 rows below the top of the screen
+	// > That row's chests (and any ball touching them) have to be completely below the screen by then, or they would vanish in view
+	chestGrid.layout.rows = rows;
+	chestGrid.layout.firstRow = 0;
+	if (gameState.endless)
+	{
+		chestGrid.layout.rows = static_cast<int>(std::ceil((DISPLAY_HEIGHT + CHEST_AABB.y + BALL_AABB.y) / chestGrid.layout.spacing.y)) + 2;
+		chestGrid.layout.firstRow = rows - chestGrid.layout.rows;
+	}
 
-	DrawHello();		
+	chestGrid.closed.assign(chestGrid.layout.rows * chestGrid.layout.wordsPerRow, 0);
+	chestGrid.hitsLeft.assign(chestGrid.layout.rows * columns, 0);
+	chestGrid.layout.remaining = 0;
+
+	for (int row = chestGrid.layout.firstRow; row < chestGrid.layout.firstRow + chestGrid.layout.rows; row++)
+		FillChestRow(row);
 }
 
-// Called by PlayBuffer every frame (60 times a second!)
-bool MainGameUpdate(float elapsedTime)
+// Puts a new row of chests in the slot of the ring it belongs to, replacing whatever row was there
+void FillChestRow(int row)
 {
-	switch (gameState.state)
+	int slot = GetChestSlot(row);
+
+	for (int column = 0; column < chestGrid.layout.columns; column++)
 	{
-		case STATE_HELLO:
-		{
-			DrawHello();
-			if (Play::KeyDown(VK_SPACE))
-			{
-				StartGame();
-				DrawGamePlay();
-				gameState.state = STATE_PLAY;
-			}
-			break;
-		}
-		case STATE_PLAY:
-		{
-			UpdateBall();
-			UpdatePaddle();
-			UpdateCoins();
-			UpdatePlayerControls();					
-			DrawGamePlay();
-			break;
-		}
-		case STATE_GAMEOVER:
-		{
-			DrawGameOver();
+		uint64_t& bits = chestGrid.closed[slot * chestGrid.layout.wordsPerRow + column / 64];
 
-			if (Play::KeyDown(VK_SPACE))
-				RestartAndRestore();
-			break;
-		}
-		case STATE_WON:
-		{
-			DrawGameWon();
+		if ((bits >> (column % 64)) & 1)
+			chestGrid.layout.remaining--;
 
-			if (Play::KeyDown(VK_SPACE))
-				RestartAndRestore();
-			break;
-		}
-		case STATE_PAUSED:
-		{
-			DrawGamePaused();
+		bits &= ~(1ull << (column % 64));
 
-			if (Play::KeyDown(VK_SPACE))	
-				gameState.state = STATE_PLAY;
-			if (Play::KeyDown(VK_TAB))
-				RestartAndRestore();
-			break;
+		// The endless mode's rows have gaps in them, but the normal game's rows are full
+		if (column < GetChestColumns(row) && (!gameState.endless || Play::RandomRoll(100) <= ENDLESS_CHEST_PERCENT))
+		{
+			bits |= 1ull << (column % 64);
+			chestGrid.hitsLeft[slot * chestGrid.layout.columns + column] = CHEST_HITS;
+			chestGrid.layout.remaining++;
 		}
 	}
-	
-	UpdateDestroyed();
-	SoundControl();
-	return Play::KeyDown(VK_ESCAPE);
 }
 
-// Gets called once when the player quits the game 
-int MainGameExit(void)
+// Moves the camera up and makes new rows above the screen from the ones which have gone off the bottom
+void ScrollChestGrid()
 {
-	Play::DestroyManager();
-	return PLAY_OK; 
-}
+	gameState.previousCameraY = gameState.cameraY;
+	gameState.cameraY -= ENDLESS_SCROLL_SPEED;
 
-void SoundControl()
-{
-	if (Play::KeyPressed(VK_F2))
-		gameState.sound = !gameState.sound;
+	// The bottom row is always completely below the screen by the time the top row is about to come into view (see CreateChestGrid)
+	while (GetChestPos(chestGrid.layout.firstRow, 0).y > gameState.cameraY - chestGrid.layout.spacing.y)
+	{
+		chestGrid.layout.firstRow--;
+		FillChestRow(chestGrid.layout.firstRow);
+	}
 
-	if (Play::KeyPressed(VK_F3))
+	// Everything moves back down every so often, so the co-ordinates (and the precision of the floats) stay the same however long the game runs
+	// > The rows are renumbered by two whole rings, so every row keeps its slot in the ring and whether it is shifted by half a chest
+	int rebaseRows = chestGrid.layout.rows * 2;
+	float rebaseDistance = rebaseRows * chestGrid.layout.spacing.y;
+	if (gameState.cameraY <= -rebaseDistance)
 	{
-		gameState.music = !gameState.music;
+		gameState.cameraY += rebaseDistance;
+		gameState.previousCameraY += rebaseDistance;
+		chestGrid.layout.firstRow += rebaseRows;
+		Play::MoveAllGameObjects({ 0.f, rebaseDistance });
+	}
+}
 
-		(gameState.music) ? Play::StartAudioLoop("music") : Play::StopAudioLoop("music");
-	}	
+// Gets where a row is stored in the ring (rows above the starting grid have negative numbers)
+int GetChestSlot(int row)
+{
+	return ((row % chestGrid.layout.rows) + chestGrid.layout.rows) % chestGrid.layout.rows;
 }
 
-void StartGame()
+int GetChestColumns(int row)
 {
-	// Create a ball object and a paddle object
-	Play::CreateGameObject(TYPE_BALL, { (DISPLAY_WIDTH / 2) - 200, DISPLAY_HEIGHT / 2 }, BALL_RADIUS, "ball");
-	Play::CreateGameObject(TYPE_PADDLE, { DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 100 }, BALL_RADIUS, "spanner");
-	// ... "ball", "spanner" etc. are the filenames of sprites stored in the Data folder alongside this solution, you can put any .PNGs in there if you feel creative :)
+	return chestGrid.layout.columns - (row & 1);
+}
 
-	// Set initial velocity for ball
-	GameObject& ballObj = Play::GetGameObjectByType(TYPE_BALL);
-	ballObj.velocity = BALL_VELOCITY_DEFAULT;
-	ballObj.acceleration = BALL_ACCELERATION;
+bool IsChestClosed(int row, int column)
+{
+	return (chestGrid.closed[GetChestSlot(row) * chestGrid.layout.wordsPerRow + column / 64] >> (column % 64)) & 1;
+}
 
-	for (int i = 1; i < 3; i++)
-	{
-		for (int j = 0; j < 7; j++)
-		{
-			gameState.x = (CHEST_SPACING * gameState.xCount) + gameState.offsetX + CHEST_SPACING * j + gameState.xCount;
-			gameState.y = gameState.yCount + gameState.offsetY;
+Point2D GetChestPos(int row, int column)
+{
+	return Point2D(chestGrid.layout.origin.x + chestGrid.layout.spacing.x * column + (row & 1) * (chestGrid.layout.spacing.x / 2), chestGrid.layout.origin.y + chestGrid.layout.spacing.y * row);
+}
 
-			if (j == 6 && gameState.yCount > 0)
-				break;
-				
-			Play::CreateGameObject(TYPE_CHEST, { gameState.x, gameState.y }, 10, "box");
-			gameState.xCount++;
+// Gets the row whose chests are nearest to a height on the screen (which may be outside the grid)
+int GetChestRow(float y)
+{
+	return static_cast<int>(std::floor((y - chestGrid.layout.origin.y) / chestGrid.layout.spacing.y + 0.5f));
+}
 
-			if (j == 6)
-			{
-				gameState.yCount += CHEST_SPACING;
-				gameState.xCount = 1;
-			}
-		}
-	}
+// Gets the column in a row whose chest is nearest to a position across the screen (which may be outside the grid)
+int GetChestColumn(int row, float x)
+{
+	return static_cast<int>(std::floor((x - chestGrid.layout.origin.x - (row & 1) * (chestGrid.layout.spacing.x / 2)) / chestGrid.layout.spacing.x + 0.5f));
 }
 
 void RestartAndRestore()
 {
 	RestartGame();
-	DrawGamePlay();
 	gameState.lives = 3;
 	gameState.state = STATE_PLAY;
+	soakTest.checkSession = true;
+
+	// There's nothing to go back to at the start of a new game (losing a life can still be rewound)
+	rewindHistory.Clear();
 }
 
-void DrawHello()
+void DrawHello(Play::RenderSnapshot& frame)
 {
-	Play::ClearDrawingBuffer(Play::cWhite);
-	Play::DrawBackground();
-	Play::DrawFontText("64px", "Welcome to Bouncy Game !", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
-	Play::DrawFontText("64px", "Press space to start a game || shift to pause", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
-	Play::DrawFontText("64px", "Press F2 for Sound || F3 for Music", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 200), Play::CENTRE);
-	DrawSoundControl();
-	Play::PresentDrawingBuffer();
+	frame.ClearDrawingBuffer(Play::cWhite);
+	frame.DrawBackground();
+	frame.DrawFontText("64px", "Welcome to Bouncy Game !", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
+	frame.DrawFontText("64px", "Press space to start a game || shift to pause", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
+	frame.DrawFontText("64px", "Press F2 for Sound || F3 for Music", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 200), Play::CENTRE);
+	DrawSoundControl(frame);
 }
 
-void DrawGamePaused()
+void DrawGamePaused(Play::RenderSnapshot& frame)
 {
-	Play::ClearDrawingBuffer(Play::cWhite);
-	Play::DrawBackground();
-	Play::DrawFontText("64px", "PAUSED", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
-	Play::DrawFontText("64px", "Press Space to Continue", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
-	Play::DrawFontText("64px", "Press TAB to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 200), Play::CENTRE);
-	DrawSoundControl();
-	Play::PresentDrawingBuffer();
+	frame.ClearDrawingBuffer(Play::cWhite);
+	frame.DrawBackground();
+	frame.DrawFontText("64px", "PAUSED", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
+	frame.DrawFontText("64px", "Press Space to Continue", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
+	frame.DrawFontText("64px", "Press TAB to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 200), Play::CENTRE);
+	DrawSoundControl(frame);
 }
 
-void DrawGameWon()
+void DrawGameWon(Play::RenderSnapshot& frame)
 {
-	Play::ClearDrawingBuffer(Play::cWhite);
-	Play::DrawBackground();
-	Play::DrawFontText("64px", "YOU WON !!!", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
-	Play::DrawFontText("64px", "Press Space to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
-	Play::DrawFontText("64px", "Highscore: " + std::to_string(gameState.score), Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 300), Play::CENTRE);
-	DrawSoundControl();
-	Play::PresentDrawingBuffer();
+	frame.ClearDrawingBuffer(Play::cWhite);
+	frame.DrawBackground();
+	frame.DrawFontText("64px", "YOU WON !!!", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
+	frame.DrawFontText("64px", "Press Space to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
+	frame.DrawFontText("64px", versus.enabled ? GetVersusResult() : "Highscore: " + std::to_string(gameState.score), Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 300), Play::CENTRE);
+	DrawSoundControl(frame);
 }
 
-void DrawGameOver()
+void DrawGameOver(Play::RenderSnapshot& frame)
 {
-	Play::ClearDrawingBuffer(Play::cWhite);
-	Play::DrawBackground();
-	Play::DrawFontText("64px", "GAME OVER", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
-	Play::DrawFontText("64px", "Press Space to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
-	DrawSoundControl();
-	Play::PresentDrawingBuffer();
+	frame.ClearDrawingBuffer(Play::cWhite);
+	frame.DrawBackground();
+	frame.DrawFontText("64px", "GAME OVER", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2), Play::CENTRE);
+	frame.DrawFontText("64px", "Press Space to Restart", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 100), Play::CENTRE);
+	frame.DrawFontText("64px", versus.enabled ? GetVersusResult() : "Hold Backspace to rewind", Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2 + 200), Play::CENTRE);
+	DrawSoundControl(frame);
 }
 
-void DrawGamePlay()
+void DrawGamePlay(Play::RenderSnapshot& frame, float interpolation)
 {
-	Play::ClearDrawingBuffer(Play::cWhite);
-	Play::DrawBackground();
+	frame.ClearDrawingBuffer(Play::cWhite);
+	frame.DrawBackground();
+
+	// The camera only moves in the endless mode, and is smoothed between updates like the objects
+	frame.SetCameraPosition(Point2D(0.f, gameState.previousCameraY + (gameState.cameraY - gameState.previousCameraY) * interpolation));
+
 	// Draw the 'paddle'
-	Play::DrawObject(Play::GetGameObjectByType(TYPE_PADDLE));
+	frame.DrawObject(Play::GetGameObjectByType(TYPE_PADDLE));
 
 	// Draw the AABB box for our paddle
 	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
-	Play::DrawRect(paddleObj.pos - PADDLE_AABB, paddleObj.pos + PADDLE_AABB, Play::cWhite);
+	frame.DrawRect(paddleObj.pos - PADDLE_AABB, paddleObj.pos + PADDLE_AABB, Play::cWhite);
 
-	// Draw the ball. This version of the function is slower, but uses the rotation variable stored in GameObjects.
-	Play::DrawObjectRotated(Play::GetGameObjectByType(TYPE_BALL));
+	if (versus.enabled)
+	{
+		GameObject& rivalObj{ Play::GetGameObjectByType(TYPE_RIVAL_PADDLE) };
+		frame.DrawObject(rivalObj);
+		frame.DrawRect(rivalObj.pos - PADDLE_AABB, rivalObj.pos + PADDLE_AABB, Play::cWhite);
+	}
 
-	std::vector<int> chestIds{ Play::CollectGameObjectIDsByType(TYPE_CHEST) };
+	// Draw the balls. This version of the function is slower, but uses the rotation variable stored in GameObjects.
+	std::vector<int> ballIds{ Play::CollectGameObjectIDsByType(TYPE_BALL) };
 
-	for (int chest : chestIds)
+	for (int ball : ballIds)
 	{
-		Play::DrawObject(Play::GetGameObject(chest));
+		frame.DrawObjectRotated(Play::GetGameObject(ball));
 	}
 
-	GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
-	//Play::DrawRect(ballObj.pos - BALL_AABB, ballObj.pos + BALL_AABB, Play::cWhite);
+	DrawChests(frame);
 
 	std::vector<int> coinIds{ Play::CollectGameObjectIDsByType(TYPE_COIN) };
 
 	for (int coin : coinIds)
 	{
-		Play::DrawObjectRotated(Play::GetGameObject(coin));
+		frame.DrawObjectRotated(Play::GetGameObject(coin));
+	}
+
+	// Everything else stays put on the screen
+	frame.SetCameraPosition(Point2D(0.f, 0.f));
+
+	if (versus.enabled)
+	{
+		frame.DrawFontText("64px", "Player 1: " + std::to_string(gameState.score), Point2D(DISPLAY_WIDTH / 3, 50), Play::CENTRE);
+		frame.DrawFontText("64px", "Player 2: " + std::to_string(gameState.rivalScore), Point2D(DISPLAY_WIDTH * 2 / 3, 50), Play::CENTRE);
+	}
+
+	if (stressConfig.enabled)
+	{
+		DrawTimings(frame);
+		return;
 	}
 
+	GameObject& ballObj{ Play::GetGameObject(ballIds.empty() ? -1 : ballIds[0]) };
+	//Play::DrawRect(ballObj.pos - BALL_AABB, ballObj.pos + BALL_AABB, Play::cWhite);
+
 	float velocity = ballObj.velocity.x;
 	float acceleration = ballObj.velocity.y;
 
-	Play::DrawFontText("64px", "High Score: " + std::to_string(gameState.score), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 100), Play::CENTRE);
-	Play::DrawFontText("64px", "Lives: " + std::to_string(gameState.lives), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 200), Play::CENTRE);
-	Play::DrawFontText("64px", "Collisions: " + std::to_string(gameState.collisionCount), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 300), Play::CENTRE);
-	Play::DrawFontText("64px", "Velocity x: " + std::to_string(velocity), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 400), Play::CENTRE);
-	Play::DrawFontText("64px", "Velocity y: " + std::to_string(acceleration), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 500), Play::CENTRE);
-	DrawSoundControl();
-
-	Play::PresentDrawingBuffer();
+	frame.DrawFontText("64px", "High Score: " + std::to_string(gameState.score), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 100), Play::CENTRE);
+	frame.DrawFontText("64px", "Lives: " + std::to_string(gameState.lives), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 200), Play::CENTRE);
+	frame.DrawFontText("64px", "Collisions: " + std::to_string(gameState.collisionCount), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 300), Play::CENTRE);
+	frame.DrawFontText("64px", "Velocity x: " + std::to_string(velocity), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 400), Play::CENTRE);
+	frame.DrawFontText("64px", "Velocity y: " + std::to_string(acceleration), Point2D(DISPLAY_WIDTH - 150, DISPLAY_HEIGHT - 500), Play::CENTRE);
+	DrawSoundControl(frame);
 }
 
-void DrawSoundControl()
+void DrawChests(Play::RenderSnapshot& frame)
 {
-	Play::DrawFontText("64px", (gameState.sound) ? "SOUND: ON" : "SOUND: OFF", Point2D(100, 50), Play::CENTRE);
-	Play::DrawFontText("64px", (gameState.music) ? "MUSIC: ON" : "MUSIC: OFF", Point2D(100, 100), Play::CENTRE);
+	int spriteId = Play::GetSpriteId("box");
+
+	for (int row = chestGrid.layout.firstRow; row < chestGrid.layout.firstRow + chestGrid.layout.rows; row++)
+	{
+		for (int column = 0; column < GetChestColumns(row); column++)
+		{
+			if (IsChestClosed(row, column))
+				frame.DrawSprite(spriteId, GetChestPos(row, column), 0);
+		}
+	}
 }
 
-void UpdateBall()
+// Shows the last frame time breakdown instead of the score in the stress mode
+void DrawTimings(Play::RenderSnapshot& frame)
 {
-	GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
+	frame.DrawDebugText(Point2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 20), frameTimings.report.c_str(), Play::cWhite);
+	DrawSoundControl(frame);
+}
 
-	ballObj.acceleration.y = std::clamp(ballObj.acceleration.y, 0.f, 0.1f);
-	ballObj.rotSpeed = ballObj.velocity.x * 0.01f;
+void DrawSoundControl(Play::RenderSnapshot& frame)
+{
+	frame.DrawFontText("64px", (audioSettings.sound) ? "SOUND: ON" : "SOUND: OFF", Point2D(100, 50), Play::CENTRE);
+	frame.DrawFontText("64px", (audioSettings.music) ? "MUSIC: ON" : "MUSIC: OFF", Point2D(100, 100), Play::CENTRE);
+}
 
-	if (ballObj.velocity.y > 9.0f  || ballObj.velocity.x > 7.0f)
-		ballObj.velocity = { 5.0f, 8.0f };
+void UpdateBalls()
+{
+	std::vector<int> ballIds{ Play::CollectGameObjectIDsByType(TYPE_BALL) };
+	int ballsLeft = 0;
 
-	if (ballObj.pos.x < 0 || ballObj.pos.x > DISPLAY_WIDTH)
+	for (int ball : ballIds)
 	{
-		ballObj.pos.x = std::clamp(ballObj.pos.x, 0.f, DISPLAY_WIDTH);
-		ballObj.velocity.x *= -0.9f;
-		ballObj.velocity.y *= 0.9f;
+		GameObject& ballObj{ Play::GetGameObject(ball) };
+
+		ballObj.acceleration.y = std::clamp(ballObj.acceleration.y, 0.f, 0.1f);
+		ballObj.rotSpeed = ballObj.velocity.x * 0.01f;
+
+		if (length(ballObj.velocity) > BALL_MAX_SPEED)
+			ballObj.velocity = normalize(ballObj.velocity) * BALL_MAX_SPEED;
+
+		if (ballObj.pos.x < 0 || ballObj.pos.x > DISPLAY_WIDTH)
+		{
+			ballObj.pos.x = std::clamp(ballObj.pos.x, 0.f, DISPLAY_WIDTH);
+			ballObj.velocity.x *= -0.9f;
+			ballObj.velocity.y *= 0.9f;
+		}
+
+		if (ballObj.pos.y > gameState.cameraY + DISPLAY_HEIGHT)
+		{
+			// The stress mode keeps every ball in play so the number of objects stays the same
+			if (!stressConfig.enabled)
+			{
+				ballObj.type = TYPE_DESTROYED;
+				continue;
+			}
+
+			ballObj.pos.y = gameState.cameraY + DISPLAY_HEIGHT;
+			ballObj.velocity.y = -std::abs(ballObj.velocity.y);
+		}
+
+		if (ballObj.pos.y < gameState.cameraY)
+		{
+			ballObj.pos.y = gameState.cameraY;
+			ballObj.acceleration *= -1;
+			ballObj.velocity.y *= -1;
+		}
+
+		// Move the ball, bouncing it off the paddle (the hits are handled in HandleCollisions) and then off any chests in its way
+		// > The chests are swept from the last paddle hit, as that is where the final straight part of the movement starts
+		std::vector<Play::SweepHit> paddleHits{ Play::MoveAndCollide(ballObj, { TYPE_PADDLE, TYPE_RIVAL_PADDLE }) };
+		CollideWithChests(ballObj, paddleHits.empty() ? ballObj.oldPos : paddleHits.back().pos);
+		ballsLeft++;
 	}
 
-	if (ballObj.pos.y > DISPLAY_HEIGHT)
+	// A life is lost once the last ball has fallen off the bottom of the screen
+	if (ballsLeft == 0)
 	{
 		gameState.lives--;
 		if (gameState.lives > 0)
-		{
-			DestroyObjects();
 			RestartGame();
-			DrawGamePlay();
-		}
 		else
 			gameState.state = STATE_GAMEOVER;
 	}
-
-	if (ballObj.pos.y < 0)
-	{
-		ballObj.pos.y = std::clamp(ballObj.pos.y, 0.f, DISPLAY_HEIGHT);
-		ballObj.acceleration *= -1;
-		ballObj.velocity.y *= -1;
-	}
-
-	PaddleCollision();
-	ChestCollision();
-
-	Play::UpdateGameObject(ballObj);
 }
 
-void ChestCollision()
+// Bounces a ball off the chests in the way of its movement from start to its current position, which is only ever a few cells of the grid
+// > Each bounce sweeps the rest of the movement again, like Play::MoveAndCollide, so a fast ball can't pass through a chest
+void CollideWithChests(GameObject& ballObj, Point2D start)
 {
-	std::vector<int> chestIds{ Play::CollectGameObjectIDsByType(TYPE_CHEST) };
+	Vector2D move{ ballObj.pos - start };
+	std::pair<int, int> hitChests[MAX_CHEST_HITS];
+	int hitCount = 0;
 
-	for (int chest : chestIds)
+	while (lengthSqr(move) > 0.f)
 	{
-		GameObject& chestObj{ Play::GetGameObject(chest) };
+		Point2D end{ start + move };
+		Point2D topLeft{ std::min(start.x, end.x), std::min(start.y, end.y) };
+		Point2D bottomRight{ std::max(start.x, end.x), std::max(start.y, end.y) };
 
-		CalculateMinMax(chestObj, minX, maxX, minY, maxY);
+		// The chests' boxes are a little bigger than their cells, so look as far as a chest could reach
+		Vector2D reach{ BALL_AABB + CHEST_AABB };
+		int firstRow = std::max(GetChestRow(topLeft.y - reach.y), chestGrid.layout.firstRow);
+		int lastRow = std::min(GetChestRow(bottomRight.y + reach.y), chestGrid.layout.firstRow + chestGrid.layout.rows - 1);
 
-		if (IsBallColliding(chestObj))
+		// Every chest reached at the same moment is hit (such as two chests side by side), but the ball only bounces once
+		Play::SweepHit first;
+		first.time = FLT_MAX;
+		int firstHit = hitCount;
+
+		for (int row = firstRow; row <= lastRow; row++)
 		{
-			if (gameState.sound)
-				Play::PlayAudio("collect");
+			int firstColumn = std::max(GetChestColumn(row, topLeft.x - reach.x), 0);
+			int lastColumn = std::min(GetChestColumn(row, bottomRight.x + reach.x), GetChestColumns(row) - 1);
 
-			Play::CreateGameObject(TYPE_COIN, chestObj.pos, 10, "coin");
+			for (int column = firstColumn; column <= lastColumn; column++)
+			{
+				// A chest which takes more than one hit is still closed after a bounce, but each update only counts it once
+				if (std::find(hitChests, hitChests + firstHit, std::make_pair(row, column)) != hitChests + firstHit)
+					continue;
+
+				Play::SweepHit hit;
+				if (!IsChestClosed(row, column) || !Play::SweepAABB(start, BALL_AABB, move, GetChestPos(row, column), CHEST_AABB, hit))
+					continue;
+
+				if (hit.time < first.time)
+				{
+					first = hit;
+					hitCount = firstHit;
+				}
+
+				if (hit.time == first.time && hitCount < MAX_CHEST_HITS)
+					hitChests[hitCount++] = { row, column };
+			}
+		}
 
-			RedirectBall(chestObj);
-			gameState.fromPaddle = false;
-			chestObj.type = TYPE_DESTROYED;
+		if (hitCount == firstHit)
+		{
+			start = end;
+			break;
 		}
+
+		// Stop at the chest and bounce the rest of the movement off it
+		Vector2D remaining{ move * (1.f - first.time) };
+		start = first.pos;
+		move = remaining - first.normal * (2.f * dot(remaining, first.normal));
+		ballObj.velocity = ballObj.velocity - first.normal * (2.f * dot(ballObj.velocity, first.normal));
+		RedirectBall(ballObj, TYPE_CHEST, first.normal);
+
+		// Stop dead rather than risk passing through something
+		if (hitCount >= MAX_CHEST_HITS)
+			break;
 	}
+
+	ballObj.pos = start;
+	for (int i = 0; i < hitCount; i++)
+		ChestCollision(hitChests[i].first, hitChests[i].second);
+
+	Play::UpdateSpatialIndex(ballObj);
 }
 
-void PaddleCollision()
+void HandleCollisions()
 {
-	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
+	// Find all of this frame's collisions in one go, after everything has moved
+	Play::UpdateContacts();
 
-	CalculateMinMax(paddleObj, minX, maxX, minY, maxY);
-
-	if (IsBallColliding(paddleObj))
+	for (const Play::Contact& contact : Play::GetContacts())
 	{
-		if (gameState.sound)
-			Play::PlayAudio("explode");
-
-		RedirectBall(paddleObj);
-		gameState.fromPaddle = true;
+		// A ball which bounces off the paddle again on the next update is still touching it, so new hits count as well as new contacts
+		if (contact.state != Play::CONTACT_BEGIN && !(contact.state == Play::CONTACT_STAY && contact.bSwept))
+			continue;
+
+		if (contact.typeA == TYPE_BALL)
+			PaddleCollision(Play::GetGameObject(contact.idA), Play::GetGameObject(contact.idB), contact.normal);
+		else if (contact.typeA == TYPE_COIN)
+			CoinCollision(Play::GetGameObject(contact.idA), Play::GetGameObject(contact.idB));
 	}
 }
 
-bool IsWinning()
+void ChestCollision(int row, int column)
 {
-	std::vector<int> chestIds{ Play::CollectGameObjectIDsByType(TYPE_CHEST) };
-	std::vector<int> coinIds{ Play::CollectGameObjectIDsByType(TYPE_COIN) };
+	gameState.collisionCount++;
 
-	if (chestIds.size() == 0 && coinIds.size() == 0)
-		return true;
+	if (--chestGrid.hitsLeft[GetChestSlot(row) * chestGrid.layout.columns + column] > 0)
+		return;
 
-	return false;
+	int& score = (gameState.lastPaddle == TYPE_RIVAL_PADDLE) ? gameState.rivalScore : gameState.score;
+	(gameState.fromPaddle) ? score += 100 : score += 10;
+
+	if (audioSettings.sound && !versus.rollingBack)
+		Play::PlayAudio("collect");
+
+	if (Play::RandomRoll(100) <= stressConfig.coinDropPercent)
+	{
+		GameObject& coinObj{ Play::GetGameObject(Play::CreateGameObject(TYPE_COIN, GetChestPos(row, column), 10, "coin")) };
+		coinObj.aabb = COIN_AABB;
+	}
+
+	gameState.fromPaddle = false;
+	chestGrid.closed[GetChestSlot(row) * chestGrid.layout.wordsPerRow + column / 64] &= ~(1ull << (column % 64));
+	chestGrid.layout.remaining--;
 }
 
-void CalculateMinMax(const GameObject& object, float& minX, float& maxX, float& minY, float& maxY)
+void PaddleCollision(GameObject& ballObj, const GameObject& paddleObj, Vector2D normal)
 {
-	switch (object.type)
-	{
-		case TYPE_PADDLE:
-		{
-			minX = object.pos.x - PADDLE_AABB.x;
-			maxX = object.pos.x + PADDLE_AABB.x;
+	gameState.collisionCount++;
 
-			minY = object.pos.y - PADDLE_AABB.y;
-			maxY = object.pos.y + PADDLE_AABB.y;
+	if (audioSettings.sound && !versus.rollingBack)
+		Play::PlayAudio("explode");
 
-			break;
-		}
-		case TYPE_CHEST:
-		{
-			minX = object.pos.x - CHEST_AABB.x;
-			maxX = object.pos.x + CHEST_AABB.x;
+	RedirectBall(ballObj, paddleObj.type, normal);
+	gameState.fromPaddle = true;
+	gameState.lastPaddle = paddleObj.type;
+}
 
-			minY = object.pos.y - CHEST_AABB.y;
-			maxY = object.pos.y + CHEST_AABB.y;
+void CoinCollision(GameObject& coinObj, const GameObject& paddleObj)
+{
+	// A coin touching both paddles is only collected once
+	if (coinObj.type != TYPE_COIN)
+		return;
 
-			break;
-		}
-	}
+	coinObj.type = TYPE_DESTROYED;
+	((paddleObj.type == TYPE_RIVAL_PADDLE) ? gameState.rivalScore : gameState.score) += 150;
 }
 
-void RedirectBall(const GameObject& object)
+bool IsWinning()
 {
-	GameObject& ball{ Play::GetGameObjectByType(TYPE_BALL) };
+	std::vector<int> coinIds{ Play::CollectGameObjectIDsByType(TYPE_COIN) };
+
+	// There are always more chests coming in the endless mode
+	if (gameState.endless)
+		return false;
+
+	if (chestGrid.layout.remaining == 0 && coinIds.size() == 0)
+		return true;
 
+	return false;
+}
+
+void RedirectBall(GameObject& ball, int objectType, Vector2D normal)
+{
 	float velocityChange = 0.0f;
 	float yChange = 0.0f;
 
-	switch (object.type)
+	switch (objectType)
 	{
 		case TYPE_PADDLE:
+		case TYPE_RIVAL_PADDLE:
 		{
 			velocityChange = 1.1f;
 			yChange = 1.0f;
@@ -462,49 +1937,28 @@ void RedirectBall(const GameObject& object)
 			break;
 		}
 	}
-		
-	if (ball.oldPos.y < minY && ball.oldPos.x > minX && ball.oldPos.x < maxX)
-	{
-		ball.acceleration *= -1;
-		ball.velocity.y *= velocityChange * (-1);
-		ball.velocity.x *= velocityChange;
-	}
-	else if (ball.oldPos.x < minX && ball.oldPos.y > minY && ball.oldPos.y < maxY)
-	{
-		AdjustBallAndPaddle();
 
-		ball.acceleration *= -1;
-		ball.velocity.x *= velocityChange * (-1);
-		ball.velocity.y *= velocityChange * yChange;
-	}
-	else if (ball.oldPos.x > minX && ball.oldPos.x < maxX && ball.oldPos.y > maxY)
-	{
-		ball.acceleration *= -1;
-		ball.velocity.y *= velocityChange * (-1);
-		ball.velocity.x *= velocityChange;
-	}
-	else if (ball.oldPos.x > maxX && ball.oldPos.y > minY && ball.oldPos.y < maxY)
-	{	
-		AdjustBallAndPaddle();
+	// MoveAndCollide has already bounced the ball off the side it hit, so we only need to change its speed
+	ball.acceleration *= -1;
 
-		ball.acceleration *= -1;
-		ball.velocity.x *= velocityChange * (-1);
-		ball.velocity.y *= velocityChange * yChange;
+	if (normal.y != 0.f)
+	{
+		// Hit the top or bottom
+		ball.velocity *= velocityChange;
 	}
 	else
 	{
-		AdjustBallAndPaddle();
+		// Hit the left or right (a chest pushes back on the paddle the ball last bounced off)
+		AdjustBallAndPaddle(ball, (objectType == TYPE_CHEST) ? gameState.lastPaddle : objectType);
 
-		ball.velocity *= velocityChange * (-1);
-		ball.velocity.x *= yChange;
-		ball.acceleration *= -1;
+		ball.velocity.x *= velocityChange;
+		ball.velocity.y *= velocityChange * yChange;
 	}
 }
 
-void AdjustBallAndPaddle()
+void AdjustBallAndPaddle(GameObject& ballObj, int paddleType)
 {
-	GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
-	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
+	GameObject& paddleObj{ Play::GetGameObjectByType(paddleType) };
 
 	if (paddleObj.pos.x > paddleObj.oldPos.x && ballObj.pos.x < ballObj.oldPos.x)
 	{
@@ -522,6 +1976,7 @@ void AdjustBallAndPaddle()
 	}
 }
 
+// Moves the coins down the screen (the ones touching a paddle are collected in HandleCollisions)
 void UpdateCoins()
 {
 	std::vector<int> coinIds{ Play::CollectGameObjectIDsByType(TYPE_COIN) };
@@ -531,88 +1986,27 @@ void UpdateCoins()
 		GameObject& coinObj{ Play::GetGameObject(coin) };
 		coinObj.pos.y += 5;
 
-		if (isPaddleColliding(coinObj))
-		{
-			coinObj.type = TYPE_DESTROYED;
-			gameState.score += 150;
-		}
-
-		if (coinObj.pos.y > DISPLAY_HEIGHT)
+		if (coinObj.pos.y > gameState.cameraY + DISPLAY_HEIGHT)
 			coinObj.type = TYPE_DESTROYED;
 
 		Play::UpdateGameObject(coinObj);
-		Play::DrawObjectRotated(coinObj);
 	}
 }
 
 void UpdatePaddle()
 {
-	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
-	paddleObj.pos.x = std::clamp (paddleObj.pos.x, PADDLE_AABB.x, DISPLAY_WIDTH - PADDLE_AABB.x);
-
-	Play::UpdateGameObject(paddleObj);
-}
-
-void ResetBall()
-{
-	if (Play::KeyDown(VK_SPACE))
-	{
-		GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
-		ballObj.pos = Vector2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT / 2);
-		ballObj.velocity = BALL_VELOCITY_DEFAULT;
-		ballObj.acceleration = BALL_ACCELERATION;
-	}
-}
-
-bool IsBallColliding(const GameObject& object)
-{
-	GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
-	Vector2D AABB{ 0, 0 };
-
-	switch (object.type)
-	{
-		case TYPE_PADDLE:
-		{
-			AABB = PADDLE_AABB;
-			break;
-		}
-		case TYPE_CHEST:
-		{
-			AABB = CHEST_AABB;
-			break;
-		}
-	}
-
-	if ( ballObj.pos.y - BALL_AABB.y < object.pos.y + AABB.y &&
-		ballObj.pos.y + BALL_AABB.y > object.pos.y - AABB.y )
+	// There is only a rival paddle in the versus mode
+	for (int paddleType : { TYPE_PADDLE, TYPE_RIVAL_PADDLE })
 	{
-		if (ballObj.pos.x + BALL_AABB.x > object.pos.x - AABB.x &&
-			ballObj.pos.x - BALL_AABB.x < object.pos.x + AABB.x)
+		for (int paddle : Play::CollectGameObjectIDsByType(paddleType))
 		{
-			gameState.collisionCount++;
+			GameObject& paddleObj{ Play::GetGameObject(paddle) };
+			paddleObj.pos.x = std::clamp (paddleObj.pos.x, PADDLE_AABB.x, DISPLAY_WIDTH - PADDLE_AABB.x);
+			paddleObj.pos.y = gameState.cameraY + DISPLAY_HEIGHT - 100; // Keep the paddle at the bottom of the screen as it scrolls
 
-			if (object.type == TYPE_CHEST)
-				(gameState.fromPaddle) ? gameState.score += 100 : gameState.score += 10;
-
-			return true;
+			Play::UpdateGameObject(paddleObj);
 		}
 	}
-	return false;
-}
-
-bool isPaddleColliding(const GameObject& object)
-{
-	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
-
-	if (paddleObj.pos.y - BALL_AABB.y < object.pos.y + BALL_AABB.y &&
-		paddleObj.pos.y + BALL_AABB.y > object.pos.y - BALL_AABB.y)
-	{
-
-		if (paddleObj.pos.x + BALL_AABB.x > object.pos.x - BALL_AABB.x &&
-			paddleObj.pos.x - BALL_AABB.x < object.pos.x + BALL_AABB.x)
-			return true;
-	}
-	return false;
 }
 
 void UpdatePlayerControls()
@@ -632,6 +2026,13 @@ void UpdatePlayerControls()
 		paddleObj.pos.x += 20;
 	}
 
+	// The versus mode presses these keys for the second player
+	if (versus.enabled && Play::KeyDown(RIVAL_KEY_LEFT))
+		Play::GetGameObjectByType(TYPE_RIVAL_PADDLE).pos.x -= 20;
+
+	if (versus.enabled && Play::KeyDown(RIVAL_KEY_RIGHT))
+		Play::GetGameObjectByType(TYPE_RIVAL_PADDLE).pos.x += 20;
+
 	if (Play::KeyPressed(VK_SHIFT))
 		gameState.state = STATE_PAUSED;
 }
@@ -649,36 +2050,27 @@ void UpdateDestroyed()
 void RestartGame()
 {
 	gameState.score = 0;
+	gameState.rivalScore = 0;
 	gameState.collisionCount = 0;
-	gameState.xCount = 0;
-	gameState.yCount = 0;
-	gameState.x = 0;
-	gameState.y = 0;
-
-	GameObject& ballObj{ Play::GetGameObjectByType(TYPE_BALL) };
-
-	ballObj.pos = Vector2D((DISPLAY_WIDTH / 2) - 200, DISPLAY_HEIGHT / 2);
-	ballObj.velocity = BALL_VELOCITY_DEFAULT;
-	ballObj.acceleration = BALL_ACCELERATION;
-
-	GameObject& paddleObj{ Play::GetGameObjectByType(TYPE_PADDLE) };
-	paddleObj.pos = Vector2D(DISPLAY_WIDTH / 2, DISPLAY_HEIGHT - 100);
 
+	// StartGame puts the new balls and paddle back where they started
 	DestroyObjects();
 	StartGame();
 }
 
 void DestroyObjects()
 {
-	std::vector<int> chestIds{ Play::CollectGameObjectIDsByType(TYPE_CHEST) };
+	std::vector<int> ballIds{ Play::CollectGameObjectIDsByType(TYPE_BALL) };
 
-	for (int chest : chestIds)
+	for (int ball : ballIds)
 	{
-		Play::GetGameObject(chest).type = TYPE_DESTROYED;
+		Play::GetGameObject(ball).type = TYPE_DESTROYED;
 	}
 
-	Play::GetGameObjectByType(TYPE_BALL).type = TYPE_DESTROYED;
 	Play::GetGameObjectByType(TYPE_PADDLE).type = TYPE_DESTROYED;
+
+	if (versus.enabled)
+		Play::GetGameObjectByType(TYPE_RIVAL_PADDLE).type = TYPE_DESTROYED;
 }
 
 	